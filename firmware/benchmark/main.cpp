@@ -0,0 +1,171 @@
+// Micro-benchmarks for the LoRa payload code, run on the host:
+//
+//     pio run -e native_benchmark -t exec
+//
+// Every benchmark prints one JSON object per line, so results can be
+// collected and compared between releases:
+//
+//     {"benchmark":"encoder/quantized","mix":"station","ns_per_frame":41.2,"allocs_per_frame":0,"bytes_per_frame":15}
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "lora/decoder.h"
+#include "lora/protocol.h"
+#include "lora/schema.h"
+
+using namespace Lora::Protocol;
+
+// Counts heap allocations made while a benchmark runs.
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+// Keeps the compiler from optimising away the benchmarked work.
+template <typename T>
+static void keep(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Runs `frame` repeatedly for at least 100 ms and prints its cost per call.
+ * `frame` returns the number of payload bytes it produced.
+ */
+template <typename Frame>
+static void run(const char *benchmark, const char *mix, Frame frame)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up, and find out how many bytes one frame is
+    size_t bytes = frame();
+
+    size_t iterations = 0;
+    const size_t allocations_before = allocations;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do
+    {
+        for (size_t i = 0; i < 1000; i++)
+            keep(frame());
+        iterations += 1000;
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(100));
+
+    const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    const double allocs = static_cast<double>(allocations - allocations_before) / iterations;
+    std::printf("{\"benchmark\":\"%s\",\"mix\":\"%s\",\"ns_per_frame\":%.1f,\"allocs_per_frame\":%.2f,\"bytes_per_frame\":%zu}\n",
+                benchmark, mix, ns, allocs, bytes);
+}
+
+struct Mix
+{
+    const char *name;
+    std::vector<DataPoint> data_points;
+};
+
+// Realistic channel mixes: a single level sensor, a typical barrel and a fully equipped station
+static std::vector<Mix> mixes()
+{
+    std::vector<Mix> result = {
+        {"hcsr04", {{MeasurementType::Distance, ChannelID::_0, 87.3f}}},
+        {"station",
+         {{MeasurementType::Distance, ChannelID::_0, 87.3f},
+          {MeasurementType::Temperature, ChannelID::_0, 18.25f},
+          {MeasurementType::Voltage, ChannelID::_0, 3.91f},
+          {MeasurementType::Boolean, ChannelID::_0, false},
+          {MeasurementType::Boolean, ChannelID::_1, true},
+          {MeasurementType::Boolean, ChannelID::_2, false}}},
+        {"full", {}},
+    };
+
+    auto &full = result.back().data_points;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        const auto channel = static_cast<ChannelID>(i);
+        full.push_back({MeasurementType::Distance, channel, 80.0f + i});
+        full.push_back({MeasurementType::Temperature, channel, 12.5f + i});
+        full.push_back({MeasurementType::Humidity, channel, 60.0f + i});
+        full.push_back({MeasurementType::Boolean, channel, i % 2 == 0});
+    }
+    return result;
+}
+
+int main()
+{
+    for (const auto &mix : mixes())
+    {
+        const auto &data_points = mix.data_points;
+        std::array<uint8_t, MAX_PAYLOAD_SIZE> buffer;
+
+        run("packDataPoints/vector", mix.name, [&]
+            { return packDataPoints(data_points).size(); });
+
+        run("calculate_packed_bytes", mix.name, [&]
+            { return calculate_packed_bytes(data_points); });
+
+        run("encoder/raw", mix.name, [&]
+            {
+                Encoder encoder(buffer);
+                encoder.add(data_points.data(), data_points.size());
+                return encoder.size(); });
+
+        run("encoder/quantized", mix.name, [&]
+            {
+                Encoder encoder(buffer);
+                encoder.enableQuantization();
+                encoder.add(data_points.data(), data_points.size());
+                return encoder.size(); });
+
+        Encoder encoder(buffer);
+        encoder.enableQuantization();
+        encoder.add(data_points.data(), data_points.size());
+        const size_t length = encoder.size();
+
+        run("decoder/stream", mix.name, [&]
+            {
+                size_t entries = 0;
+                for (const auto &entry : decode(buffer.data(), length))
+                    entries += entry.kind != Entry::Kind::Invalid;
+                keep(entries);
+                return length; });
+    }
+
+    using Station = Schema<
+        Field<MeasurementType::Distance, ChannelID::_0, Encoding::Quantized16>,
+        Field<MeasurementType::Temperature, ChannelID::_0, Encoding::Quantized16>,
+        Field<MeasurementType::Voltage, ChannelID::_0, Encoding::Quantized16>,
+        Field<MeasurementType::Boolean, ChannelID::_0, Encoding::Bool>>;
+    std::array<uint8_t, Station::size> frame;
+    float distance = 87.3f;
+    run("schema/quantized", "station", [&]
+        {
+            keep(distance);
+            Station::pack(frame.data(), distance, 18.25f, 3.91f, false);
+            return frame.size(); });
+
+    std::array<float, 60> samples;
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i] = 42.0f + 0.05f * i + ((i % 3) == 0 ? 0.2f : -0.1f);
+    std::array<uint8_t, MAX_PAYLOAD_SIZE> buffer;
+    run("encoder/batch", "hcsr04x60", [&]
+        {
+            Encoder encoder(buffer);
+            encoder.add(Batch{MeasurementType::Distance, ChannelID::_0, -1, 60, samples.data(), 60});
+            return encoder.size(); });
+
+    return 0;
+}
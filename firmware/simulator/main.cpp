@@ -0,0 +1,339 @@
+// LoRaWAN simulator: runs the uplink scheduling of the firmware against a
+// simulated LMIC and radio for thousands of days in seconds:
+//
+//     pio run -e native_simulator -t exec
+//
+// Every scenario prints one JSON object, e.g.
+//
+//     {"scenario":"edge","days":1000,"uplinks":..,"delivered":..,"dropped":..,"airtime_s_per_day":..}
+//
+// The device side is `Lora::Wan::UplinkScheduler`, the same code lora-wan.cpp
+// runs on the hardware, driven by `LmicService`. Only the adapters below stand
+// in for LMIC, the clocks and the flash spill. Scenarios cover full and
+// change-only uplinks, batches, the spill, network time and deep sleep, where
+// the scheduler is built again on every wake-up and only its `UplinkMemory`
+// is kept.
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "lora/batcher.h"
+#include "lora/lmic-service.h"
+#include "lora/protocol.h"
+#include "lora/uplink-scheduler.h"
+#include "simulated-lmic.h"
+
+using namespace Lora;
+
+// GPS time at the start of every scenario.
+constexpr uint32_t GPS_START_S = 1400000000;
+// Channels of the batcher, distance plus the extra channels of a scenario.
+constexpr size_t BATCH_CHANNELS = 8;
+constexpr size_t MAX_EXTRA_CHANNELS = 40;
+constexpr uint32_t KEYFRAME_INTERVAL = 20;
+constexpr uint32_t DAILY_BUDGET_MS = 30000;
+
+struct Scenario
+{
+    const char *name;
+    Simulator::Link link;
+    uint8_t dr;
+    uint32_t publish_interval_s;
+    // Every n-th publish raises the overflow alarm
+    uint32_t alarm_every = 0;
+    // Change-only uplinks with this deadband, NaN for full frames
+    float deadband = NAN;
+    // Samples taken per publish and sent as batches, 0 for one datapoint per channel
+    uint32_t batch_samples = 0;
+    // Temperature, humidity, pressure and voltage channels besides distance and alarm
+    size_t extra_channels = 1;
+    // Sleeps between publishes, which restarts the local clock and the scheduler
+    bool deep_sleep = false;
+    size_t spill_records = 0;
+};
+
+struct Result
+{
+    uint64_t publishes = 0;
+    uint64_t queue_dropped = 0;
+    uint64_t coalesced = 0;
+    uint64_t confirmed_failed = 0;
+    uint64_t wake_ups = 0;
+    size_t spill_peak = 0;
+    bool network_time = false;
+    uint8_t final_dr = 0;
+};
+
+// Adapts the simulator to LmicService and UplinkScheduler, the simulated clock is 64 bit.
+struct SimulatedDevice
+{
+    SimulatedDevice(Simulator::SimulatedLmic &lmic, uint64_t &now, uint32_t seed) : lmic(lmic), now(now), generator(seed) {}
+
+    uint32_t run() { return lmic.run(); }
+    // Nothing goes out before the join completed, LMIC would queue it behind the join
+    bool pending() { return !lmic.joined() || lmic.pending(); }
+    uint32_t millis() { return static_cast<uint32_t>(now - wake_ms); }
+    uint32_t seconds() { return static_cast<uint32_t>(now / 1000); }
+    uint32_t random() { return generator(); }
+    uint8_t dr() { return lmic.dr; }
+    void setDr(uint8_t dr) { lmic.dr = dr; }
+    int8_t txPower() { return 14; }
+    void send(const uint8_t *, size_t size, bool confirmed) { lmic.send(size, confirmed); }
+    void requestNetworkTime() { lmic.requestNetworkTime(); }
+
+    uint32_t gps() const { return GPS_START_S + static_cast<uint32_t>(now / 1000); }
+
+    Simulator::SimulatedLmic &lmic;
+    uint64_t &now;
+    // When the local clock started, the last wake-up
+    uint64_t wake_ms = 0;
+    std::mt19937 generator;
+};
+
+// Stands in for the spill file on flash.
+struct MemorySpill
+{
+    bool append(const uint8_t *record)
+    {
+        records.emplace_back();
+        std::copy(record, record + Protocol::SPILL_RECORD_SIZE, records.back().begin());
+        peak = std::max(peak, records.size());
+        return true;
+    }
+
+    size_t read(size_t first, uint8_t *out, size_t count)
+    {
+        count = first < records.size() ? std::min(count, records.size() - first) : 0;
+        for (size_t i = 0; i < count; i++)
+            std::copy(records[first + i].begin(), records[first + i].end(), out + i * Protocol::SPILL_RECORD_SIZE);
+        return count;
+    }
+
+    void clear() { records.clear(); }
+
+    std::vector<std::array<uint8_t, Protocol::SPILL_RECORD_SIZE>> records;
+    size_t peak = 0;
+};
+
+using Scheduler = Wan::UplinkScheduler<SimulatedDevice, MemorySpill>;
+
+// The datapoints of the `index`-th sample: a slowly rising distance, constant extra channels and the alarm.
+static size_t sample(const Scenario &scenario, uint64_t index, bool alarm, Protocol::DataPoint *data_points)
+{
+    static constexpr Protocol::MeasurementType EXTRA_TYPES[] = {
+        Protocol::MeasurementType::Temperature,
+        Protocol::MeasurementType::Humidity,
+        Protocol::MeasurementType::Pressure,
+        Protocol::MeasurementType::Voltage,
+    };
+
+    size_t count = 0;
+    data_points[count++] = {Protocol::MeasurementType::Distance, Protocol::ChannelID::_0, 80.0f + index / 50 % 10};
+    for (size_t i = 0; i < scenario.extra_channels; i++)
+        data_points[count++] = {EXTRA_TYPES[i / 10 % 4], static_cast<Protocol::ChannelID>(i % 10), 12.5f + i};
+    if (scenario.batch_samples == 0)
+        data_points[count++] = {Protocol::MeasurementType::Boolean, Protocol::ChannelID::_0, alarm};
+    return count;
+}
+
+static Result simulate(const Scenario &scenario, uint64_t days, Simulator::SimulatedLmic &lmic, uint64_t &now)
+{
+    Result result;
+    SimulatedDevice device(lmic, now, scenario.link.seed);
+    Wan::LmicService<SimulatedDevice> service(device);
+    MemorySpill spill;
+    Protocol::Batcher<BATCH_CHANNELS> batcher;
+
+    Wan::UplinkSettings settings;
+    settings.duty_cycle = scenario.link.duty_cycle;
+    settings.adr = scenario.link.adr;
+    settings.spill_records = scenario.spill_records;
+
+    // What the firmware keeps in RTC memory across deep sleep
+    Wan::UplinkMemory memory;
+    std::optional<Scheduler> uplinks;
+    uint32_t sleep_gps_s = 0;
+    uint32_t sleep_age_ms = 0;
+    bool sleep_synchronized = false;
+
+    const auto wake = [&]
+    {
+        device.wake_ms = now;
+        uplinks.emplace(device, memory, settings, spill);
+        uplinks->configure(scenario.deadband, KEYFRAME_INTERVAL, DAILY_BUDGET_MS);
+        if (sleep_synchronized)
+        {
+            const uint32_t gps_s = device.gps();
+            uplinks->networkClock().restore(gps_s, device.millis(), sleep_age_ms + (gps_s - sleep_gps_s) * 1000);
+        }
+        result.wake_ups++;
+    };
+
+    const auto sleep = [&]
+    {
+        auto &clock = uplinks->networkClock();
+        sleep_synchronized = clock.synchronized();
+        sleep_gps_s = device.gps();
+        sleep_age_ms = sleep_synchronized ? clock.age(device.millis()) : 0;
+        result.queue_dropped += uplinks->dropped();
+        result.coalesced += uplinks->coalesced();
+        result.confirmed_failed += uplinks->confirmedFailed();
+        uplinks.reset();
+    };
+
+    lmic.dr = scenario.dr;
+    lmic.setEventCallback([&](const Simulator::Event &event)
+                          {
+                              if (event.type == Simulator::Event::Type::Joined)
+                              {
+                                  uplinks->joined();
+                                  return;
+                              }
+
+                              uplinks->txComplete(event.acknowledged, event.downlink, event.rssi, event.snr);
+                              if (event.network_time)
+                                  uplinks->networkClock().synchronize(device.gps(), device.millis()); });
+
+    const uint32_t interval_ms = scenario.publish_interval_s * 1000;
+    const uint32_t sample_interval_ms = scenario.batch_samples > 0 ? interval_ms / scenario.batch_samples : interval_ms;
+    const uint64_t end = now + days * 24 * 60 * 60 * 1000;
+    uint64_t next_publish = now;
+    uint64_t next_sample = now;
+    uint64_t samples = 0;
+    uint32_t newest_ms = 0;
+
+    wake();
+    lmic.join();
+
+    while (now < end)
+    {
+        if (!uplinks)
+        {
+            now = std::min(next_publish, next_sample);
+            wake();
+        }
+
+        if (scenario.batch_samples > 0 && now >= next_sample)
+        {
+            std::array<Protocol::DataPoint, BATCH_CHANNELS> data_points;
+            batcher.add(data_points.data(), sample(scenario, samples++, false, data_points.data()));
+            newest_ms = device.millis();
+            next_sample += sample_interval_ms;
+        }
+
+        if (now >= next_publish)
+        {
+            if (scenario.batch_samples > 0)
+            {
+                std::array<Protocol::Batch, BATCH_CHANNELS> batches;
+                const size_t count = batcher.batches(batches.data(), sample_interval_ms / 1000);
+                if (uplinks->publish(batches.data(), count, newest_ms))
+                    batcher.clear();
+            }
+            else
+            {
+                const bool alarm = scenario.alarm_every > 0 && result.publishes % scenario.alarm_every == 0;
+                std::array<Protocol::DataPoint, MAX_EXTRA_CHANNELS + 2> data_points;
+                uplinks->publish(data_points.data(), sample(scenario, result.publishes, alarm, data_points.data()), device.millis());
+            }
+            result.publishes++;
+            next_publish += std::max(interval_ms, uplinks->minPublishIntervalMs());
+            if (scenario.batch_samples == 0)
+                next_sample = next_publish;
+        }
+
+        const uint32_t due_ms = uplinks->dueMs(service.poll([&]
+                                                            { return uplinks->sendNext(); }));
+
+        // Like the firmware, deep sleep only once nothing is left to send or receive
+        if (scenario.deep_sleep && uplinks->idle() && !device.pending())
+        {
+            sleep();
+            continue;
+        }
+
+        now = std::max(std::min({now + due_ms, next_publish, next_sample}), now + 1);
+    }
+
+    if (uplinks)
+    {
+        result.network_time = uplinks->networkClock().synchronized();
+        sleep();
+    }
+    else
+    {
+        result.network_time = sleep_synchronized;
+    }
+    result.spill_peak = spill.peak;
+    result.final_dr = lmic.dr;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t days = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+
+    Simulator::Link good;
+    good.snr = 8.0f;
+
+    Simulator::Link edge;
+    edge.uplink_loss = 0.3f;
+    edge.downlink_loss = 0.3f;
+    edge.rssi = -125;
+    edge.snr = -12.0f;
+    edge.seed = 2;
+
+    Simulator::Link dead = edge;
+    dead.uplink_loss = 0.95f;
+    dead.seed = 3;
+
+    Scenario scenarios[] = {
+        {"good/5min", good, 5, 300},
+        {"good/1min", good, 5, 60},
+        {"edge/5min", edge, 3, 300, 500},
+        {"dead/5min", dead, 5, 300, 500},
+        {"good/5min/change-only", good, 5, 300},
+        {"edge/5min/deep-sleep", edge, 3, 300, 500},
+        {"good/30min/batches", good, 5, 1800},
+        {"dead/1min/spill", dead, 5, 60},
+    };
+    scenarios[4].deadband = 1.0f;
+    scenarios[5].deadband = 1.0f;
+    scenarios[5].deep_sleep = true;
+    scenarios[6].batch_samples = 6;
+    scenarios[6].extra_channels = 2;
+    scenarios[7].extra_channels = MAX_EXTRA_CHANNELS;
+    scenarios[7].spill_records = 256;
+
+    for (const auto &scenario : scenarios)
+    {
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+
+        uint64_t now = 0;
+        Simulator::SimulatedLmic lmic(now, scenario.link);
+        const Result result = simulate(scenario, days, lmic, now);
+        const auto &statistics = lmic.statistics();
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("{\"scenario\":\"%s\",\"days\":%" PRIu64 ",\"publishes\":%" PRIu64 ",\"uplinks\":%" PRIu64
+                    ",\"delivered\":%" PRIu64 ",\"dropped\":%" PRIu64 ",\"queue_dropped\":%" PRIu64 ",\"coalesced\":%" PRIu64
+                    ",\"spill_peak\":%zu,\"confirmed\":%" PRIu64 ",\"acknowledged\":%" PRIu64 ",\"confirmed_failed\":%" PRIu64
+                    ",\"joins\":%" PRIu64 ",\"wake_ups\":%" PRIu64 ",\"network_time\":%s,\"final_dr\":%u,\"airtime_s_per_day\":%.2f"
+                    ",\"downlink_airtime_s_per_day\":%.3f,\"duty_cycle_wait_s_per_day\":%.1f,\"simulated_days_per_s\":%.0f}\n",
+                    scenario.name, days, result.publishes, statistics.uplinks, statistics.delivered, statistics.lost,
+                    result.queue_dropped, result.coalesced, result.spill_peak, statistics.confirmed, statistics.acknowledged,
+                    result.confirmed_failed, statistics.joins, result.wake_ups, result.network_time ? "true" : "false",
+                    result.final_dr, statistics.uplink_airtime_ms / 1000.0 / days, statistics.downlink_airtime_ms / 1000.0 / days,
+                    statistics.duty_cycle_wait_ms / 1000.0 / days, days / seconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lora/airtime.h"
+#include "lora/link-quality.h"
+
+namespace Lora::Simulator
+{
+    // Delays from the end of an uplink to its receive windows (LoRaWAN defaults).
+    constexpr uint32_t RX1_DELAY_MS = 1000;
+    constexpr uint32_t JOIN_ACCEPT_DELAY_MS = 5000;
+    // Data rate of the RX2 window, SF9 on TTN.
+    constexpr uint8_t RX2_DR = 3;
+    // LMIC waits this long before trying a failed join again.
+    constexpr uint32_t JOIN_RETRY_MS = 10000;
+    // LoRaWAN ADR backoff: uplinks without downlink until one is requested, and until each data rate step down after that.
+    constexpr uint32_t ADR_ACK_LIMIT = 64;
+    constexpr uint32_t ADR_ACK_DELAY = 32;
+
+    struct Link
+    {
+        // Probability that an uplink, or a downlink, does not make it
+        float uplink_loss = 0.0f;
+        float downlink_loss = 0.0f;
+        // Reception at the device and the gateway alike
+        int16_t rssi = -100;
+        float snr = 5.0f;
+        // Whether downlinks carry the network server's ADR decision
+        bool adr = true;
+        // The network sends a MAC downlink (ADR, link check answers) after this many unconfirmed uplinks
+        uint32_t mac_downlink_interval = 64;
+        float duty_cycle = 0.01f;
+        uint32_t seed = 1;
+    };
+
+    struct Statistics
+    {
+        uint64_t joins = 0;
+        uint64_t uplinks = 0;
+        uint64_t delivered = 0;
+        uint64_t lost = 0;
+        uint64_t confirmed = 0;
+        uint64_t acknowledged = 0;
+        uint64_t downlinks = 0;
+        uint64_t uplink_airtime_ms = 0;
+        uint64_t downlink_airtime_ms = 0;
+        // Time uplinks waited for the band to become free again
+        uint64_t duty_cycle_wait_ms = 0;
+    };
+
+    struct Event
+    {
+        enum class Type : uint8_t
+        {
+            Joined,
+            TxComplete,
+        };
+
+        Type type;
+        bool acknowledged;
+        bool downlink;
+        int16_t rssi;
+        float snr;
+        // The downlink answered a network time request, the network time is that of the event
+        bool network_time;
+    };
+
+    /**
+     * Stands in for LMIC and the SX1262 on the host, against a simulated
+     * millisecond clock. An uplink is sent once the duty cycle allows, takes
+     * its time on air, and is followed by the RX1 and RX2 windows, each of
+     * which may carry the downlink; the TX/RX is pending until the window
+     * that received it, or RX2, closed. Joins work alike with the join
+     * accept windows and are retried until accepted. A network time request
+     * is answered by a downlink to the next uplink that gets through.
+     */
+    class SimulatedLmic
+    {
+    public:
+        using EventCallback = std::function<void(const Event &)>;
+
+        SimulatedLmic(uint64_t &now_ms, const Link &link) : _now(now_ms), _link(link), _random(link.seed) {}
+
+        void setEventCallback(EventCallback callback) { _callback = std::move(callback); }
+
+        // Runs due jobs, returns the ms until the next one (a minute when idle).
+        uint32_t run()
+        {
+            while (!_jobs.empty() && _jobs.front().at <= _now)
+            {
+                const Job job = _jobs.front();
+                _jobs.erase(_jobs.begin());
+                execute(job);
+            }
+            return _jobs.empty() ? 60000 : static_cast<uint32_t>(_jobs.front().at - _now);
+        }
+
+        bool pending() const { return !_jobs.empty(); }
+        bool joined() const { return _joined; }
+        // Whether the data rate is left to network-side ADR
+        bool adr() const { return _link.adr; }
+
+        uint8_t dr = 5;
+
+        void join()
+        {
+            _joined = false;
+            // A join request is 23 bytes, 10 more than the LoRaWAN frame overhead
+            transmit(10, false, true);
+        }
+
+        // Queues an uplink of `size` application bytes.
+        void send(size_t size, bool confirmed) { transmit(size, confirmed, false); }
+
+        // Asks for the network time (DeviceTimeReq) along with the next uplink.
+        void requestNetworkTime() { _time_requested = true; }
+
+        const Statistics &statistics() const { return _statistics; }
+
+    private:
+        enum class JobType : uint8_t
+        {
+            TxEnd,
+            Rx1,
+            Rx2,
+            // A receive window closes, or the downlink in it ended
+            RxEnd,
+            Retry,
+        };
+
+        struct Job
+        {
+            uint64_t at;
+            JobType type;
+        };
+
+        void transmit(size_t size, bool confirmed, bool join)
+        {
+            _confirmed = confirmed;
+            _join = join;
+
+            const uint64_t start = std::max(_now, _band_free_ms);
+            _statistics.duty_cycle_wait_ms += start - _now;
+            const uint32_t airtime_ms = (Lora::Protocol::airtimeUs(dr, size) + 999) / 1000;
+            _band_free_ms = start + static_cast<uint64_t>(airtime_ms / _link.duty_cycle);
+            _statistics.uplink_airtime_ms += airtime_ms;
+            schedule({start + airtime_ms, JobType::TxEnd});
+        }
+
+        void execute(const Job &job)
+        {
+            switch (job.type)
+            {
+            case JobType::TxEnd:
+                txEnd(job.at);
+                break;
+            case JobType::Rx1:
+                receive(1, dr);
+                break;
+            case JobType::Rx2:
+                receive(2, RX2_DR);
+                break;
+            case JobType::RxEnd:
+                // The downlink ends the TX/RX, otherwise RX2 does
+                if (_received || _jobs.empty())
+                    complete(_received);
+                break;
+            case JobType::Retry:
+                join();
+                break;
+            }
+        }
+
+        void txEnd(uint64_t end)
+        {
+            if (!_join)
+            {
+                _statistics.uplinks++;
+                _statistics.confirmed += _confirmed;
+            }
+
+            bool answer = false;
+            if (chance(_link.uplink_loss))
+            {
+                _statistics.lost += !_join;
+            }
+            else
+            {
+                _statistics.delivered += !_join;
+                answer = _join || _confirmed || _time_requested || ++_since_mac_downlink >= _link.mac_downlink_interval;
+            }
+            // The network server answers in RX1, unless the gateway is busy then
+            _answer_window = answer ? (chance(0.8f) ? 1 : 2) : 0;
+            _received = false;
+
+            const uint32_t rx1_delay = _join ? JOIN_ACCEPT_DELAY_MS : RX1_DELAY_MS;
+            schedule({end + rx1_delay, JobType::Rx1});
+            schedule({end + rx1_delay + 1000, JobType::Rx2});
+        }
+
+        // Receive window `window` at `window_dr`; it stays open for the downlink, or 8 symbols without one.
+        void receive(uint8_t window, uint8_t window_dr)
+        {
+            if (_answer_window == window && !chance(_link.downlink_loss))
+            {
+                // Join accept, or an empty downlink carrying the ACK bit or MAC commands such as DeviceTimeAns
+                const size_t downlink_size = _join ? 4 : _time_requested ? 6 : 0;
+                const uint32_t airtime_ms = (Lora::Protocol::airtimeUs(window_dr, downlink_size) + 999) / 1000;
+                _statistics.downlink_airtime_ms += airtime_ms;
+                _statistics.downlinks++;
+                _received = true;
+                // No RX2 after a downlink in RX1
+                _jobs.clear();
+                schedule({_now + airtime_ms, JobType::RxEnd});
+                return;
+            }
+            schedule({_now + 8 * symbolMs(window_dr), JobType::RxEnd});
+        }
+
+        void complete(bool downlink)
+        {
+            if (_join)
+            {
+                if (!downlink)
+                {
+                    schedule({_now + JOIN_RETRY_MS, JobType::Retry});
+                    return;
+                }
+                _joined = true;
+                _statistics.joins++;
+                notify({Event::Type::Joined, false, true, _link.rssi, _link.snr, false});
+                return;
+            }
+
+            if (downlink)
+            {
+                _since_mac_downlink = 0;
+                _since_downlink = 0;
+                adapt();
+            }
+            else
+            {
+                backoff();
+            }
+            const bool acknowledged = downlink && _confirmed;
+            const bool network_time = downlink && _time_requested;
+            _statistics.acknowledged += acknowledged;
+            if (network_time)
+                _time_requested = false;
+            notify({Event::Type::TxComplete, acknowledged, downlink, _link.rssi, _link.snr, network_time});
+        }
+
+        // Network-side ADR: one data rate step up per 3 dB of SNR margin beyond the installation margin.
+        void adapt()
+        {
+            if (!_link.adr)
+                return;
+            const float margin = _link.snr - Lora::Wan::requiredSnr(dr) - Lora::Wan::LINK_INSTALLATION_MARGIN_DB;
+            if (margin >= 3.0f)
+                dr = std::min<int>(dr + static_cast<int>(margin / 3.0f), Lora::Wan::LINK_MAX_DR);
+        }
+
+        // The ADR backoff LMIC runs while ADR is on.
+        void backoff()
+        {
+            if (!_link.adr)
+                return;
+            _since_downlink++;
+            if (_since_downlink >= ADR_ACK_LIMIT + ADR_ACK_DELAY && (_since_downlink - ADR_ACK_LIMIT) % ADR_ACK_DELAY == 0 && dr > 0)
+                dr--;
+        }
+
+        void notify(const Event &event)
+        {
+            if (_callback)
+                _callback(event);
+        }
+
+        void schedule(const Job &job)
+        {
+            const auto position = std::upper_bound(_jobs.begin(), _jobs.end(), job, [](const Job &a, const Job &b)
+                                                   { return a.at < b.at; });
+            _jobs.insert(position, job);
+        }
+
+        bool chance(float probability) { return std::uniform_real_distribution<float>(0.0f, 1.0f)(_random) < probability; }
+
+        static uint32_t symbolMs(uint8_t window_dr)
+        {
+            const uint8_t sf = 12 - std::min<uint8_t>(window_dr, 5);
+            return std::max<uint32_t>((1u << sf) / 125, 1);
+        }
+
+        uint64_t &_now;
+        Link _link;
+        std::mt19937 _random;
+        EventCallback _callback;
+        std::vector<Job> _jobs;
+        Statistics _statistics;
+
+        bool _joined = false;
+        uint64_t _band_free_ms = 0;
+        uint32_t _since_mac_downlink = 0;
+        uint32_t _since_downlink = 0;
+        bool _confirmed = false;
+        bool _join = false;
+        bool _time_requested = false;
+        uint8_t _answer_window = 0;
+        bool _received = false;
+    };
+}
@@ -5,6 +5,36 @@
 namespace Configuration
 {
     Config Configurator::_config;
+    std::array<Configurator::Status, MAX_STATUS_KEYS> Configurator::_status;
+    size_t Configurator::_status_count = 0;
+
+    void Configurator::registerStatus(const char *key, StatusGetter getter)
+    {
+        if (_status_count == _status.size())
+        {
+            Serial.printf("Too many status keys, ignoring %s\n", key);
+            return;
+        }
+        _status[_status_count++] = {key, getter};
+    }
+
+    SCPLine *Configurator::applyStatusGet(const SCPLine *line)
+    {
+        for (size_t i = 0; i < _status_count; i++)
+        {
+            if (strcmp(line->as.k, _status[i].key) == 0)
+                return scp_line_new(SCPLineType::SET, _status[i].key, _status[i].getter().c_str());
+        }
+        return nullptr;
+    }
+
+    bool Configurator::set(const char *key, const char *value)
+    {
+        auto line = scp_line_new(SCPLineType::SET, key, value);
+        const bool applied = line != nullptr && _config.applySet(line);
+        scp_line_free(line);
+        return applied;
+    }
 
     void Configurator::setup()
     {
@@ -57,6 +87,8 @@ namespace Configuration
                 }
 
                 auto outputLine = _config.applyGet(l);
+                if (outputLine == nullptr)
+                    outputLine = applyStatusGet(l);
                 if (outputLine == nullptr)
                 {
                     const auto errorLine = scp_line_new(SCPLineType::SET, "error", "invalid key");
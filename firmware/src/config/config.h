@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <Arduino.h>
 #include <scp.h>
@@ -8,7 +9,14 @@
     X(appEUI)                \
     X(appKey)                \
     X(devEUI)                \
-    X(publishInterval)
+    X(publishInterval)       \
+    X(sampleInterval)        \
+    X(deadband)              \
+    X(keyframeInterval)      \
+    X(airtimeBudget)         \
+    X(processNoise)          \
+    X(airTemperature)        \
+    X(temperatureResolution)
 
 namespace Configuration
 {
@@ -73,14 +81,32 @@ namespace Configuration
         }
     };
 
+    // Upper bound of read-only status keys that can be registered.
+    constexpr size_t MAX_STATUS_KEYS = 16;
+
     class Configurator
     {
     public:
+        using StatusGetter = std::string (*)();
+
         static void setup();
         static void loop();
 
+        /**
+         * Registers a read-only key, e.g. a runtime counter, that a GET
+         * answers with the current value of `getter`. `key` must stay valid.
+         */
+        static void registerStatus(const char *key, StatusGetter getter);
+
         static bool configExists();
 
+        /**
+         * Sets `key` like an SCP SET line does, without saving the
+         * configuration. Returns false for an unknown key.
+         */
+        static bool set(const char *key, const char *value);
+        static void writeConfig();
+
         static Config &getConfig()
         {
             return _config;
@@ -88,8 +114,17 @@ namespace Configuration
 
     private:
         static Config loadConfig();
-        static void writeConfig();
+
+        static SCPLine *applyStatusGet(const SCPLine *line);
 
         static Config _config;
+
+        struct Status
+        {
+            const char *key;
+            StatusGetter getter;
+        };
+        static std::array<Status, MAX_STATUS_KEYS> _status;
+        static size_t _status_count;
     };
 }
@@ -0,0 +1,80 @@
+#include "./airtime.h"
+
+#include <cmath>
+
+namespace Lora::Protocol
+{
+    namespace
+    {
+        // Adds `airtime_ms` to the bucket of `period`, recycling it if it still holds an older period.
+        template <typename Bucket, size_t N>
+        void add(std::array<Bucket, N> &buckets, uint32_t period, uint32_t airtime_ms)
+        {
+            Bucket &bucket = buckets[period % N];
+            if (bucket.period != period)
+                bucket = {period, 0};
+            bucket.airtime_ms += airtime_ms;
+        }
+
+        // Sum of the buckets that belong to the last N periods up to `period`.
+        template <typename Bucket, size_t N>
+        uint32_t sum(const std::array<Bucket, N> &buckets, uint32_t period)
+        {
+            uint32_t total = 0;
+            for (const auto &bucket : buckets)
+            {
+                if (period - bucket.period < N)
+                    total += bucket.airtime_ms;
+            }
+            return total;
+        }
+    }
+
+    uint32_t airtimeUs(uint8_t dr, size_t payload_size)
+    {
+        const size_t phy_size = payload_size + LORAWAN_FRAME_OVERHEAD;
+
+        if (dr == 7)
+        {
+            // FSK: preamble 5, sync word 3, length 1, CRC 2 bytes at 50 kbps
+            return static_cast<uint32_t>((5 + 3 + 1 + phy_size + 2) * 8 * 20);
+        }
+
+        const int sf = dr < 6 ? 12 - dr : 7;
+        const double bandwidth = dr == 6 ? 250e3 : 125e3;
+        const double symbol_us = std::ldexp(1e6 / bandwidth, sf);
+        // Low data rate optimization is mandatory for symbols longer than 16 ms
+        const int low_data_rate = symbol_us > 16000 ? 1 : 0;
+
+        const int numerator = 8 * static_cast<int>(phy_size) - 4 * sf + 28 + 16;
+        const int denominator = 4 * (sf - 2 * low_data_rate);
+        const int payload_symbols = 8 + (numerator > 0 ? (numerator + denominator - 1) / denominator * 5 : 0);
+
+        return static_cast<uint32_t>(std::lround((8 + 4.25 + payload_symbols) * symbol_us));
+    }
+
+    void AirtimeLedger::record(uint32_t now_s, uint8_t band, uint32_t airtime_ms)
+    {
+        if (band >= AIRTIME_BANDS)
+            return;
+        add(_minutes[band], now_s / 60, airtime_ms);
+        add(_hours, now_s / 3600, airtime_ms);
+    }
+
+    uint32_t AirtimeLedger::hourly(uint32_t now_s, uint8_t band) const
+    {
+        return band < AIRTIME_BANDS ? sum(_minutes[band], now_s / 60) : 0;
+    }
+
+    uint32_t AirtimeLedger::daily(uint32_t now_s) const
+    {
+        return sum(_hours, now_s / 3600);
+    }
+
+    bool AirtimeLedger::allows(uint32_t now_s, uint8_t band, uint32_t airtime_ms, float duty_cycle, uint32_t daily_budget_ms) const
+    {
+        if (hourly(now_s, band) + airtime_ms > duty_cycle * 3600000)
+            return false;
+        return daily_budget_ms == 0 || daily(now_s) + airtime_ms <= daily_budget_ms;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Lora::Protocol
+{
+    // Bytes LoRaWAN adds to the application payload: MHDR, FHDR without FOpts, FPort, MIC.
+    constexpr size_t LORAWAN_FRAME_OVERHEAD = 13;
+
+    /**
+     * Time on air of an uplink with `payload_size` application bytes at
+     * EU868 data rate `dr` (DR0..DR5 SF12..SF7/125 kHz, DR6 SF7/250 kHz,
+     * DR7 FSK 50 kbps), per the Semtech SX127x/SX126x formula with an 8
+     * symbol preamble, explicit header, CRC and coding rate 4/5.
+     */
+    uint32_t airtimeUs(uint8_t dr, size_t payload_size);
+
+    /**
+     * Shortest interval between uplinks of `airtime_ms` each that stays
+     * within the duty cycle (e.g. 0.01 for 1 %) and a daily airtime budget
+     * (e.g. 30 s for the TTN fair use policy).
+     */
+    constexpr uint32_t minUplinkIntervalMs(uint32_t airtime_ms, float duty_cycle, uint32_t daily_budget_ms)
+    {
+        const uint64_t by_duty_cycle = static_cast<uint64_t>(airtime_ms / duty_cycle);
+        const uint64_t by_budget = daily_budget_ms > 0 ? static_cast<uint64_t>(airtime_ms) * 86400000 / daily_budget_ms : 0;
+        const uint64_t interval = by_duty_cycle > by_budget ? by_duty_cycle : by_budget;
+        return interval > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(interval);
+    }
+
+    // Sub-bands tracked separately, EU868 has g..g3 with their own duty cycles.
+    constexpr size_t AIRTIME_BANDS = 4;
+
+    /**
+     * Rolling record of the airtime spent, per band over the last hour (in
+     * one minute steps) and in total over the last 24 hours (in one hour
+     * steps). Times are in seconds of a monotonic clock.
+     */
+    class AirtimeLedger
+    {
+    public:
+        void record(uint32_t now_s, uint8_t band, uint32_t airtime_ms);
+
+        // Airtime spent in `band` during the last hour.
+        uint32_t hourly(uint32_t now_s, uint8_t band) const;
+
+        // Airtime spent in all bands during the last 24 hours.
+        uint32_t daily(uint32_t now_s) const;
+
+        /**
+         * Whether another `airtime_ms` in `band` keeps the last hour within
+         * `duty_cycle` and the last 24 hours within `daily_budget_ms`.
+         */
+        bool allows(uint32_t now_s, uint8_t band, uint32_t airtime_ms, float duty_cycle, uint32_t daily_budget_ms) const;
+
+    private:
+        struct Bucket
+        {
+            uint32_t period = 0;
+            uint32_t airtime_ms = 0;
+        };
+
+        std::array<std::array<Bucket, 60>, AIRTIME_BANDS> _minutes;
+        std::array<Bucket, 24> _hours;
+    };
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <variant>
+
+#include "protocol.h"
+
+namespace Lora::Protocol
+{
+    /**
+     * Collects samples of up to `Channels` numeric channels between two
+     * uplinks and hands them out as batch entries. Channels are told apart by
+     * their (MeasurementType, ChannelID) pair, not their position. Storage is
+     * fixed; once `MAX_BATCH_SAMPLES` samples are buffered the oldest one is
+     * dropped.
+     *
+     * A batch has no room for gaps, so a channel that misses a sample or
+     * reads NaN restarts its batch with the next sample.
+     */
+    template <size_t Channels>
+    class Batcher
+    {
+    public:
+        /**
+         * Records one sample for every float datapoint. Boolean datapoints
+         * cannot be batched and are ignored, as are channels beyond `Channels`.
+         */
+        void add(const DataPoint *data_points, size_t count)
+        {
+            if (_samples == MAX_BATCH_SAMPLES)
+            {
+                for (size_t slot = 0; slot < _slots; slot++)
+                {
+                    std::memmove(_values[slot].data(), _values[slot].data() + 1, (MAX_BATCH_SAMPLES - 1) * sizeof(float));
+                    if (_first[slot] > 0)
+                        _first[slot]--;
+                }
+                _samples--;
+            }
+
+            std::array<bool, Channels> sampled{};
+            for (size_t i = 0; i < count; i++)
+            {
+                const float *value = std::get_if<float>(&data_points[i].value);
+                if (value == nullptr)
+                    continue;
+
+                const size_t slot = find(data_points[i]);
+                if (slot == Channels)
+                    continue;
+
+                _values[slot][_samples] = *value;
+                sampled[slot] = !std::isnan(*value);
+            }
+
+            for (size_t slot = 0; slot < _slots; slot++)
+            {
+                if (!sampled[slot])
+                    _first[slot] = _samples + 1;
+            }
+            _samples++;
+        }
+
+        /**
+         * Writes one batch per channel to `batches`, which must have room for
+         * `Channels` entries, with samples `period_s` seconds apart. Each
+         * batch ends with the most recent sample; channels without one are
+         * left out. The batches point into the batcher and stay valid until
+         * the next call to `add` or `clear`.
+         *
+         * @return the number of batches written.
+         */
+        size_t batches(Batch *batches, uint16_t period_s) const
+        {
+            size_t count = 0;
+            for (size_t slot = 0; slot < _slots; slot++)
+            {
+                if (_first[slot] >= _samples)
+                    continue;
+
+                const MeasurementType type = _types[slot];
+                batches[count++] = {type, _channel_ids[slot], batch_scale(type), period_s, _values[slot].data() + _first[slot],
+                                    static_cast<uint8_t>(_samples - _first[slot])};
+            }
+
+            return count;
+        }
+
+        void clear()
+        {
+            _slots = 0;
+            _samples = 0;
+        }
+
+        size_t samples() const { return _samples; }
+
+    private:
+        // Slot of the channel of `data_point`, taking a free one for a new channel; `Channels` if none is left.
+        size_t find(const DataPoint &data_point)
+        {
+            for (size_t slot = 0; slot < _slots; slot++)
+            {
+                if (_types[slot] == data_point.measurement_type && _channel_ids[slot] == data_point.channel_id)
+                    return slot;
+            }
+
+            if (_slots == Channels)
+                return Channels;
+
+            _types[_slots] = data_point.measurement_type;
+            _channel_ids[_slots] = data_point.channel_id;
+            _first[_slots] = _samples;
+            return _slots++;
+        }
+
+        size_t _slots = 0;
+        size_t _samples = 0;
+        std::array<MeasurementType, Channels> _types;
+        std::array<ChannelID, Channels> _channel_ids;
+        // Oldest sample of each channel's current batch, `_samples` or more if it has none
+        std::array<size_t, Channels> _first;
+        std::array<std::array<float, MAX_BATCH_SAMPLES>, Channels> _values;
+    };
+}
@@ -0,0 +1,119 @@
+#include "./change-tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Lora::Protocol
+{
+    namespace
+    {
+        constexpr uint8_t header(const DataPoint &dp)
+        {
+            return static_cast<uint8_t>(dp.measurement_type) << 4 | static_cast<uint8_t>(dp.channel_id);
+        }
+    }
+
+    void ChangeTracker::configure(float deadband, uint16_t keyframe_interval)
+    {
+        _deadband = deadband;
+        _keyframe_interval = keyframe_interval;
+    }
+
+    size_t ChangeTracker::select(const DataPoint *data_points, size_t count, DataPoint *selected, bool &keyframe)
+    {
+        count = std::min(count, MAX_TRACKED_CHANNELS);
+
+        keyframe = !_has_reference || (_keyframe_interval > 0 && _frames_since_keyframe + 1 >= _keyframe_interval);
+
+        size_t selected_count = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (keyframe || changed(data_points[i]))
+                selected[selected_count++] = data_points[i];
+        }
+
+        std::copy(selected, selected + selected_count, _pending.begin());
+        _pending_count = selected_count;
+        _pending_keyframe = keyframe;
+        _has_pending = true;
+        _pending_sent = false;
+
+        return selected_count;
+    }
+
+    void ChangeTracker::sent(uint32_t frame)
+    {
+        if (!_has_pending)
+            return;
+        _pending_sent = true;
+        _pending_frame = frame;
+    }
+
+    void ChangeTracker::acknowledge(uint32_t frame)
+    {
+        if (!_has_pending || !_pending_sent || frame != _pending_frame)
+            return;
+        _has_pending = false;
+
+        if (_pending_keyframe)
+        {
+            _acknowledged_count = 0;
+            _frames_since_keyframe = 0;
+            _has_reference = true;
+        }
+        else
+        {
+            _frames_since_keyframe++;
+        }
+
+        for (size_t i = 0; i < _pending_count; i++)
+        {
+            const uint8_t h = header(_pending[i]);
+            Entry *entry = find(h);
+            if (entry != nullptr)
+                entry->data_point = _pending[i];
+            else if (_acknowledged_count < _acknowledged.size())
+                _acknowledged[_acknowledged_count++] = {h, _pending[i]};
+        }
+    }
+
+    void ChangeTracker::invalidate()
+    {
+        _has_reference = false;
+        _has_pending = false;
+        _acknowledged_count = 0;
+        _frames_since_keyframe = 0;
+    }
+
+    ChangeTracker::Entry *ChangeTracker::find(uint8_t h)
+    {
+        for (size_t i = 0; i < _acknowledged_count; i++)
+        {
+            if (_acknowledged[i].header == h)
+                return &_acknowledged[i];
+        }
+        return nullptr;
+    }
+
+    const ChangeTracker::Entry *ChangeTracker::find(uint8_t h) const
+    {
+        return const_cast<ChangeTracker *>(this)->find(h);
+    }
+
+    bool ChangeTracker::changed(const DataPoint &dp) const
+    {
+        const Entry *entry = find(header(dp));
+        if (entry == nullptr || entry->data_point.value.index() != dp.value.index())
+            return true;
+
+        if (const bool *val = std::get_if<bool>(&dp.value))
+            return *val != std::get<bool>(entry->data_point.value);
+
+        const float current = std::get<float>(dp.value);
+        const float previous = std::get<float>(entry->data_point.value);
+        if (std::isnan(current) || std::isnan(previous))
+            return std::isnan(current) != std::isnan(previous);
+
+        return std::fabs(current - previous) > _deadband;
+    }
+}
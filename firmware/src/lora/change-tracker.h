@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace Lora::Protocol
+{
+    // Number of distinct (MeasurementType, ChannelID) pairs that are tracked.
+    constexpr size_t MAX_TRACKED_CHANNELS = 16;
+
+    /**
+     * Decides which datapoints are worth sending by comparing them with the
+     * last frame the network acknowledged. Only channels that moved by more
+     * than the deadband go out, in frames marked with `ControlCode::Delta`.
+     * Every `keyframe_interval`-th frame is a full, unmarked keyframe so the
+     * backend can resync.
+     */
+    class ChangeTracker
+    {
+    public:
+        /**
+         * @param deadband          float channels that moved by at most this much are not sent
+         * @param keyframe_interval number of frames between two keyframes
+         */
+        void configure(float deadband, uint16_t keyframe_interval);
+
+        /**
+         * Copies the datapoints that have to be sent to `selected`, which must
+         * have room for `count` entries; at most `MAX_TRACKED_CHANNELS` are
+         * considered. The result is remembered as pending until it was
+         * acknowledged or the next call to `select`.
+         *
+         * @param keyframe set to whether the selection is a full keyframe
+         * @return the number of datapoints selected, 0 if nothing changed
+         */
+        size_t select(const DataPoint *data_points, size_t count, DataPoint *selected, bool &keyframe);
+
+        // The last of the pending selection went out in the uplink numbered `frame`.
+        void sent(uint32_t frame);
+
+        // The uplink numbered `frame` was delivered; if it carried the pending selection, that becomes the new reference.
+        void acknowledge(uint32_t frame);
+
+        // Forgets the reference, so the next frame is a keyframe (e.g. after a rejoin).
+        void invalidate();
+
+    private:
+        struct Entry
+        {
+            uint8_t header = 0;
+            DataPoint data_point;
+        };
+
+        Entry *find(uint8_t header);
+        const Entry *find(uint8_t header) const;
+        bool changed(const DataPoint &data_point) const;
+
+        // Every member is initialized in place: a constant-initialized tracker is not reset by the
+        // startup code after a deep sleep, which keeps it in RTC memory.
+        float _deadband = 0;
+        uint16_t _keyframe_interval = 0;
+        uint16_t _frames_since_keyframe = 0;
+
+        std::array<Entry, MAX_TRACKED_CHANNELS> _acknowledged;
+        size_t _acknowledged_count = 0;
+
+        std::array<DataPoint, MAX_TRACKED_CHANNELS> _pending;
+        size_t _pending_count = 0;
+        bool _pending_keyframe = false;
+        bool _has_pending = false;
+        bool _pending_sent = false;
+        uint32_t _pending_frame = 0;
+        bool _has_reference = false;
+    };
+}
@@ -0,0 +1,95 @@
+#include "./config-downlink.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#include "./varint.h"
+
+namespace Lora::Protocol
+{
+    namespace
+    {
+        constexpr uint8_t KIND_NUMBER = 0;
+        constexpr uint8_t KIND_TEXT = 1;
+
+        // Must list the keys in the order of their ConfigKey id.
+        constexpr const char *CONFIG_KEY_NAMES[] = {
+            "publishInterval",
+            "sampleInterval",
+            "deadband",
+            "keyframeInterval",
+            "airtimeBudget",
+        };
+    }
+
+    const char *configKeyName(uint8_t key)
+    {
+        return key < std::size(CONFIG_KEY_NAMES) ? CONFIG_KEY_NAMES[key] : nullptr;
+    }
+
+    ConfigStatus parseConfigDownlink(const uint8_t *payload, size_t length, ConfigDownlink &downlink)
+    {
+        downlink.count = 0;
+        if (length == 0)
+            return ConfigStatus::Malformed;
+
+        downlink.sequence = payload[0];
+        bool unknown_key = false;
+
+        size_t position = 1;
+        while (position < length)
+        {
+            if (downlink.count == downlink.settings.size())
+                return ConfigStatus::Malformed;
+
+            const uint8_t header = payload[position++];
+            ConfigSetting &setting = downlink.settings[downlink.count];
+            setting.key = configKeyName(header & 0x3f);
+            unknown_key = unknown_key || setting.key == nullptr;
+
+            switch (header >> 6)
+            {
+            case KIND_NUMBER:
+            {
+                uint64_t value;
+                const size_t read = Varint::read(payload + position, length - position, value);
+                if (read == 0)
+                    return ConfigStatus::Malformed;
+                position += read;
+                snprintf(setting.value, sizeof(setting.value), "%llu", static_cast<unsigned long long>(value));
+                break;
+            }
+            case KIND_TEXT:
+            {
+                if (position == length)
+                    return ConfigStatus::Malformed;
+                const size_t text_length = payload[position++];
+                if (text_length > MAX_CONFIG_VALUE_LENGTH || text_length > length - position)
+                    return ConfigStatus::Malformed;
+                // SCP values cannot contain `=` or line breaks
+                for (size_t i = 0; i < text_length; i++)
+                {
+                    if (payload[position + i] < ' ' || payload[position + i] == '=')
+                        return ConfigStatus::Malformed;
+                }
+                memcpy(setting.value, payload + position, text_length);
+                setting.value[text_length] = '\0';
+                position += text_length;
+                break;
+            }
+            default:
+                return ConfigStatus::Malformed;
+            }
+
+            downlink.count++;
+        }
+
+        if (unknown_key)
+        {
+            downlink.count = 0;
+            return ConfigStatus::UnknownKey;
+        }
+        return ConfigStatus::Applied;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace Lora::Protocol
+{
+    // FPort config downlinks are sent to, any other port is left alone.
+    constexpr uint8_t CONFIG_FPORT = 10;
+
+    // Most settings a single downlink carries.
+    constexpr size_t MAX_CONFIG_SETTINGS = 8;
+
+    // Longest value a setting carries, in characters.
+    constexpr size_t MAX_CONFIG_VALUE_LENGTH = 31;
+
+    /**
+     * Config keys by their id on the wire. Only keys that are safe to change
+     * remotely have one; the keys of the session do not.
+     */
+    enum class ConfigKey : uint8_t
+    {
+        PublishInterval = 0,
+        SampleInterval = 1,
+        Deadband = 2,
+        KeyframeInterval = 3,
+        AirtimeBudget = 4,
+    };
+
+    // Name of the config key with the id `key`, or nullptr for an unknown id.
+    const char *configKeyName(uint8_t key);
+
+    struct ConfigSetting
+    {
+        const char *key;
+        char value[MAX_CONFIG_VALUE_LENGTH + 1];
+    };
+
+    /**
+     * A config downlink, received on `CONFIG_FPORT`:
+     *
+     *     sequence                  uint8, echoed by the ConfigAck entry of the next uplink
+     *     setting[]                 until the end of the payload
+     *
+     * where a setting is
+     *
+     *     kind << 6 | key           ConfigKey id in the low six bits
+     *     value                     kind 0: varint, set as its decimal representation
+     *                               kind 1: uint8 length followed by that many characters
+     *
+     * Values end up as SCP config values, i.e. text, so a number is only a
+     * more compact way of writing it.
+     */
+    struct ConfigDownlink
+    {
+        uint8_t sequence = 0;
+        std::array<ConfigSetting, MAX_CONFIG_SETTINGS> settings;
+        size_t count = 0;
+    };
+
+    /**
+     * Parses a config downlink. The settings are only valid when the result
+     * is `ConfigStatus::Applied`, a downlink is taken as a whole or not at all.
+     */
+    ConfigStatus parseConfigDownlink(const uint8_t *payload, size_t length, ConfigDownlink &downlink);
+}
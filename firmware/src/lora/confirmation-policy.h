@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Lora::Wan
+{
+    // Frames carrying a datapoint of at least this priority (see `Protocol::defaultPriority`) are sent confirmed.
+    constexpr uint8_t CONFIRMED_PRIORITY = 2;
+
+    // Retries of a confirmed uplink that was not acknowledged, after the first attempt.
+    constexpr uint8_t CONFIRMED_MAX_RETRIES = 3;
+
+    // Failed attempts after which a retry goes out at the next lower data rate.
+    constexpr uint8_t CONFIRMED_STEP_DOWN_AFTER = 2;
+
+    // Backoff before the first retry, doubled for every further one up to the maximum.
+    constexpr uint32_t CONFIRMED_BACKOFF_MS = 8000;
+    constexpr uint32_t CONFIRMED_BACKOFF_MAX_MS = 300000;
+
+    // Confirmed uplinks per 24 hours; each acknowledgement is a downlink,
+    // and TTN allows 10 a day.
+    constexpr size_t CONFIRMED_MAX_PER_DAY = 10;
+
+    /**
+     * Decides which uplinks go out confirmed and how an unacknowledged one is
+     * retried. Only frames carrying critical channels are confirmed, and only
+     * `CONFIRMED_MAX_PER_DAY` of them, as every acknowledgement costs a
+     * downlink; retries do not count, the gateway did not answer them.
+     * Times are in seconds of a monotonic clock.
+     */
+    class ConfirmationPolicy
+    {
+    public:
+        // Whether a frame whose most critical datapoint has `priority` is to be sent confirmed at `now_s`.
+        bool confirm(uint8_t priority, uint32_t now_s) const
+        {
+            if (priority < CONFIRMED_PRIORITY)
+                return false;
+            // Full once the oldest of the last confirmed uplinks is younger than a day
+            return _count < _sent_s.size() || now_s - _sent_s[_next] >= 24 * 60 * 60;
+        }
+
+        // A confirmed uplink was sent for the first time.
+        void sent(uint32_t now_s)
+        {
+            _sent_s[_next] = now_s;
+            _next = (_next + 1) % _sent_s.size();
+            if (_count < _sent_s.size())
+                _count++;
+            _failures = 0;
+        }
+
+        void delivered() { _failures = 0; }
+
+        /**
+         * The last attempt was not acknowledged.
+         *
+         * @return whether to retry it.
+         */
+        bool failed()
+        {
+            _failures++;
+            if (_failures <= CONFIRMED_MAX_RETRIES)
+                return true;
+            _failures = 0;
+            return false;
+        }
+
+        // Whether the retry goes out at a lower data rate.
+        bool stepDown() const { return _failures >= CONFIRMED_STEP_DOWN_AFTER; }
+
+        /**
+         * Delay before the next retry: exponential in the failed attempts,
+         * with half of it jittered by `random` so that devices which failed
+         * together do not retry together.
+         */
+        uint32_t backoffMs(uint32_t random) const
+        {
+            const uint8_t doublings = _failures > 0 ? _failures - 1 : 0;
+            const uint32_t backoff = doublings < 16 ? std::min<uint32_t>(CONFIRMED_BACKOFF_MS << doublings, CONFIRMED_BACKOFF_MAX_MS)
+                                                    : CONFIRMED_BACKOFF_MAX_MS;
+            return backoff / 2 + random % (backoff / 2 + 1);
+        }
+
+    private:
+        std::array<uint32_t, CONFIRMED_MAX_PER_DAY> _sent_s{};
+        size_t _next = 0;
+        size_t _count = 0;
+        uint8_t _failures = 0;
+    };
+}
@@ -0,0 +1,499 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+#include "protocol.h"
+#include "quantization.h"
+#include "varint.h"
+
+// Reference decoder for regenfass uplinks, bit-exact with `Encoder`.
+//
+// Header-only and free of allocations, so the same code runs on the device,
+// in the native tests and in ingestion services:
+//
+//     for (const auto &entry : Lora::Protocol::decode(payload, length))
+//     {
+//         switch (entry.kind) { ... }
+//     }
+//
+// `decodeFrames` decodes many frames at once into caller-owned column arrays.
+namespace Lora::Protocol
+{
+    /**
+     * Decodes a flags entry written by `Encoder::addFlags`.
+     *
+     * @return the number of bytes consumed, or 0 if `in` does not hold a
+     *         complete flags entry.
+     */
+    inline size_t decodeFlags(const uint8_t *in, size_t length, uint16_t &values, ChannelID &highest)
+    {
+        if (length < 1 || static_cast<MeasurementType>(in[0] >> 4) != MeasurementType::Flags)
+            return 0;
+
+        highest = static_cast<ChannelID>(in[0] & 0x0f);
+        const size_t size = flags_packed_size(highest);
+        if (length < size)
+            return 0;
+
+        values = in[1];
+        if (size == 3)
+            values |= in[2] << 8;
+
+        return size;
+    }
+
+    /**
+     * Decodes a single datapoint, using the quantized encodings if the frame
+     * carried a `ControlCode::Quantized` entry before it.
+     *
+     * @return the number of bytes consumed, or 0 if `in` does not hold a
+     *         complete datapoint.
+     */
+    inline size_t decodeDataPoint(const uint8_t *in, size_t length, bool quantized, DataPoint &dp)
+    {
+        if (length < 2)
+            return 0;
+
+        dp.measurement_type = static_cast<MeasurementType>(in[0] >> 4);
+        dp.channel_id = static_cast<ChannelID>(in[0] & 0x0f);
+
+        if (dp.measurement_type == MeasurementType::Boolean)
+        {
+            dp.value = in[1] != 0;
+            return 2;
+        }
+
+        if (static_cast<uint8_t>(dp.measurement_type) > static_cast<uint8_t>(MeasurementType::SoundLevel))
+            return 0;
+
+        const Quantization q = quantization(dp.measurement_type);
+        if (quantized && q.enabled())
+        {
+            if (length < 1 + QUANTIZED_VALUE_SIZE)
+                return 0;
+            dp.value = dequantize(q, static_cast<uint16_t>(in[1] | in[2] << 8));
+            return 1 + QUANTIZED_VALUE_SIZE;
+        }
+
+        if (length < 1 + sizeof(float))
+            return 0;
+        float value;
+        std::memcpy(&value, in + 1, sizeof(float));
+        dp.value = value;
+        return 1 + sizeof(float);
+    }
+
+    /**
+     * A batch entry whose samples are decoded on demand, straight from the
+     * frame it points into.
+     */
+    class BatchView
+    {
+    public:
+        MeasurementType measurement_type;
+        ChannelID channel_id;
+        int8_t scale;
+        uint16_t period_s;
+        uint8_t count;
+
+        /**
+         * Parses the batch entry starting at its control byte and checks all
+         * of its samples.
+         *
+         * @return the number of bytes consumed, or 0 if `in` does not hold a
+         *         valid batch entry.
+         */
+        size_t parse(const uint8_t *in, size_t length)
+        {
+            if (length < 5 || in[0] != (static_cast<uint8_t>(MeasurementType::Control) << 4 | static_cast<uint8_t>(ControlCode::Batch)))
+                return 0;
+
+            measurement_type = static_cast<MeasurementType>(in[1] >> 4);
+            channel_id = static_cast<ChannelID>(in[1] & 0x0f);
+            scale = static_cast<int8_t>(in[2]);
+            size_t offset = 3;
+
+            uint64_t value;
+            size_t consumed = Varint::read(in + offset, length - offset, value);
+            if (consumed == 0 || value > UINT16_MAX || offset + consumed >= length)
+                return 0;
+            period_s = static_cast<uint16_t>(value);
+            offset += consumed;
+
+            count = in[offset++];
+            if (count == 0 || count > MAX_BATCH_SAMPLES)
+                return 0;
+
+            _samples = in + offset;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                consumed = Varint::read(in + offset, length - offset, value);
+                if (consumed == 0)
+                    return 0;
+                offset += consumed;
+            }
+            _samples_length = in + offset - _samples;
+
+            return offset;
+        }
+
+        // Calls `visit(index, value)` for every sample, oldest first.
+        template <typename Visit>
+        void forEach(Visit visit) const
+        {
+            const float step = std::pow(10.0f, scale);
+            const uint8_t *in = _samples;
+            const uint8_t *end = _samples + _samples_length;
+            int64_t current = 0;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                uint64_t value;
+                in += Varint::read(in, end - in, value);
+                current += Varint::unzigzag(value);
+                visit(i, static_cast<float>(current) * step);
+            }
+        }
+
+        // Decodes up to `capacity` samples into `out` and returns how many were written.
+        size_t samples(float *out, size_t capacity) const
+        {
+            size_t written = 0;
+            forEach([&](uint8_t i, float value)
+                    {
+                        if (i < capacity)
+                        {
+                            out[i] = value;
+                            written++;
+                        } });
+            return written;
+        }
+
+    private:
+        const uint8_t *_samples = nullptr;
+        size_t _samples_length = 0;
+    };
+
+    // A fully decoded batch entry, for callers that prefer a copy over a `BatchView`.
+    struct DecodedBatch
+    {
+        MeasurementType measurement_type;
+        ChannelID channel_id;
+        int8_t scale;
+        uint16_t period_s;
+        uint8_t count;
+        std::array<float, MAX_BATCH_SAMPLES> samples;
+    };
+
+    /**
+     * Decodes a batch entry starting at its control byte.
+     *
+     * @return the number of bytes consumed, or 0 if `in` does not hold a valid
+     *         batch entry.
+     */
+    inline size_t decodeBatch(const uint8_t *in, size_t length, DecodedBatch &batch)
+    {
+        BatchView view;
+        const size_t consumed = view.parse(in, length);
+        if (consumed == 0)
+            return 0;
+
+        batch.measurement_type = view.measurement_type;
+        batch.channel_id = view.channel_id;
+        batch.scale = view.scale;
+        batch.period_s = view.period_s;
+        batch.count = view.count;
+        view.samples(batch.samples.data(), batch.samples.size());
+        return consumed;
+    }
+
+    // One entry of a frame.
+    struct Entry
+    {
+        enum class Kind : uint8_t
+        {
+            DataPoint,
+            Flags,
+            Batch,
+            // A control entry such as ControlCode::Delta or ControlCode::Timestamp
+            Control,
+            // Malformed input, always the last entry of a frame
+            Invalid,
+        };
+
+        Kind kind;
+        DataPoint data_point;           // Kind::DataPoint
+        uint16_t flags;                 // Kind::Flags, bit i is Boolean channel i
+        ChannelID highest_flag;         // Kind::Flags
+        BatchView batch;                // Kind::Batch
+        ControlCode control;            // Kind::Control
+        uint32_t time_s;                // ControlCode::Timestamp (GPS seconds) or ControlCode::Offset
+        uint8_t config_sequence;        // ControlCode::ConfigAck
+        ConfigStatus config_status;     // ControlCode::ConfigAck
+        LinkStatus link_status;         // ControlCode::LinkStatus
+    };
+
+    /**
+     * Forward range over the entries of one frame. Iterating never allocates;
+     * batches are handed out as views into the frame.
+     */
+    class Frame
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Entry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Entry *;
+            using reference = const Entry &;
+
+            iterator() = default;
+            iterator(const uint8_t *position, const uint8_t *end) : _position(position), _end(end) { parse(); }
+
+            reference operator*() const { return _entry; }
+            pointer operator->() const { return &_entry; }
+
+            iterator &operator++()
+            {
+                _position += _size;
+                parse();
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator previous = *this;
+                ++*this;
+                return previous;
+            }
+
+            bool operator==(const iterator &other) const { return _position == other._position; }
+            bool operator!=(const iterator &other) const { return _position != other._position; }
+
+        private:
+            void parse()
+            {
+                const size_t length = _end - _position;
+                if (length == 0)
+                    return;
+
+                const auto type = static_cast<MeasurementType>(_position[0] >> 4);
+                if (type == MeasurementType::Flags)
+                {
+                    _entry.kind = Entry::Kind::Flags;
+                    _size = decodeFlags(_position, length, _entry.flags, _entry.highest_flag);
+                }
+                else if (type == MeasurementType::Control)
+                {
+                    const auto code = static_cast<ControlCode>(_position[0] & 0x0f);
+                    switch (code)
+                    {
+                    case ControlCode::Batch:
+                        _entry.kind = Entry::Kind::Batch;
+                        _size = _entry.batch.parse(_position, length);
+                        break;
+                    case ControlCode::Quantized:
+                        _quantized = true;
+                        // fall through
+                    case ControlCode::Delta:
+                        _entry.kind = Entry::Kind::Control;
+                        _entry.control = code;
+                        _size = 1;
+                        break;
+                    case ControlCode::Timestamp:
+                        _entry.kind = Entry::Kind::Control;
+                        _entry.control = code;
+                        _size = length < TIMESTAMP_PACKED_SIZE ? 0 : TIMESTAMP_PACKED_SIZE;
+                        if (_size > 0)
+                            _entry.time_s = _position[1] | _position[2] << 8 | _position[3] << 16 | static_cast<uint32_t>(_position[4]) << 24;
+                        break;
+                    case ControlCode::Offset:
+                    {
+                        uint64_t offset_s;
+                        _entry.kind = Entry::Kind::Control;
+                        _entry.control = code;
+                        _size = Varint::read(_position + 1, length - 1, offset_s);
+                        if (_size > 0 && offset_s <= UINT32_MAX)
+                        {
+                            _entry.time_s = static_cast<uint32_t>(offset_s);
+                            _size++;
+                        }
+                        else
+                        {
+                            _size = 0;
+                        }
+                        break;
+                    }
+                    case ControlCode::ConfigAck:
+                        _entry.kind = Entry::Kind::Control;
+                        _entry.control = code;
+                        _size = length < CONFIG_ACK_PACKED_SIZE ? 0 : CONFIG_ACK_PACKED_SIZE;
+                        if (_size > 0)
+                        {
+                            _entry.config_sequence = _position[1];
+                            _entry.config_status = static_cast<ConfigStatus>(_position[2]);
+                        }
+                        break;
+                    case ControlCode::LinkStatus:
+                        _entry.kind = Entry::Kind::Control;
+                        _entry.control = code;
+                        _size = length < LINK_STATUS_PACKED_SIZE ? 0 : LINK_STATUS_PACKED_SIZE;
+                        if (_size > 0)
+                            _entry.link_status = {_position[1], static_cast<int8_t>(_position[2]), static_cast<int16_t>(-_position[3]),
+                                                  static_cast<int8_t>(_position[4])};
+                        break;
+                    default:
+                        _size = 0;
+                        break;
+                    }
+                }
+                else
+                {
+                    _entry.kind = Entry::Kind::DataPoint;
+                    _size = decodeDataPoint(_position, length, _quantized, _entry.data_point);
+                }
+
+                if (_size == 0)
+                {
+                    // Swallow the rest of the frame so that iteration ends after this entry
+                    _entry.kind = Entry::Kind::Invalid;
+                    _size = length;
+                }
+            }
+
+            const uint8_t *_position = nullptr;
+            const uint8_t *_end = nullptr;
+            size_t _size = 0;
+            bool _quantized = false;
+            Entry _entry{};
+        };
+
+        Frame(const uint8_t *data, size_t length) : _data(data), _length(length) {}
+
+        iterator begin() const { return iterator(_data, _data + _length); }
+        iterator end() const { return iterator(_data + _length, _data + _length); }
+
+    private:
+        const uint8_t *_data;
+        size_t _length;
+    };
+
+    inline Frame decode(const uint8_t *data, size_t length)
+    {
+        return Frame(data, length);
+    }
+
+    /**
+     * Caller-owned column arrays for `decodeFrames`, one row per value. Every
+     * array must hold `capacity` elements.
+     */
+    struct Columns
+    {
+        uint32_t *frame;                   // index of the frame the row came from
+        MeasurementType *measurement_type;
+        ChannelID *channel_id;
+        float *value;                      // Booleans as 0 or 1
+        int32_t *offset_s;                 // seconds relative to `timestamp`, negative for older batch samples
+        uint32_t *timestamp;               // GPS seconds from the frame's timestamp entry, 0 if it had none
+        size_t capacity;
+    };
+
+    struct DecodeResult
+    {
+        size_t rows = 0;
+        size_t invalid_frames = 0;
+        // Set when the columns ran out of space; `rows` then covers the frames before that
+        bool truncated = false;
+    };
+
+    /**
+     * Decodes `count` frames into `columns`. A malformed frame contributes
+     * no rows and is counted in `invalid_frames`. Rows of a frame without a
+     * timestamp entry are relative to the time the frame was received.
+     */
+    inline DecodeResult decodeFrames(const uint8_t *const *frames, const size_t *lengths, size_t count, const Columns &columns)
+    {
+        DecodeResult result;
+
+        for (size_t f = 0; f < count; f++)
+        {
+            size_t row = result.rows;
+            bool valid = true;
+            uint32_t timestamp = 0;
+            int32_t base_offset_s = 0;
+
+            auto emit = [&](MeasurementType type, ChannelID channel, float value, int32_t offset_s)
+            {
+                if (row == columns.capacity)
+                    return false;
+                columns.frame[row] = static_cast<uint32_t>(f);
+                columns.measurement_type[row] = type;
+                columns.channel_id[row] = channel;
+                columns.value[row] = value;
+                columns.offset_s[row] = base_offset_s + offset_s;
+                columns.timestamp[row] = timestamp;
+                row++;
+                return true;
+            };
+
+            bool fits = true;
+            for (const auto &entry : decode(frames[f], lengths[f]))
+            {
+                switch (entry.kind)
+                {
+                case Entry::Kind::DataPoint:
+                {
+                    const auto &dp = entry.data_point;
+                    const float *value = std::get_if<float>(&dp.value);
+                    fits = emit(dp.measurement_type, dp.channel_id, value ? *value : std::get<bool>(dp.value), 0);
+                    break;
+                }
+                case Entry::Kind::Flags:
+                    for (uint8_t channel = 0; fits && channel <= static_cast<uint8_t>(entry.highest_flag); channel++)
+                        fits = emit(MeasurementType::Boolean, static_cast<ChannelID>(channel), (entry.flags >> channel) & 1, 0);
+                    break;
+                case Entry::Kind::Batch:
+                {
+                    const auto &batch = entry.batch;
+                    batch.forEach([&](uint8_t i, float value)
+                                  { fits = fits && emit(batch.measurement_type, batch.channel_id, value,
+                                                        -static_cast<int32_t>(batch.count - 1 - i) * batch.period_s); });
+                    break;
+                }
+                case Entry::Kind::Control:
+                    if (entry.control == ControlCode::Timestamp)
+                        timestamp = entry.time_s;
+                    else if (entry.control == ControlCode::Offset)
+                        base_offset_s = static_cast<int32_t>(std::min<uint32_t>(entry.time_s, INT32_MAX));
+                    break;
+                case Entry::Kind::Invalid:
+                    valid = false;
+                    break;
+                }
+
+                if (!fits || !valid)
+                    break;
+            }
+
+            if (!fits)
+            {
+                result.truncated = true;
+                break;
+            }
+
+            if (valid)
+                result.rows = row;
+            else
+                result.invalid_frames++;
+        }
+
+        return result;
+    }
+}
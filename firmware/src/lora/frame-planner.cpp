@@ -0,0 +1,61 @@
+#include "./frame-planner.h"
+
+namespace Lora::Protocol
+{
+    size_t FramePlanner::plan(const DataPoint *data_points, const uint8_t *priorities, size_t count,
+                              size_t max_payload, size_t frame_overhead, bool quantized)
+    {
+        _count = 0;
+        if (count == 0 || count > MAX_PLANNED_DATA_POINTS || frame_overhead >= max_payload)
+            return 0;
+
+        // Stable insertion sort of the indices by descending priority
+        std::array<uint8_t, MAX_PLANNED_DATA_POINTS> order;
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t j = i;
+            while (j > 0 && priorities[order[j - 1]] < priorities[i])
+            {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = static_cast<uint8_t>(i);
+        }
+
+        // Bytes used per frame, there are never more frames than datapoints
+        std::array<size_t, MAX_PLANNED_DATA_POINTS> used;
+        size_t frames = 0;
+
+        for (size_t k = 0; k < count; k++)
+        {
+            const size_t index = order[k];
+            const size_t size = packed_size(data_points[index], quantized);
+            if (frame_overhead + size > max_payload)
+                return 0;
+
+            size_t frame = 0;
+            while (frame < frames && used[frame] + size > max_payload)
+                frame++;
+
+            if (frame == frames)
+                used[frames++] = frame_overhead;
+
+            used[frame] += size;
+            _frame_of[index] = static_cast<uint8_t>(frame);
+        }
+
+        _count = count;
+        return frames;
+    }
+
+    size_t FramePlanner::collect(const DataPoint *data_points, size_t frame, DataPoint *out) const
+    {
+        size_t collected = 0;
+        for (size_t i = 0; i < _count; i++)
+        {
+            if (_frame_of[i] == frame)
+                out[collected++] = data_points[i];
+        }
+        return collected;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace Lora::Protocol
+{
+    // Largest application payload per EU868 data rate (DR0..DR7), assuming no FOpts.
+    constexpr std::array<uint8_t, 8> EU868_MAX_PAYLOAD_SIZE = {51, 51, 51, 115, 222, 222, 222, 222};
+
+    // Largest application payload at EU868 data rate `dr`; unknown rates get the smallest one.
+    constexpr size_t maxPayloadSize(uint8_t dr)
+    {
+        return dr < EU868_MAX_PAYLOAD_SIZE.size() ? EU868_MAX_PAYLOAD_SIZE[dr] : EU868_MAX_PAYLOAD_SIZE[0];
+    }
+
+    // Default priority of a channel, higher is sent first. Alarms come before levels, levels before the rest.
+    constexpr uint8_t defaultPriority(MeasurementType measurement_type)
+    {
+        switch (measurement_type)
+        {
+        case MeasurementType::Boolean:
+            return 2;
+        case MeasurementType::Distance:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    // Upper bound of datapoints a single plan covers.
+    constexpr size_t MAX_PLANNED_DATA_POINTS = 32;
+
+    /**
+     * Splits pending datapoints into frames that fit the payload limit of the
+     * current data rate. Datapoints are placed in order of descending
+     * priority (stable for equal priorities), each into the first frame with
+     * room left, so the first frame carries the most important channels and
+     * later datapoints fill the gaps.
+     */
+    class FramePlanner
+    {
+    public:
+        /**
+         * @param max_payload    payload limit of a single frame
+         * @param frame_overhead bytes every frame spends on control entries
+         * @param quantized      whether values use the quantized encodings
+         * @return the number of frames needed, 0 if `count` is 0 or exceeds
+         *         `MAX_PLANNED_DATA_POINTS`, or a datapoint does not fit into
+         *         an empty frame
+         */
+        size_t plan(const DataPoint *data_points, const uint8_t *priorities, size_t count,
+                    size_t max_payload, size_t frame_overhead, bool quantized);
+
+        // Frame the i-th datapoint of the last plan was put into.
+        size_t frameOf(size_t index) const { return _frame_of[index]; }
+
+        /**
+         * Copies the datapoints of `frame` to `out`, which must have room for
+         * the `count` passed to `plan`, in their original order.
+         *
+         * @return the number of datapoints copied.
+         */
+        size_t collect(const DataPoint *data_points, size_t frame, DataPoint *out) const;
+
+    private:
+        size_t _count = 0;
+        std::array<uint8_t, MAX_PLANNED_DATA_POINTS> _frame_of;
+    };
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Lora::Wan
+{
+    // Downlinks whose SNR the margin is taken from.
+    constexpr size_t LINK_HISTORY = 8;
+
+    // Uplinks without any downlink after which the data rate is stepped down, and again after as many more.
+    // The first step comes where the LoRaWAN ADR backoff would take it, after ADR_ACK_LIMIT + ADR_ACK_DELAY
+    // uplinks; any earlier and it falls between two regular MAC downlinks of a healthy link.
+    constexpr uint32_t LINK_FALLBACK_UPLINKS = 64 + 32;
+
+    // SNR kept in reserve for fading and obstacles, as the TTN network server does.
+    constexpr float LINK_INSTALLATION_MARGIN_DB = 10.0f;
+
+    // Highest data rate the device raises itself to (EU868 DR5, SF7/125 kHz).
+    constexpr uint8_t LINK_MAX_DR = 5;
+
+    // Lowest SNR a EU868 data rate still demodulates at, SF12 needs -20 dB and every step up 2.5 dB more.
+    constexpr float requiredSnr(uint8_t dr)
+    {
+        return -20.0f + 2.5f * std::min<uint8_t>(dr, LINK_MAX_DR);
+    }
+
+    /**
+     * Tracks the link from the RSSI and SNR of received downlinks and picks
+     * the data rate of the next uplinks when `adaptive` is set, i.e. without
+     * network-side ADR; with ADR, LMIC and the network server own the data
+     * rate, including the backoff. When no downlink arrived for
+     * `LINK_FALLBACK_UPLINKS` uplinks the gateway may not hear us anymore, so
+     * the data rate goes down one step. It goes up by one step per 3 dB of
+     * SNR margin beyond `LINK_INSTALLATION_MARGIN_DB`, like the network
+     * server would.
+     */
+    class LinkQuality
+    {
+    public:
+        void downlink(int16_t rssi, float snr)
+        {
+            _rssi = rssi;
+            _snr[_next] = snr;
+            _next = (_next + 1) % _snr.size();
+            _count = std::min(_count + 1, _snr.size());
+            _uplinks_since_downlink = 0;
+        }
+
+        void uplink() { _uplinks_since_downlink++; }
+
+        bool received() const { return _count > 0; }
+        uint32_t uplinksSinceDownlink() const { return _uplinks_since_downlink; }
+
+        // RSSI (dBm) and SNR (dB) of the last downlink.
+        int16_t rssi() const { return _rssi; }
+        float snr() const { return _snr[(_next + _snr.size() - 1) % _snr.size()]; }
+
+        // Margin (dB) of the best recent downlink above what data rate `dr` needs, 0 without downlinks.
+        float margin(uint8_t dr) const
+        {
+            if (_count == 0)
+                return 0.0f;
+            const float best = *std::max_element(_snr.begin(), _snr.begin() + _count);
+            return best - requiredSnr(dr);
+        }
+
+        /**
+         * Data rate for the uplinks after the current one, sent at `dr`.
+         * Raising it forgets the SNR history, which was measured at the
+         * old data rate.
+         */
+        uint8_t adapt(uint8_t dr, bool adaptive)
+        {
+            if (!adaptive)
+                return dr;
+
+            if (_uplinks_since_downlink > 0 && _uplinks_since_downlink % LINK_FALLBACK_UPLINKS == 0)
+                return dr > 0 ? dr - 1 : 0;
+
+            if (_count < _snr.size() || dr >= LINK_MAX_DR)
+                return dr;
+
+            const int steps = static_cast<int>((margin(dr) - LINK_INSTALLATION_MARGIN_DB) / 3.0f);
+            if (steps <= 0)
+                return dr;
+
+            _count = 0;
+            return static_cast<uint8_t>(std::min<int>(dr + steps, LINK_MAX_DR));
+        }
+
+    private:
+        std::array<float, LINK_HISTORY> _snr{};
+        size_t _next = 0;
+        size_t _count = 0;
+        int16_t _rssi = 0;
+        uint32_t _uplinks_since_downlink = 0;
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Lora::Wan
+{
+    // Time kept free before the next LMIC job, so that it never starts late.
+    constexpr uint32_t LMIC_JOB_MARGIN_MS = 100;
+
+    /**
+     * Runs the LMIC scheduler without ever blocking. Instead of waiting for a
+     * pending TX/RX, `poll` reports how long the caller may spend on other
+     * work, or sleep, before it has to call again.
+     *
+     * `Lmic` adapts the LMIC instance and provides
+     *
+     *     uint32_t run();      // runs due jobs, returns ms until the next one
+     *     bool pending();      // whether a TX/RX is in progress
+     *
+     * so the service runs against a stubbed clock in the native tests.
+     */
+    template <typename Lmic>
+    class LmicService
+    {
+    public:
+        explicit LmicService(Lmic &lmic) : _lmic(lmic) {}
+
+        /**
+         * Runs due LMIC jobs. When no TX/RX is pending, `idle()` is called
+         * and may queue the next uplink, returning whether it did.
+         *
+         * @return the number of milliseconds until `poll` is due again
+         */
+        template <typename Idle>
+        uint32_t poll(Idle idle)
+        {
+            const uint32_t free_ms = _lmic.run();
+            if (free_ms < LMIC_JOB_MARGIN_MS)
+                return 0;
+
+            // A freshly queued uplink has to be picked up by the next run
+            if (!_lmic.pending() && idle())
+                return 0;
+
+            return free_ms - LMIC_JOB_MARGIN_MS;
+        }
+
+    private:
+        Lmic &_lmic;
+    };
+}
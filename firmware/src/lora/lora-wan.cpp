@@ -9,8 +9,22 @@
 #include <hal/hal.h>
 #include <SPI.h>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <ctime>
 #include <keyhandler.h>
+#include <LittleFS.h>
 #include "../config/config.h"
+#include "config-downlink.h"
+#include "lmic-service.h"
+#include "session-checkpoint.h"
+#include "sample-ring.h"
+#include "session-image.h"
+#include "uplink-scheduler.h"
+
+#if FEATURE_DEEP_SLEEP
+#include <esp_sleep.h>
+#endif
 
 #define DEVICE_SIMPLE
 
@@ -31,8 +45,68 @@
 // constexpr char const appKey[16] = {0xA3, 0x46, 0xE1, 0xB1, 0x2B, 0x0A, 0x15, 0xD1, 0x43, 0xA6, 0x7D, 0x37, 0xE2, 0x8C, 0xEC, 0xE5};
 // void os_getDevKey(u1_t *buf) { memcpy_P(buf, APPKEY, 16); }
 
-static uint8_t mydata[] = "Hello, dirk!";
-uint8_t payload[34];
+// Send values in their 16 bit fixed point encoding (see quantization.h)
+// instead of raw floats.
+#ifndef LORA_PAYLOAD_QUANTIZED
+#define LORA_PAYLOAD_QUANTIZED true
+#endif
+
+// Number of uplinks between two full frames when change-only uplinks are
+// enabled and the `keyframeInterval` config key is unset.
+#define KEYFRAME_INTERVAL_DEFAULT 20
+
+// EU868 duty cycle of the sub-band the default channels live in.
+#ifndef LORA_DUTY_CYCLE
+#define LORA_DUTY_CYCLE 0.01f
+#endif
+
+// Daily airtime budget when the `airtimeBudget` config key (milliseconds per
+// day, 0 for none) is unset; the TTN fair use policy allows 30 s.
+#define AIRTIME_BUDGET_DEFAULT_MS 30000
+
+// Let the network server adjust data rate and TX power (ADR). Without it the
+// device raises the data rate itself from the SNR margin of downlinks.
+#ifndef LORA_ADR
+#define LORA_ADR true
+#endif
+
+// Network time is requested again via DeviceTimeReq once the last answer is
+// this old, which keeps the drift of the local clock well below a second.
+#define NETWORK_TIME_RESYNC_MS (24UL * 60 * 60 * 1000)
+
+// Room for the LMIC state saved before deep sleep or to flash.
+#define LMIC_SESSION_CAPACITY 256
+
+// Where the session is checkpointed, so a reboot does not need a join.
+#define SESSION_FILE "/session.bin"
+
+// Frames whose oldest datapoint was sampled longer ago than this carry a
+// timestamp (if the network time is known).
+#define UPLINK_DATING_AGE_MS 2000
+
+// Spill datapoints the full uplink queue pushes out to flash instead of
+// dropping them. Off by default to spare the flash.
+#ifndef UPLINK_QUEUE_FLASH_SPILL
+#define UPLINK_QUEUE_FLASH_SPILL false
+#endif
+#define UPLINK_SPILL_FILE "/queue.bin"
+#define UPLINK_SPILL_MAX_RECORDS 256
+
+// Run LMIC in its own FreeRTOS task on the core the Arduino loop does not use,
+// so sensors, display and console never delay an RX window. The loop hands
+// datapoints over through lock-free rings.
+#ifndef FEATURE_LORA_TASK
+#define FEATURE_LORA_TASK false
+#endif
+#define LORA_TASK_CORE 0
+#define LORA_TASK_PRIORITY 5
+#define LORA_TASK_STACK_SIZE 8192
+// Upper bound of batches handed to the task per publish.
+#define LORA_TASK_MAX_BATCHES 4
+
+#if FEATURE_LORA_TASK && FEATURE_DEEP_SLEEP
+#error "FEATURE_DEEP_SLEEP drives LMIC from the main loop and cannot be combined with FEATURE_LORA_TASK"
+#endif
 
 // Schedule TX every this many seconds (might become longer due to duty
 // cycle limitations).
@@ -40,6 +114,36 @@ const unsigned TX_INTERVAL = 30;
 
 char TTN_response[30];
 
+// The uplink state of `uplinks` that outlives a deep sleep, so a wake-up
+// neither starts with a keyframe nor forgets the confirmed uplinks of the day.
+#if FEATURE_DEEP_SLEEP
+RTC_DATA_ATTR
+#endif
+static Lora::Wan::UplinkMemory uplinkMemory;
+
+// A config downlink waits here until the main loop, which owns the config,
+// applied it. Its acknowledgement goes out with the next uplink, after a
+// deep sleep if need be.
+static Lora::Protocol::ConfigDownlink configDownlink;
+static std::atomic<bool> configDownlinkPending{false};
+
+// Copies of the state behind the status keys. The Configurator reads them from the
+// main loop, which must not touch the LoRa task's state or LMIC, so service() publishes them.
+struct StatusSnapshot
+{
+    std::atomic<uint32_t> queueDepth{0};
+    std::atomic<uint32_t> queueDropped{0};
+    std::atomic<uint32_t> queueCoalesced{0};
+    std::atomic<uint32_t> airtimeHour{0};
+    std::atomic<uint32_t> airtimeDay{0};
+    std::atomic<uint32_t> confirmedFailed{0};
+    std::atomic<uint8_t> dr{0};
+    std::atomic<int8_t> txPower{0};
+    std::atomic<int16_t> rssi{0};
+    std::atomic<float> snr{0};
+};
+static StatusSnapshot statusSnapshot;
+
 static Lora::Wan::DevEuiGetter devEUI;
 static Lora::Wan::AppEuiGetter appEUI;
 
@@ -53,6 +157,157 @@ static const lmic_pinmap myPinmap = {
 RadioSx1262 radio(myPinmap, ImageCalibrationBand::band_863_870);
 LmicEu868 LMIC{radio};
 
+// Adapts LMIC to `Lora::Wan::LmicService` and `Lora::Wan::UplinkScheduler`.
+struct LmicAdapter
+{
+    uint32_t run()
+    {
+        const auto free_ms = LMIC.run().to_ms();
+        return free_ms > 0 ? free_ms : 0;
+    }
+
+    bool pending() { return LMIC.getOpMode().test(OpState::TXRXPEND); }
+
+    uint32_t millis() { return ::millis(); }
+
+    // millis() starts over on every wake-up, the system time of the ESP32 keeps running through deep sleep.
+    uint32_t seconds()
+    {
+#if FEATURE_DEEP_SLEEP
+        return static_cast<uint32_t>(time(nullptr));
+#else
+        return ::millis() / 1000;
+#endif
+    }
+
+    uint32_t random() { return esp_random(); }
+
+    uint8_t dr() { return LMIC.getDr(); }
+
+    void setDr(uint8_t dr) { LMIC.setDrTx(dr); }
+
+    int8_t txPower() { return static_cast<int8_t>(LMIC.getTxPow()); }
+
+    void send(const uint8_t *frame, size_t size, bool confirmed)
+    {
+        // Prepare upstream data transmission at the next possible time.
+        LMIC.setTxData2(1, frame, size, confirmed);
+        Serial.println(confirmed ? F("Confirmed packet queued") : F("Packet queued"));
+        // Next TX is scheduled after TX_COMPLETE event.
+    }
+
+    void requestNetworkTime();
+};
+
+#if UPLINK_QUEUE_FLASH_SPILL
+// Spills the uplink queue to a file, see `Lora::Wan::NoSpill`.
+struct FlashSpill
+{
+    bool append(const uint8_t *record)
+    {
+        File file = LittleFS.open(UPLINK_SPILL_FILE, "a");
+        if (!file)
+            return false;
+
+        const bool written = file.write(record, Lora::Protocol::SPILL_RECORD_SIZE) == Lora::Protocol::SPILL_RECORD_SIZE;
+        file.close();
+        return written;
+    }
+
+    size_t read(size_t first, uint8_t *records, size_t count)
+    {
+        File file = LittleFS.open(UPLINK_SPILL_FILE, "r");
+        size_t length = 0;
+        if (file && file.seek(first * Lora::Protocol::SPILL_RECORD_SIZE))
+            length = file.read(records, count * Lora::Protocol::SPILL_RECORD_SIZE);
+        file.close();
+        return length / Lora::Protocol::SPILL_RECORD_SIZE;
+    }
+
+    void clear() { LittleFS.remove(UPLINK_SPILL_FILE); }
+};
+using UplinkSpill = FlashSpill;
+#else
+using UplinkSpill = Lora::Wan::NoSpill;
+#endif
+#if FEATURE_DEEP_SLEEP
+// Survives deep sleep, so a wake-up sends without joining again.
+RTC_DATA_ATTR static Lora::Wan::SessionImage<LMIC_SESSION_CAPACITY> rtcSession;
+
+struct RtcClock
+{
+    bool synchronized;
+    uint32_t gps_s; // network time when waking up
+    uint32_t age_ms;
+};
+RTC_DATA_ATTR static RtcClock rtcClock;
+
+// Time from waking up until the first uplink of that wake-up completed.
+RTC_DATA_ATTR static uint32_t rtcWakeToTxMs;
+static bool wokeUp = false;
+#endif
+
+// Kept across deep sleep as well, so the next checkpoint is not rushed.
+#if FEATURE_DEEP_SLEEP
+RTC_DATA_ATTR
+#endif
+static Lora::Wan::SessionCheckpoint sessionCheckpoint;
+
+// Set when the link is considered dead; the join happens from the loop.
+static bool rejoinRequested = false;
+
+static LmicAdapter lmicAdapter;
+static Lora::Wan::LmicService<LmicAdapter> lmicService(lmicAdapter);
+
+static UplinkSpill uplinkSpill;
+static const Lora::Wan::UplinkSettings uplinkSettings = {
+    LORA_PAYLOAD_QUANTIZED,
+    LORA_DUTY_CYCLE,
+    LORA_ADR,
+    UPLINK_DATING_AGE_MS,
+    NETWORK_TIME_RESYNC_MS,
+    UPLINK_QUEUE_FLASH_SPILL ? UPLINK_SPILL_MAX_RECORDS : 0,
+};
+static Lora::Wan::UplinkScheduler<LmicAdapter, UplinkSpill> uplinks(lmicAdapter, uplinkMemory, uplinkSettings, uplinkSpill);
+
+// Off by default: these calls follow the LMIC DeviceTimeReq network time API and have not been built
+// against the pinned LMICPP-Arduino yet. Without them frames stay undated and are dated on reception.
+#if LMIC_ENABLE_DeviceTimeReq
+static bool networkTimeRequested = false;
+
+static void onNetworkTime(void *, int success)
+{
+    networkTimeRequested = false;
+
+    lmic_time_reference_t reference;
+    if (!success || !LMIC.getNetworkTimeReference(reference))
+    {
+        log_w("No network time received");
+        return;
+    }
+
+    // The reference is the end of the uplink that carried the request
+    const uint32_t age_ms = (os_getTime() - reference.tLocal).to_ms();
+    uplinks.networkClock().synchronize(reference.tNetwork, millis() - age_ms);
+    log_i("Network time %u", reference.tNetwork);
+}
+
+// Piggybacks a DeviceTimeReq on the next uplink, the scheduler asks when the network time is unknown or stale.
+void LmicAdapter::requestNetworkTime()
+{
+    if (networkTimeRequested)
+        return;
+
+    LMIC.requestNetworkTime(onNetworkTime, nullptr);
+    networkTimeRequested = true;
+}
+#else
+void LmicAdapter::requestNetworkTime()
+{
+}
+#endif
+
+
 namespace Lora
 {
     namespace Wan
@@ -68,29 +323,198 @@ namespace Lora
             Serial.print(v, HEX);
         }
 
-        void publish2TTN(void)
+        // Parses the change-only uplink config, they are disabled while the `deadband` config key is unset,
+        // and the airtime budget.
+        static void readUplinkConfig()
+        {
+            const auto &config = Configuration::Configurator::getConfig();
+            const unsigned long keyframe_interval = strtoul(config.keyframeInterval.c_str(), nullptr, 10);
+            uplinks.configure(config.deadband.empty() ? NAN : strtof(config.deadband.c_str(), nullptr),
+                              keyframe_interval > 0 ? std::min<unsigned long>(keyframe_interval, UINT16_MAX) : KEYFRAME_INTERVAL_DEFAULT,
+                              config.airtimeBudget.empty() ? AIRTIME_BUDGET_DEFAULT_MS : strtoul(config.airtimeBudget.c_str(), nullptr, 10));
+        }
+
+        // Writes the LMIC state to `state` and returns its length.
+        static size_t saveState(std::array<uint8_t, LMIC_SESSION_CAPACITY> &state)
+        {
+            StoringBuffer store(state.data());
+            LMIC.saveState(store);
+            return store.length();
+        }
+
+        // Writes the session to flash if it is new or enough uplinks passed since the last checkpoint.
+        static void checkpointSession()
         {
-            // Check if there is not a current TX/RX job running
-            if (LMIC.getOpMode().test(OpState::TXRXPEND))
+            const uint32_t fcnt_up = LMIC.getSeqnoUp();
+            if (!sessionCheckpoint.due(fcnt_up))
+                return;
+
+            std::array<uint8_t, LMIC_SESSION_CAPACITY> state;
+            static SessionImage<LMIC_SESSION_CAPACITY> image;
+            if (!image.store(state.data(), saveState(state)))
+            {
+                log_w("LMIC state exceeds %u bytes, not saved", LMIC_SESSION_CAPACITY);
+                return;
+            }
+
+            File file = LittleFS.open(SESSION_FILE, "w");
+            if (!file || file.write(reinterpret_cast<const uint8_t *>(&image), sizeof(image)) != sizeof(image))
             {
-                Serial.printf("*** OP_TXRXPEND, not sending\n");
+                log_w("Failed to write " SESSION_FILE);
                 return;
             }
+            file.close();
 
-            // Prepare upstream data transmission at the next possible time.
-            LMIC.setTxData2(1, mydata, sizeof(mydata) - 1, 0);
-            Serial.println(F("Packet queued"));
-            // Next TX is scheduled after TX_COMPLETE event.
+            sessionCheckpoint.saved(fcnt_up);
+            log_d("Session checkpointed at FCntUp %u", fcnt_up);
         }
 
-        void setup()
+        // Restores the session checkpointed to flash, skipping the uplink counts that may have been lost.
+        static bool restoreCheckpoint()
         {
+            static SessionImage<LMIC_SESSION_CAPACITY> image;
+            File file = LittleFS.open(SESSION_FILE, "r");
+            if (!file)
+                return false;
 
-            log_i("Setup LoraWAN");
-            SPI.begin(LORA_SCK_PIN, LORA_MISO_PIN, LORA_MOSI_PIN, LORA_NSS_PIN);
+            const size_t read = file.read(reinterpret_cast<uint8_t *>(&image), sizeof(image));
+            file.close();
+            if (read != sizeof(image) || !image.valid())
+            {
+                log_w("Ignoring invalid " SESSION_FILE);
+                return false;
+            }
 
-            os_init();
-            LMIC.init();
+            RetrieveBuffer retrieve(image.data);
+            LMIC.loadState(retrieve);
+            LMIC.setSeqnoUp(SessionCheckpoint::resume(LMIC.getSeqnoUp()));
+
+            // The skipped counter has to be on flash before it is used
+            sessionCheckpoint.changed();
+            checkpointSession();
+
+            log_i("Restored LoRaWAN session from flash, FCntUp %u", LMIC.getSeqnoUp());
+            return true;
+        }
+
+        // Parses a config downlink, a valid one is applied from the main loop and an invalid one acknowledged right away.
+        static void receiveConfigDownlink(const uint8_t *payload, size_t length)
+        {
+            if (configDownlinkPending.load(std::memory_order_acquire))
+            {
+                log_w("Config downlink ignored, the previous one is not applied yet");
+                return;
+            }
+
+            const auto status = Protocol::parseConfigDownlink(payload, length, configDownlink);
+            if (status == Protocol::ConfigStatus::Applied)
+            {
+                configDownlinkPending.store(true, std::memory_order_release);
+                return;
+            }
+
+            log_w("Config downlink %u rejected (%u)", configDownlink.sequence, static_cast<uint8_t>(status));
+            uplinks.acknowledgeConfig(configDownlink.sequence, status);
+        }
+
+        // Hands the outcome of the completed uplink to the scheduler, which tracks the link and adapts the data rate.
+        static void completeUplink()
+        {
+            const auto flags = LMIC.getTxRxFlags();
+            const uint8_t dr = LMIC.getDr();
+            const uint32_t confirmed_failed = uplinks.confirmedFailed();
+            uplinks.txComplete(flags.test(TxRxStatus::ACK), flags.test(TxRxStatus::DNW1) || flags.test(TxRxStatus::DNW2),
+                               radio.get_last_packet_rssi(), radio.get_last_packet_snr_x4() / 4.0f);
+
+            if (uplinks.confirmedFailed() != confirmed_failed)
+                log_w("Confirmed uplink not acknowledged, giving up");
+            if (LMIC.getDr() != dr)
+                log_i("%u uplinks since the last downlink, SNR margin %.1f dB, DR%u -> DR%u", uplinks.linkQuality().uplinksSinceDownlink(),
+                      uplinks.linkQuality().margin(dr), dr, LMIC.getDr());
+        }
+
+        static void onEvent(EventType ev)
+        {
+            switch (ev)
+            {
+            case EventType::JOINED:
+                log_i("Joined network");
+                // A new session means the backend may have lost our reference frame
+                uplinks.joined();
+                sessionCheckpoint.changed();
+                checkpointSession();
+                break;
+            case EventType::LINK_DEAD:
+                log_w("No downlink for too long, joining again");
+                rejoinRequested = true;
+                break;
+            case EventType::TXCOMPLETE:
+                log_d("TX complete");
+                completeUplink();
+                checkpointSession();
+                if (LMIC.getDataLen() > 0 && LMIC.getPort() == Protocol::CONFIG_FPORT)
+                    receiveConfigDownlink(LMIC.getData(), LMIC.getDataLen());
+#if FEATURE_DEEP_SLEEP
+                if (wokeUp)
+                {
+                    rtcWakeToTxMs = millis();
+                    wokeUp = false;
+                    log_i("Wake to TX complete: %u ms", rtcWakeToTxMs);
+                }
+#endif
+                break;
+            default:
+                break;
+            }
+        }
+
+#if FEATURE_DEEP_SLEEP
+        // Restores the session saved by `sleep`, if the device woke up from it.
+        static bool restoreRtcSession()
+        {
+            if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER || !rtcSession.valid())
+                return false;
+
+            RetrieveBuffer retrieve(rtcSession.data);
+            LMIC.loadState(retrieve);
+            if (rtcClock.synchronized)
+                uplinks.networkClock().restore(rtcClock.gps_s, millis(), rtcClock.age_ms);
+
+            wokeUp = true;
+            log_i("Restored LoRaWAN session from RTC memory, last wake to TX %u ms", rtcWakeToTxMs);
+            return true;
+        }
+
+        bool idle()
+        {
+            const auto mode = LMIC.getOpMode();
+            return uplinks.idle() && !configDownlinkPending.load(std::memory_order_acquire) &&
+                   !mode.test(OpState::TXRXPEND) && !mode.test(OpState::TXDATA) && !mode.test(OpState::JOINING);
+        }
+
+        void sleep(uint32_t duration_ms)
+        {
+            std::array<uint8_t, LMIC_SESSION_CAPACITY> state;
+            if (!rtcSession.store(state.data(), saveState(state)))
+                log_w("LMIC state exceeds the RTC buffer, restoring from flash after sleep");
+
+            const auto &network_clock = uplinks.networkClock();
+            rtcClock.synchronized = network_clock.synchronized();
+            if (rtcClock.synchronized)
+            {
+                rtcClock.gps_s = network_clock.toGps(millis() + duration_ms);
+                rtcClock.age_ms = network_clock.age(millis()) + duration_ms;
+            }
+
+            log_d("Deep sleep for %u ms", duration_ms);
+            Serial.flush();
+            esp_deep_sleep(static_cast<uint64_t>(duration_ms) * 1000);
+        }
+#endif
+
+        // Resets the MAC state and applies the keys from the config, so the next uplink joins.
+        static void resetSession()
+        {
             // Reset the MAC state. Session and pending data transfers will be discarded.
             LMIC.reset();
 
@@ -105,11 +529,52 @@ namespace Lora
             appEUI.set(config.appEUI);
             LMIC.setArtEuiCallback(appEUI.get);
 
-            LMIC.setClockError(MAX_CLOCK_ERROR * 1 / 100);
+            // The reset clears these as well. A restored session may be gone on the network
+            // side; link checks notice that (LINK_DEAD) and trigger a new join.
+            LMIC.setLinkCheckMode(1);
+            LMIC.setAdrMode(LORA_ADR);
+        }
+
+#if FEATURE_LORA_TASK
+        static void startLoraTask();
+#endif
+
+        bool setup()
+        {
+
+            log_i("Setup LoraWAN");
+            SPI.begin(LORA_SCK_PIN, LORA_MISO_PIN, LORA_MOSI_PIN, LORA_NSS_PIN);
 
-            // Disable link check validation
-            // Disable link-check mode and ADR, because ADR tends to complicate testing.
-            LMIC.setLinkCheckMode(0);
+            os_init();
+            LMIC.init();
+            resetSession();
+
+            Configuration::Configurator::registerStatus("queueDepth", []
+                                                        { return std::to_string(statusSnapshot.queueDepth.load(std::memory_order_relaxed)); });
+            Configuration::Configurator::registerStatus("queueDropped", []
+                                                        { return std::to_string(statusSnapshot.queueDropped.load(std::memory_order_relaxed)); });
+            Configuration::Configurator::registerStatus("queueCoalesced", []
+                                                        { return std::to_string(statusSnapshot.queueCoalesced.load(std::memory_order_relaxed)); });
+            Configuration::Configurator::registerStatus("airtimeHour", []
+                                                        { return std::to_string(statusSnapshot.airtimeHour.load(std::memory_order_relaxed)); });
+            Configuration::Configurator::registerStatus("airtimeDay", []
+                                                        { return std::to_string(statusSnapshot.airtimeDay.load(std::memory_order_relaxed)); });
+            Configuration::Configurator::registerStatus("airtimeLast", []
+                                                        { return std::to_string(uplinkMemory.last_airtime_ms.load(std::memory_order_relaxed)); });
+            Configuration::Configurator::registerStatus("linkStatus", []
+                                                        {
+                                                            char value[48];
+                                                            snprintf(value, sizeof(value), "DR%u,%ddBm,%ddBm,%.1fdB",
+                                                                     statusSnapshot.dr.load(std::memory_order_relaxed),
+                                                                     statusSnapshot.txPower.load(std::memory_order_relaxed),
+                                                                     statusSnapshot.rssi.load(std::memory_order_relaxed),
+                                                                     statusSnapshot.snr.load(std::memory_order_relaxed));
+                                                            return std::string(value); });
+            Configuration::Configurator::registerStatus("confirmedFailed", []
+                                                        { return std::to_string(statusSnapshot.confirmedFailed.load(std::memory_order_relaxed)); });
+
+            LMIC.setClockError(MAX_CLOCK_ERROR * 1 / 100);
+            LMIC.setEventCallBack(onEvent);
 
             // TTN uses SF9 for its RX2 window.
             // LMIC.dn2Dr = DR_SF9;
@@ -122,22 +587,239 @@ namespace Lora
             // Start job (sending automatically starts OTAA too)
             // do_send(&sendjob);
 
+            // The session in RTC memory is newer than the checkpoint, which is only needed after a power cycle
+            bool restored = false;
+#if FEATURE_DEEP_SLEEP
+            restored = restoreRtcSession();
+#endif
+            if (!restored)
+                restored = restoreCheckpoint();
+
+            // So that minPublishIntervalMs() knows the airtime budget before the first publish
+            readUplinkConfig();
+
+#if FEATURE_LORA_TASK
+            startLoraTask();
+#endif
+
             log_d("Setting up LoRa done");
+            return restored;
         };
 
-        void loop()
+        // Applies a received config downlink through the same path as SCP lines and queues its acknowledgement.
+        static void applyConfigDownlink()
         {
-            auto freeTimeBeforeNextCall = LMIC.run();
-            if (freeTimeBeforeNextCall < OsDeltaTime::from_ms(100))
+            if (!configDownlinkPending.load(std::memory_order_acquire))
                 return;
 
-            if (LMIC.getOpMode().test(OpState::TXRXPEND))
+            for (size_t i = 0; i < configDownlink.count; i++)
             {
-                auto waittime = freeTimeBeforeNextCall.to_ms() - 100;
-                PRINT_DEBUG(1, F("Delay TXRXPEND %dms"), waittime);
-                delay(waittime);
-                return;
+                const auto &setting = configDownlink.settings[i];
+                log_i("Config downlink %u: %s=%s", configDownlink.sequence, setting.key, setting.value);
+                Configuration::Configurator::set(setting.key, setting.value);
             }
+            Configuration::Configurator::writeConfig();
+            readUplinkConfig();
+
+            uplinks.acknowledgeConfig(configDownlink.sequence, Protocol::ConfigStatus::Applied);
+            configDownlinkPending.store(false, std::memory_order_release);
+        }
+
+        uint32_t minPublishIntervalMs()
+        {
+            return uplinks.minPublishIntervalMs();
+        }
+
+        // Copies the state behind the status keys into `statusSnapshot`, from the context that owns it.
+        static void publishStatus()
+        {
+            const uint32_t now_s = millis() / 1000;
+            const auto link = uplinks.linkStatus();
+            const auto &ledger = uplinks.airtimeLedger();
+            statusSnapshot.queueDepth.store(uplinks.queueDepth(), std::memory_order_relaxed);
+            statusSnapshot.queueDropped.store(uplinks.dropped(), std::memory_order_relaxed);
+            statusSnapshot.queueCoalesced.store(uplinks.coalesced(), std::memory_order_relaxed);
+            statusSnapshot.airtimeHour.store(ledger.hourly(now_s, Lora::Wan::AIRTIME_BAND), std::memory_order_relaxed);
+            statusSnapshot.airtimeDay.store(ledger.daily(now_s), std::memory_order_relaxed);
+            statusSnapshot.confirmedFailed.store(uplinks.confirmedFailed(), std::memory_order_relaxed);
+            statusSnapshot.dr.store(link.dr, std::memory_order_relaxed);
+            statusSnapshot.txPower.store(link.tx_power_dbm, std::memory_order_relaxed);
+            statusSnapshot.rssi.store(uplinks.linkQuality().rssi(), std::memory_order_relaxed);
+            statusSnapshot.snr.store(uplinks.linkQuality().snr(), std::memory_order_relaxed);
+        }
+
+        // Runs due LMIC jobs and sends what is queued; returns the milliseconds until it is due again.
+        static uint32_t service()
+        {
+            const uint32_t due_ms = lmicService.poll([]
+                                                     {
+                                                         if (rejoinRequested)
+                                                         {
+                                                             rejoinRequested = false;
+                                                             LittleFS.remove(SESSION_FILE);
+                                                             resetSession();
+                                                             uplinks.sendEmpty();
+                                                             return true;
+                                                         }
+
+                                                         // The previous uplink completed, send what is still queued
+                                                         return uplinks.sendNext(); });
+            publishStatus();
+            return uplinks.dueMs(due_ms);
+        }
+
+#if FEATURE_LORA_TASK
+        // Batches copied out of the batcher, which the main loop keeps filling.
+        struct BatchSnapshot
+        {
+            std::array<Protocol::Batch, LORA_TASK_MAX_BATCHES> batches;
+            std::array<std::array<float, Protocol::MAX_BATCH_SAMPLES>, LORA_TASK_MAX_BATCHES> samples;
+            size_t count;
+            uint32_t newest_ms;
         };
+
+        // Main loop -> LoRa task, each with exactly one producer and one consumer.
+        static Protocol::SpscRing<Protocol::PackedSample, 64> sampleRing;
+        static Protocol::SpscRing<BatchSnapshot, 2> batchRing;
+        static std::atomic<bool> joinTriggerRequested{false};
+        static uint32_t ringDropped = 0;
+
+        // millis() at which the LoRa task runs next, so the main loop does not light-sleep past it.
+        static std::atomic<uint32_t> loraTaskDueMs{0};
+        static TaskHandle_t loraTask = nullptr;
+
+        // Publishes whatever the main loop handed over.
+        static void consumeRings()
+        {
+            static std::array<Protocol::DataPoint, Protocol::MAX_TRACKED_CHANNELS> data_points;
+            static size_t count = 0;
+            Protocol::PackedSample sample;
+            while (sampleRing.pop(sample))
+            {
+                if (count < data_points.size())
+                    data_points[count++] = sample.unpack();
+
+                if (sample.flags & Protocol::PackedSample::END_OF_PUBLISH)
+                {
+                    uplinks.publish(data_points.data(), count, sample.sampled_ms);
+                    count = 0;
+                }
+            }
+
+            // A snapshot that could not be sent yet blocks the ring, so the main loop keeps its batcher
+            static BatchSnapshot snapshot;
+            static bool snapshotPending = false;
+            while (snapshotPending || batchRing.pop(snapshot))
+            {
+                for (size_t i = 0; i < snapshot.count; i++)
+                    snapshot.batches[i].samples = snapshot.samples[i].data();
+                snapshotPending = !uplinks.publish(snapshot.batches.data(), snapshot.count, snapshot.newest_ms);
+                if (snapshotPending)
+                    break;
+            }
+        }
+
+        static void runLoraTask(void *)
+        {
+            for (;;)
+            {
+                if (joinTriggerRequested.exchange(false))
+                    uplinks.sendEmpty();
+                consumeRings();
+
+                const uint32_t idle_ms = service();
+                loraTaskDueMs.store(millis() + idle_ms);
+                // Sleeps until LMIC is due, or the main loop handed over new data
+                ulTaskNotifyTake(pdTRUE, std::max<TickType_t>(1, pdMS_TO_TICKS(idle_ms)));
+            }
+        }
+
+        static void wakeLoraTask()
+        {
+            if (loraTask != nullptr)
+                xTaskNotifyGive(loraTask);
+        }
+
+        void publish2TTN(void)
+        {
+            joinTriggerRequested = true;
+            wakeLoraTask();
+        }
+
+        void publish2TTN(const Protocol::DataPoint *data_points, size_t count)
+        {
+            readUplinkConfig();
+
+            const uint32_t now = millis();
+            for (size_t i = 0; i < count; i++)
+            {
+                const uint8_t flags = i + 1 == count ? Protocol::PackedSample::END_OF_PUBLISH : 0;
+                if (!sampleRing.push(Protocol::PackedSample::pack(data_points[i], now, flags)))
+                {
+                    // Without its end marker the publish is merged into the next one
+                    ringDropped++;
+                }
+            }
+            wakeLoraTask();
+        }
+
+        bool publish2TTN(const Protocol::Batch *batches, size_t count, uint32_t newest_ms)
+        {
+            readUplinkConfig();
+
+            static BatchSnapshot snapshot;
+            snapshot.count = std::min<size_t>(count, LORA_TASK_MAX_BATCHES);
+            snapshot.newest_ms = newest_ms;
+            for (size_t i = 0; i < snapshot.count; i++)
+            {
+                snapshot.batches[i] = batches[i];
+                std::copy(batches[i].samples, batches[i].samples + batches[i].count, snapshot.samples[i].begin());
+            }
+
+            const bool pushed = batchRing.push(snapshot);
+            wakeLoraTask();
+            return pushed;
+        }
+
+        // Starts the LoRa task, from here on only it touches LMIC.
+        static void startLoraTask()
+        {
+            Configuration::Configurator::registerStatus("ringDropped", []
+                                                        { return std::to_string(ringDropped); });
+            xTaskCreatePinnedToCore(runLoraTask, "lora", LORA_TASK_STACK_SIZE, nullptr, LORA_TASK_PRIORITY, &loraTask, LORA_TASK_CORE);
+        }
+
+        uint32_t loop()
+        {
+            applyConfigDownlink();
+            const int32_t due_ms = static_cast<int32_t>(loraTaskDueMs.load() - millis());
+            return due_ms > 0 ? due_ms : 0;
+        }
+#else
+        void publish2TTN(void)
+        {
+            uplinks.sendEmpty();
+        }
+
+        void publish2TTN(const Protocol::DataPoint *data_points, size_t count)
+        {
+            readUplinkConfig();
+            uplinks.publish(data_points, count, millis());
+        }
+
+        bool publish2TTN(const Protocol::Batch *batches, size_t count, uint32_t newest_ms)
+        {
+            readUplinkConfig();
+            return uplinks.publish(batches, count, newest_ms);
+        }
+
+        uint32_t loop()
+        {
+            // The downlink arrives within service(), it is applied before the caller may go to sleep
+            const uint32_t due_ms = service();
+            applyConfigDownlink();
+            return due_ms;
+        }
+#endif
     }
 }
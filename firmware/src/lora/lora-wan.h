@@ -3,14 +3,33 @@
 #include <keyhandler.h>
 #include <config.h>
 
+#include "protocol.h"
+
 namespace Lora
 {
     namespace Wan
     {
-        void setup();
-        void loop();
+        // Sets up LMIC and returns whether a saved session was restored, i.e. no join is needed.
+        bool setup();
+        // Runs LMIC without blocking and returns the milliseconds until it needs to run again.
+        uint32_t loop();
         void printHex2(unsigned v);
+
+        // Shortest publish interval that keeps uplinks like the last one within the duty cycle and airtime budget.
+        uint32_t minPublishIntervalMs();
+
+#if FEATURE_DEEP_SLEEP
+        // Whether nothing is left to send, receive or apply, so the device may sleep.
+        bool idle();
+
+        // Saves the LMIC session to RTC memory and enters deep sleep for `duration_ms`; does not return.
+        void sleep(uint32_t duration_ms);
+#endif
         void publish2TTN(void);
+        void publish2TTN(const Protocol::DataPoint *data_points, size_t count);
+        // `newest_ms` is the `millis()` the newest sample of the batches was taken at. Returns false if the
+        // batches could not be handed over, the caller keeps them for the next attempt then.
+        bool publish2TTN(const Protocol::Batch *batches, size_t count, uint32_t newest_ms);
 
         // Taken from LMIC keyhandler.h
         class AppEuiGetter
@@ -0,0 +1,32 @@
+#include "./network-clock.h"
+
+namespace Lora::Protocol
+{
+    void NetworkClock::synchronize(uint32_t gps_s, uint32_t local_ms)
+    {
+        _gps_s = gps_s;
+        _local_ms = local_ms;
+        _synchronized_ms = local_ms;
+        _synchronized = true;
+    }
+
+    void NetworkClock::restore(uint32_t gps_s, uint32_t local_ms, uint32_t age_ms)
+    {
+        synchronize(gps_s, local_ms);
+        _synchronized_ms = local_ms - age_ms;
+    }
+
+    bool NetworkClock::stale(uint32_t now_ms, uint32_t max_age_ms) const
+    {
+        return !_synchronized || age(now_ms) > max_age_ms;
+    }
+
+    uint32_t NetworkClock::toGps(uint32_t local_ms) const
+    {
+        // Signed, so that samples taken before the synchronization work as well
+        const int64_t elapsed_ms = static_cast<int32_t>(local_ms - _local_ms);
+        const int64_t gps_ms = static_cast<int64_t>(_gps_s) * 1000 + elapsed_ms;
+        // Round down, also for negative elapsed times
+        return static_cast<uint32_t>(gps_ms >= 0 ? gps_ms / 1000 : (gps_ms - 999) / 1000);
+    }
+}
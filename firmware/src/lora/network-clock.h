@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Lora::Protocol
+{
+    /**
+     * Maps the local monotonic millisecond clock (`millis()`) to network
+     * time, i.e. seconds since the GPS epoch as reported by the LoRaWAN
+     * DeviceTimeAns MAC command. The local clock may wrap around; times
+     * within 24 days of the last synchronization convert correctly.
+     */
+    class NetworkClock
+    {
+    public:
+        // The network time was `gps_s` at local time `local_ms`.
+        void synchronize(uint32_t gps_s, uint32_t local_ms);
+
+        /**
+         * Restores a clock across a reset of the local clock, e.g. deep
+         * sleep: the network time is `gps_s` at local time `local_ms`, and
+         * the last synchronization happened `age_ms` before.
+         */
+        void restore(uint32_t gps_s, uint32_t local_ms, uint32_t age_ms);
+
+        // Milliseconds since the last synchronization at local time `now_ms`.
+        uint32_t age(uint32_t now_ms) const { return now_ms - _synchronized_ms; }
+
+        // Forgets the last synchronization, e.g. after a rejoin.
+        void invalidate() { _synchronized = false; }
+
+        bool synchronized() const { return _synchronized; }
+
+        /**
+         * @return whether the clock was never synchronized or the last
+         *         synchronization is more than `max_age_ms` old at `now_ms`
+         */
+        bool stale(uint32_t now_ms, uint32_t max_age_ms) const;
+
+        /**
+         * Converts a local time, which may lie before the last
+         * synchronization, to GPS seconds. Only meaningful when synchronized.
+         */
+        uint32_t toGps(uint32_t local_ms) const;
+
+    private:
+        bool _synchronized = false;
+        uint32_t _gps_s = 0;
+        uint32_t _local_ms = 0;
+        uint32_t _synchronized_ms = 0;
+    };
+}
@@ -1,43 +1,374 @@
 #include "./protocol.h"
+#include "./quantization.h"
+#include "./varint.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <limits>
 
-std::vector<uint8_t> Lora::Protocol::packDataPoints(const std::vector<DataPoint> &data_points)
+namespace Lora::Protocol
 {
-    std::vector<uint8_t> packed_data;
+    namespace
+    {
+        constexpr uint8_t header(MeasurementType type, uint8_t low_nibble)
+        {
+            return static_cast<uint8_t>(type) << 4 | low_nibble;
+        }
+
+        constexpr uint8_t BATCH_CONTROL = header(MeasurementType::Control, static_cast<uint8_t>(ControlCode::Batch));
+
+        // Batches only carry numeric measurements with a sane step size, and no NaN which a delta cannot express.
+        bool isValid(const Batch &batch)
+        {
+            if (!(batch.count > 0 && batch.count <= MAX_BATCH_SAMPLES && batch.samples != nullptr &&
+                  batch.measurement_type != MeasurementType::Boolean &&
+                  static_cast<uint8_t>(batch.measurement_type) <= static_cast<uint8_t>(MeasurementType::SoundLevel) &&
+                  batch.scale >= -9 && batch.scale <= 9))
+                return false;
+
+            return std::none_of(batch.samples, batch.samples + batch.count, [](float sample)
+                                { return std::isnan(sample); });
+        }
+
+        // Saturates at the int32 range; NaN is rejected by `isValid` beforehand.
+        int32_t quantize(float value, float step)
+        {
+            const float steps = std::round(value / step);
+            if (!(steps > std::numeric_limits<int32_t>::min()))
+                return std::numeric_limits<int32_t>::min();
+            if (!(steps < std::numeric_limits<int32_t>::max()))
+                return std::numeric_limits<int32_t>::max();
+            return static_cast<int32_t>(steps);
+        }
+
+        /**
+         * Checks whether the Boolean datapoints form the contiguous channel
+         * range 0..n (n >= 1), which is cheaper to send as a single flags entry.
+         */
+        bool foldFlags(const DataPoint *data_points, size_t count, uint16_t &values, ChannelID &highest)
+        {
+            uint16_t present = 0;
+            size_t booleans = 0;
+            values = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (const bool *val = std::get_if<bool>(&data_points[i].value))
+                {
+                    const uint16_t bit = 1u << static_cast<uint8_t>(data_points[i].channel_id);
+                    if (present & bit)
+                        return false;
+                    present |= bit;
+                    values |= *val ? bit : 0;
+                    booleans++;
+                }
+            }
+
+            if (booleans < 2 || (present & (present + 1)) != 0)
+                return false;
+
+            highest = static_cast<ChannelID>(booleans - 1);
+            return true;
+        }
 
-    packed_data.reserve(calculate_packed_bytes(data_points));
+        // Calls `emit` with the zig-zag mapped first value and every delta.
+        template <typename Emit>
+        void forEachDelta(const Batch &batch, Emit emit)
+        {
+            const float step = std::pow(10.0f, batch.scale);
+            int64_t previous = 0;
+            for (uint8_t i = 0; i < batch.count; i++)
+            {
+                const int64_t current = quantize(batch.samples[i], step);
+                emit(Varint::zigzag(current - previous));
+                previous = current;
+            }
+        }
+    }
 
-    for (const auto &dp : data_points)
+    Encoder::Encoder(uint8_t *buffer, size_t capacity) : _buffer(buffer), _capacity(capacity)
     {
-        uint8_t first = static_cast<uint8_t>(dp.measurement_type) << 4 | static_cast<uint8_t>(dp.channel_id);
+    }
 
-        packed_data.push_back(first);
+    bool Encoder::add(const DataPoint &dp)
+    {
+        const size_t needed = packed_size(dp, _quantized);
+        if (needed > remaining())
+        {
+            _overflowed = true;
+            return false;
+        }
 
-        if (std::holds_alternative<bool>(dp.value))
+        uint8_t *out = _buffer + _size;
+        *out++ = header(dp.measurement_type, static_cast<uint8_t>(dp.channel_id));
+
+        if (const bool *val = std::get_if<bool>(&dp.value))
         {
-            bool val = std::get<bool>(dp.value);
-            packed_data.push_back(static_cast<uint8_t>(val));
+            *out = static_cast<uint8_t>(*val);
         }
-        else if (std::holds_alternative<float>(dp.value))
+        else if (const float *val = std::get_if<float>(&dp.value))
         {
-            float val = std::get<float>(dp.value);
-            uint8_t *float_bytes = reinterpret_cast<uint8_t *>(&val);
-            packed_data.insert(packed_data.end(), float_bytes, float_bytes + sizeof(float));
+            const Quantization q = quantization(dp.measurement_type);
+            if (_quantized && q.enabled())
+            {
+                const uint16_t raw = quantize(q, *val);
+                out[0] = raw & 0xff;
+                out[1] = raw >> 8;
+            }
+            else
+            {
+                std::memcpy(out, val, sizeof(float));
+            }
         }
+
+        _size += needed;
+        return true;
     }
 
-    return packed_data;
-}
+    bool Encoder::add(const DataPoint *data_points, size_t count)
+    {
+        uint16_t values;
+        ChannelID highest;
+        const bool fold = _flags && foldFlags(data_points, count, values, highest);
+        bool folded = false;
 
-size_t Lora::Protocol::calculate_packed_bytes(const std::vector<DataPoint> &data_points)
-{
-    size_t size = 0;
-    for (const auto &dp : data_points)
+        for (size_t i = 0; i < count; i++)
+        {
+            if (fold && std::holds_alternative<bool>(data_points[i].value))
+            {
+                if (!folded && !addFlags(values, highest))
+                    return false;
+                folded = true;
+                continue;
+            }
+
+            if (!add(data_points[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Encoder::addFlags(uint16_t values, ChannelID highest)
+    {
+        const size_t needed = flags_packed_size(highest);
+        if (needed > remaining())
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        const uint8_t n = static_cast<uint8_t>(highest);
+        values &= static_cast<uint16_t>((2u << n) - 1);
+
+        uint8_t *out = _buffer + _size;
+        out[0] = header(MeasurementType::Flags, n);
+        out[1] = values & 0xff;
+        if (needed == 3)
+            out[2] = values >> 8;
+
+        _size += needed;
+        return true;
+    }
+
+    bool Encoder::add(const Batch &batch)
+    {
+        const size_t needed = packed_size(batch);
+        if (needed == 0)
+            return false;
+
+        if (needed > remaining())
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        uint8_t *out = _buffer + _size;
+        *out++ = BATCH_CONTROL;
+        *out++ = header(batch.measurement_type, static_cast<uint8_t>(batch.channel_id));
+        *out++ = static_cast<uint8_t>(batch.scale);
+        out += Varint::write(batch.period_s, out);
+        *out++ = batch.count;
+        forEachDelta(batch, [&out](uint64_t value)
+                     { out += Varint::write(value, out); });
+
+        _size += needed;
+        return true;
+    }
+
+    bool Encoder::addControl(ControlCode code)
     {
-        size += 1; // 4 bits for measurement type + 4 bits for channel ID
-        size += std::holds_alternative<bool>(dp.value) ? 1 : sizeof(float);
+        if (remaining() < 1)
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        _buffer[_size++] = header(MeasurementType::Control, static_cast<uint8_t>(code));
+        return true;
     }
 
-    return size;
+    bool Encoder::enableQuantization()
+    {
+        if (_quantized)
+            return true;
+
+        if (!addControl(ControlCode::Quantized))
+            return false;
+
+        _quantized = true;
+        return true;
+    }
+
+    bool Encoder::addTimestamp(uint32_t gps_s)
+    {
+        if (remaining() < TIMESTAMP_PACKED_SIZE)
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        uint8_t *out = _buffer + _size;
+        out[0] = header(MeasurementType::Control, static_cast<uint8_t>(ControlCode::Timestamp));
+        for (size_t i = 0; i < sizeof(uint32_t); i++)
+            out[1 + i] = (gps_s >> (8 * i)) & 0xff;
+
+        _size += TIMESTAMP_PACKED_SIZE;
+        return true;
+    }
+
+    bool Encoder::addOffset(uint32_t offset_s)
+    {
+        const size_t needed = offset_packed_size(offset_s);
+        if (needed > remaining())
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        uint8_t *out = _buffer + _size;
+        out[0] = header(MeasurementType::Control, static_cast<uint8_t>(ControlCode::Offset));
+        Varint::write(offset_s, out + 1);
+
+        _size += needed;
+        return true;
+    }
+
+    bool Encoder::addConfigAck(uint8_t sequence, ConfigStatus status)
+    {
+        if (remaining() < CONFIG_ACK_PACKED_SIZE)
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        uint8_t *out = _buffer + _size;
+        out[0] = header(MeasurementType::Control, static_cast<uint8_t>(ControlCode::ConfigAck));
+        out[1] = sequence;
+        out[2] = static_cast<uint8_t>(status);
+
+        _size += CONFIG_ACK_PACKED_SIZE;
+        return true;
+    }
+
+    bool Encoder::addLinkStatus(const LinkStatus &status)
+    {
+        if (remaining() < LINK_STATUS_PACKED_SIZE)
+        {
+            _overflowed = true;
+            return false;
+        }
+
+        uint8_t *out = _buffer + _size;
+        out[0] = header(MeasurementType::Control, static_cast<uint8_t>(ControlCode::LinkStatus));
+        out[1] = status.dr;
+        out[2] = static_cast<uint8_t>(status.tx_power_dbm);
+        out[3] = static_cast<uint8_t>(-std::clamp<int16_t>(status.rssi_dbm, -255, 0));
+        out[4] = static_cast<uint8_t>(status.snr_db);
+
+        _size += LINK_STATUS_PACKED_SIZE;
+        return true;
+    }
+
+    void Encoder::reset()
+    {
+        _size = 0;
+        _overflowed = false;
+        _quantized = false;
+    }
+
+    size_t packed_size(const DataPoint &dp, bool quantized)
+    {
+        // 4 bits for measurement type + 4 bits for channel ID, then the value
+        if (std::holds_alternative<bool>(dp.value))
+            return 1 + 1;
+        if (quantized && quantization(dp.measurement_type).enabled())
+            return 1 + QUANTIZED_VALUE_SIZE;
+        return 1 + sizeof(float);
+    }
+
+    size_t offset_packed_size(uint32_t offset_s)
+    {
+        return 1 + Varint::size(offset_s);
+    }
+
+    size_t packed_size(const Batch &batch)
+    {
+        if (!isValid(batch))
+            return 0;
+
+        // control, header, scale, period, count
+        size_t size = 3 + Varint::size(batch.period_s) + 1;
+        forEachDelta(batch, [&size](uint64_t value)
+                     { size += Varint::size(value); });
+
+        return size;
+    }
+
+    int8_t batch_scale(MeasurementType measurement_type)
+    {
+        switch (measurement_type)
+        {
+        case MeasurementType::Voltage:
+        case MeasurementType::Float:
+            return -3;
+        case MeasurementType::Temperature:
+        case MeasurementType::pH:
+            return -2;
+        case MeasurementType::Distance:
+        case MeasurementType::Pressure:
+        case MeasurementType::Humidity:
+        case MeasurementType::SoundLevel:
+            return -1;
+        default:
+            return 0;
+        }
+    }
+
+    size_t packDataPoints(const DataPoint *data_points, size_t count, uint8_t *buffer, size_t capacity)
+    {
+        Encoder encoder(buffer, capacity);
+        if (!encoder.add(data_points, count))
+            return 0;
+
+        return encoder.size();
+    }
+
+    std::vector<uint8_t> packDataPoints(const std::vector<DataPoint> &data_points)
+    {
+        std::vector<uint8_t> packed_data(calculate_packed_bytes(data_points));
+
+        packDataPoints(data_points.data(), data_points.size(), packed_data.data(), packed_data.size());
+
+        return packed_data;
+    }
+
+    size_t calculate_packed_bytes(const std::vector<DataPoint> &data_points)
+    {
+        size_t size = 0;
+        for (const auto &dp : data_points)
+            size += packed_size(dp);
+
+        return size;
+    }
 }
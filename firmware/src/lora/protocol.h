@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <variant>
 
 namespace Lora::Protocol
 {
+    // Largest application payload we ever hand to LMIC (EU868, DR5).
+    constexpr size_t MAX_PAYLOAD_SIZE = 222;
+
     enum class MeasurementType : uint8_t
     {
         Boolean = 0b0000,
@@ -20,12 +25,60 @@ namespace Lora::Protocol
         Humidity = 0b1001,
         pH = 0b1010,
         SoundLevel = 0b1011,
+        // Bitmap of Boolean channels 0..n, the low nibble holds n instead of a channel
+        Flags = 0b1100,
         // For later use
-        Unused1 = 0b1100,
         Unused2 = 0b1101,
-        Unused3 = 0b1111
+        // Marks a control entry, the low nibble holds a ControlCode instead of a channel
+        Control = 0b1111
+    };
+
+    enum class ControlCode : uint8_t
+    {
+        Batch = 0x1,
+        // Every following value with a Quantization is sent in 16 bit fixed point
+        Quantized = 0x2,
+        // Channels missing from this frame are unchanged since the last acknowledged frame
+        Delta = 0x3,
+        // Followed by a uint32 little endian GPS time in seconds, the base time of the following entries
+        Timestamp = 0x4,
+        // Followed by a varint, the following datapoints were sampled this many seconds after the base time
+        Offset = 0x5,
+        // Followed by the uint8 sequence number of a config downlink and a uint8 ConfigStatus
+        ConfigAck = 0x6,
+        // Followed by the uint8 data rate, int8 TX power (dBm), and the RSSI (negated uint8, dBm) and
+        // int8 SNR (dB) of the last downlink, both 0 before the first one
+        LinkStatus = 0x7,
+    };
+
+    // Number of bytes a `ControlCode::Timestamp` entry occupies on the wire.
+    constexpr size_t TIMESTAMP_PACKED_SIZE = 1 + sizeof(uint32_t);
+
+    // Outcome of a config downlink, reported back by a `ControlCode::ConfigAck` entry.
+    enum class ConfigStatus : uint8_t
+    {
+        Applied = 0,
+        // The downlink could not be parsed, nothing was applied
+        Malformed = 1,
+        // The downlink names a key that cannot be set remotely, nothing was applied
+        UnknownKey = 2,
+    };
+
+    // Number of bytes a `ControlCode::ConfigAck` entry occupies on the wire.
+    constexpr size_t CONFIG_ACK_PACKED_SIZE = 3;
+
+    // Radio settings of the uplink and the quality of the last downlink.
+    struct LinkStatus
+    {
+        uint8_t dr;
+        int8_t tx_power_dbm;
+        int16_t rssi_dbm;
+        int8_t snr_db;
     };
 
+    // Number of bytes a `ControlCode::LinkStatus` entry occupies on the wire.
+    constexpr size_t LINK_STATUS_PACKED_SIZE = 5;
+
     enum class ChannelID : uint8_t
     {
         _0 = 0,
@@ -53,12 +106,193 @@ namespace Lora::Protocol
     };
 
     struct DataPoint
+    {
+        MeasurementType measurement_type{};
+        ChannelID channel_id{};
+        std::variant<bool, float> value;
+    };
+
+    // Longest batch that is encoded or decoded.
+    constexpr size_t MAX_BATCH_SAMPLES = 64;
+
+    /**
+     * Several consecutive samples of one channel, sent as a single batch entry:
+     *
+     *     0xF1                      control entry: batch
+     *     type << 4 | channel       same header as a single datapoint
+     *     scale                     int8, decimal exponent of one step (-2 = 0.01)
+     *     period                    varint, seconds between two samples
+     *     count                     uint8, number of samples
+     *     first                     zig-zag varint, first sample in steps
+     *     delta[count - 1]          zig-zag varint, difference to the previous sample
+     *
+     * Samples are in chronological order, the last one being the most recent.
+     */
+    struct Batch
     {
         MeasurementType measurement_type;
         ChannelID channel_id;
-        std::variant<bool, float> value;
+        int8_t scale;
+        uint16_t period_s;
+        const float *samples;
+        uint8_t count;
+    };
+
+    /**
+     * Packs datapoints into a caller-supplied, fixed-size buffer (for example
+     * the array later handed to `LMIC.setTxData2`). The encoder never
+     * allocates: a datapoint that does not fit is not written at all and the
+     * encoder is marked as overflowed.
+     */
+    class Encoder
+    {
+    public:
+        Encoder(uint8_t *buffer, size_t capacity);
+
+        template <size_t N>
+        explicit Encoder(std::array<uint8_t, N> &buffer) : Encoder(buffer.data(), N)
+        {
+        }
+
+        /**
+         * Appends a single datapoint.
+         *
+         * @return false if the datapoint does not fit into the remaining space.
+         */
+        bool add(const DataPoint &data_point);
+
+        /**
+         * Appends `count` datapoints, stopping at the first one that does not fit.
+         *
+         * @return false if not all datapoints could be written.
+         */
+        bool add(const DataPoint *data_points, size_t count);
+
+        /**
+         * Appends a flags entry carrying the Boolean channels 0..`highest`,
+         * bit i of `values` being channel i:
+         *
+         *     Flags << 4 | highest      header
+         *     bitmap                    1 byte for up to 8 channels, else 2 bytes little endian
+         *
+         * Once `enableFlags` was called, `add` for a list of datapoints folds
+         * Boolean channels into such an entry on its own when they form a
+         * contiguous range starting at 0.
+         *
+         * @return false if the entry does not fit.
+         */
+        bool addFlags(uint16_t values, ChannelID highest);
+
+        /**
+         * Lets `add` for a list of datapoints fold Boolean channels into a
+         * flags entry. Off by default, so the output stays the plain sequence
+         * of datapoints older decoders and `Schema` expect.
+         */
+        void enableFlags() { _flags = true; }
+
+        /**
+         * Appends a batch entry.
+         *
+         * @return false if the batch is invalid (e.g. holds a NaN sample) or does not fit.
+         */
+        bool add(const Batch &batch);
+
+        /**
+         * Appends a bare control entry without payload.
+         *
+         * @return false if the entry does not fit.
+         */
+        bool addControl(ControlCode code);
+
+        /**
+         * Switches the rest of the frame to the quantized encodings from
+         * `quantization.h` by writing the `ControlCode::Quantized` entry.
+         * Does nothing if the frame is already quantized.
+         *
+         * @return false if the control entry does not fit.
+         */
+        bool enableQuantization();
+
+        /**
+         * Dates the following entries by writing a `ControlCode::Timestamp`
+         * entry. Datapoints after it were sampled at `gps_s` (seconds since
+         * the GPS epoch) plus the latest offset, the newest sample of a batch
+         * likewise. Frames without a timestamp are dated by their reception.
+         *
+         * @return false if the entry does not fit.
+         */
+        bool addTimestamp(uint32_t gps_s);
+
+        /**
+         * Writes a `ControlCode::Offset` entry, so that the following entries
+         * were sampled `offset_s` seconds after the timestamp of the frame.
+         *
+         * @return false if the entry does not fit.
+         */
+        bool addOffset(uint32_t offset_s);
+
+        /**
+         * Acknowledges the config downlink numbered `sequence` by writing a
+         * `ControlCode::ConfigAck` entry.
+         *
+         * @return false if the entry does not fit.
+         */
+        bool addConfigAck(uint8_t sequence, ConfigStatus status);
+
+        /**
+         * Reports the link by writing a `ControlCode::LinkStatus` entry. The
+         * RSSI is clamped to -255..0 dBm.
+         *
+         * @return false if the entry does not fit.
+         */
+        bool addLinkStatus(const LinkStatus &status);
+
+        // Discards everything written so far and clears the overflow and quantization flags.
+        void reset();
+
+        const uint8_t *data() const { return _buffer; }
+        size_t size() const { return _size; }
+        size_t capacity() const { return _capacity; }
+        size_t remaining() const { return _capacity - _size; }
+        bool overflowed() const { return _overflowed; }
+        bool quantized() const { return _quantized; }
+        bool flagsEnabled() const { return _flags; }
+
+    private:
+        uint8_t *_buffer;
+        size_t _capacity;
+        size_t _size = 0;
+        bool _overflowed = false;
+        bool _quantized = false;
+        bool _flags = false;
     };
 
+    // Number of bytes a single datapoint occupies on the wire.
+    size_t packed_size(const DataPoint &data_point, bool quantized = false);
+
+    // Number of bytes a flags entry for the Boolean channels 0..`highest` occupies on the wire.
+    constexpr size_t flags_packed_size(ChannelID highest)
+    {
+        return static_cast<uint8_t>(highest) < 8 ? 2 : 3;
+    }
+
+    // Number of bytes a `ControlCode::Offset` entry occupies on the wire.
+    size_t offset_packed_size(uint32_t offset_s);
+
+    // Number of bytes a batch entry occupies on the wire, or 0 if it is invalid.
+    size_t packed_size(const Batch &batch);
+
+    // Decimal exponent of the step batches of this measurement type are quantized to.
+    int8_t batch_scale(MeasurementType measurement_type);
+
+    /**
+     * Packs `count` datapoints into `buffer` without allocating.
+     *
+     * @return the number of bytes written, or 0 if the datapoints do not fit
+     *         into `capacity` bytes.
+     */
+    size_t packDataPoints(const DataPoint *data_points, size_t count, uint8_t *buffer, size_t capacity);
+
     // Function to pack a vector of DataPoint structs into a single std::vector<uint8_t>
     std::vector<uint8_t> packDataPoints(const std::vector<DataPoint> &data_points);
 
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "protocol.h"
+
+// Fixed-point encodings used in quantized frames. A frame that starts with the
+// `ControlCode::Quantized` entry sends every value whose measurement type has
+// a quantization as an unsigned 16 bit little endian number of `step`s above
+// `min` instead of a 4 byte float, which cuts a datapoint from 5 to 3 bytes.
+namespace Lora::Protocol
+{
+    struct Quantization
+    {
+        float step;
+        float min;
+
+        constexpr bool enabled() const { return step > 0; }
+        constexpr float max() const { return min + step * (QUANTIZED_INVALID - 1); }
+
+        // Reserved for readings that are NaN or outside [min, max()].
+        static constexpr uint16_t QUANTIZED_INVALID = 0xffff;
+    };
+
+    constexpr size_t QUANTIZED_VALUE_SIZE = 2;
+
+    /**
+     * Resolution and range per measurement type, in the units the sensors
+     * report. Types without a quantization (`Float`) keep the raw float.
+     */
+    constexpr Quantization quantization(MeasurementType measurement_type)
+    {
+        switch (measurement_type)
+        {
+        case MeasurementType::Pressure: // 0.1 hPa, 0 .. 6553.4 hPa
+            return {0.1f, 0.0f};
+        case MeasurementType::Voltage: // 1 mV, 0 .. 65.534 V
+            return {0.001f, 0.0f};
+        case MeasurementType::Distance: // 1 mm, 0 .. 6553.4 cm
+            return {0.1f, 0.0f};
+        case MeasurementType::Temperature: // 0.01 °C, -327.68 .. 327.66 °C
+            return {0.01f, -327.68f};
+        case MeasurementType::PPx: // 1 ppm, 0 .. 65534 ppm
+            return {1.0f, 0.0f};
+        case MeasurementType::Brightness: // 2 lx, 0 .. 131068 lx
+            return {2.0f, 0.0f};
+        case MeasurementType::Resistance: // 1 Ω, 0 .. 65534 Ω
+            return {1.0f, 0.0f};
+        case MeasurementType::Humidity: // 0.01 %, 0 .. 655.34 %
+            return {0.01f, 0.0f};
+        case MeasurementType::pH: // 0.001, 0 .. 65.534
+            return {0.001f, 0.0f};
+        case MeasurementType::SoundLevel: // 0.01 dB, 0 .. 655.34 dB
+            return {0.01f, 0.0f};
+        default:
+            return {0.0f, 0.0f};
+        }
+    }
+
+    inline uint16_t quantize(const Quantization &q, float value)
+    {
+        const float steps = std::round((value - q.min) / q.step);
+        // Written so that NaN ends up as invalid as well
+        if (!(steps >= 0.0f && steps < Quantization::QUANTIZED_INVALID))
+            return Quantization::QUANTIZED_INVALID;
+        return static_cast<uint16_t>(steps);
+    }
+
+    inline float dequantize(const Quantization &q, uint16_t raw)
+    {
+        if (raw == Quantization::QUANTIZED_INVALID)
+            return NAN;
+        return q.min + q.step * raw;
+    }
+}
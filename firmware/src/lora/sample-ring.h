@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "protocol.h"
+
+namespace Lora::Protocol
+{
+    /**
+     * Lock-free ring buffer for exactly one producer and one consumer
+     * thread, e.g. the sensor loop and the LoRa task. Neither side ever
+     * blocks; `push` fails when the ring is full. `Capacity` must be a power
+     * of two.
+     */
+    template <typename T, size_t Capacity>
+    class SpscRing
+    {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Producer side. @return false if the ring is full
+        bool push(const T &item)
+        {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            if (head - _tail.load(std::memory_order_acquire) == Capacity)
+                return false;
+
+            _items[head & (Capacity - 1)] = item;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. @return false if the ring is empty
+        bool pop(T &item)
+        {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            if (_head.load(std::memory_order_acquire) == tail)
+                return false;
+
+            item = _items[tail & (Capacity - 1)];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Exact only when called from one of the two sides while the other is idle.
+        size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+    private:
+        std::array<T, Capacity> _items;
+        std::atomic<size_t> _head{0};
+        std::atomic<size_t> _tail{0};
+    };
+
+    /**
+     * A datapoint as 12 bytes of plain data, so it can be copied through a
+     * `SpscRing` without touching the heap.
+     */
+    struct PackedSample
+    {
+        // Set on the last datapoint of one publish, the consumer sends them together.
+        static constexpr uint8_t END_OF_PUBLISH = 0x01;
+
+        uint8_t header; // type << 4 | channel
+        uint8_t flags;
+        uint32_t value; // float bits, or 0 / 1 for Booleans
+        uint32_t sampled_ms;
+
+        static PackedSample pack(const DataPoint &dp, uint32_t sampled_ms, uint8_t flags = 0)
+        {
+            PackedSample sample{static_cast<uint8_t>(static_cast<uint8_t>(dp.measurement_type) << 4 | static_cast<uint8_t>(dp.channel_id)),
+                                flags, 0, sampled_ms};
+            if (const bool *val = std::get_if<bool>(&dp.value))
+                sample.value = *val;
+            else
+                std::memcpy(&sample.value, &std::get<float>(dp.value), sizeof(float));
+            return sample;
+        }
+
+        DataPoint unpack() const
+        {
+            DataPoint dp{static_cast<MeasurementType>(header >> 4), static_cast<ChannelID>(header & 0x0f), false};
+            if (dp.measurement_type == MeasurementType::Boolean)
+            {
+                dp.value = value != 0;
+            }
+            else
+            {
+                float f;
+                std::memcpy(&f, &value, sizeof(float));
+                dp.value = f;
+            }
+            return dp;
+        }
+    };
+    static_assert(sizeof(PackedSample) == 12, "PackedSample is 10 bytes of fields, padded to the alignment of its values");
+}
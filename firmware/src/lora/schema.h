@@ -0,0 +1,248 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "protocol.h"
+#include "quantization.h"
+
+// Compile-time payload schemas for builds that always send the same channels.
+//
+//     using Uplink = Lora::Protocol::Schema<
+//         Lora::Protocol::Field<MeasurementType::Distance, ChannelID::_0, Encoding::Float32>,
+//         Lora::Protocol::Field<MeasurementType::Boolean, ChannelID::_0, Encoding::Bool>>;
+//
+//     std::array<uint8_t, Uplink::size> frame = Uplink::pack(distance, overflow);
+//
+// The frame is bit-exact with what `Encoder` produces for the same datapoints
+// as long as it does not fold flags, but every header byte and offset is known
+// at compile time, so packing boils down to a handful of stores. Schemas using
+// `Encoding::Quantized16` start with the `ControlCode::Quantized` entry, which
+// makes the encoding frame-wide: every field whose type has a quantization must
+// then use it.
+namespace Lora::Protocol
+{
+    enum class Encoding : uint8_t
+    {
+        Bool,
+        Float32,
+        Quantized16,
+    };
+
+    template <MeasurementType Type, ChannelID Channel, Encoding Enc>
+    struct Field
+    {
+        static_assert((Type == MeasurementType::Boolean) == (Enc == Encoding::Bool),
+                      "Boolean measurements must use Encoding::Bool and only them");
+        static_assert(static_cast<uint8_t>(Type) <= static_cast<uint8_t>(MeasurementType::SoundLevel),
+                      "Reserved measurement types cannot be used in a schema");
+        static_assert(Enc != Encoding::Quantized16 || quantization(Type).enabled(),
+                      "This measurement type has no quantized encoding");
+
+        using value_type = std::conditional_t<Enc == Encoding::Bool, bool, float>;
+
+        static constexpr MeasurementType measurement_type = Type;
+        static constexpr ChannelID channel_id = Channel;
+        static constexpr Encoding encoding = Enc;
+        static constexpr uint8_t header = static_cast<uint8_t>(Type) << 4 | static_cast<uint8_t>(Channel);
+        static constexpr size_t size = 1 + (Enc == Encoding::Bool          ? 1
+                                            : Enc == Encoding::Quantized16 ? QUANTIZED_VALUE_SIZE
+                                                                           : sizeof(float));
+
+        // Whether this field must use Quantized16 once the frame is quantized
+        static constexpr bool quantizable = Enc != Encoding::Bool && quantization(Type).enabled();
+
+        static void store(uint8_t *out, value_type value)
+        {
+            out[0] = header;
+            if constexpr (Enc == Encoding::Bool)
+            {
+                out[1] = static_cast<uint8_t>(value);
+            }
+            else if constexpr (Enc == Encoding::Quantized16)
+            {
+                const uint16_t raw = quantize(quantization(Type), value);
+                out[1] = raw & 0xff;
+                out[2] = raw >> 8;
+            }
+            else
+            {
+                std::memcpy(out + 1, &value, sizeof(float));
+            }
+        }
+
+        static bool load(const uint8_t *in, value_type &value)
+        {
+            if (in[0] != header)
+                return false;
+
+            if constexpr (Enc == Encoding::Bool)
+                value = in[1] != 0;
+            else if constexpr (Enc == Encoding::Quantized16)
+                value = dequantize(quantization(Type), static_cast<uint16_t>(in[1] | in[2] << 8));
+            else
+                std::memcpy(&value, in + 1, sizeof(float));
+
+            return true;
+        }
+    };
+
+    namespace detail
+    {
+        template <size_t N>
+        constexpr size_t offset(const std::array<size_t, N> &sizes, size_t index)
+        {
+            size_t result = 0;
+            for (size_t i = 0; i < index; i++)
+                result += sizes[i];
+            return result;
+        }
+
+        template <size_t N>
+        constexpr bool unique(const std::array<uint8_t, N> &headers)
+        {
+            for (size_t i = 0; i < N; i++)
+                for (size_t j = i + 1; j < N; j++)
+                    if (headers[i] == headers[j])
+                        return false;
+            return true;
+        }
+    }
+
+    template <typename... Fields>
+    class Schema
+    {
+        static constexpr std::array<size_t, sizeof...(Fields)> sizes = {Fields::size...};
+        static constexpr std::array<uint8_t, sizeof...(Fields)> headers = {Fields::header...};
+
+        static constexpr bool quantized = ((Fields::encoding == Encoding::Quantized16) || ...);
+        static constexpr size_t prefix = quantized ? 1 : 0;
+        static constexpr uint8_t QUANTIZED_CONTROL = static_cast<uint8_t>(MeasurementType::Control) << 4 | static_cast<uint8_t>(ControlCode::Quantized);
+
+        static constexpr size_t offset(size_t index) { return prefix + detail::offset(sizes, index); }
+
+        template <size_t I>
+        using FieldAt = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+        template <size_t... I>
+        static void storeAll(uint8_t *out, std::index_sequence<I...>, typename Fields::value_type... values)
+        {
+            (FieldAt<I>::store(out + offset(I), values), ...);
+        }
+
+        template <size_t... I>
+        static void loadColumns(const uint8_t *frames, size_t count, std::index_sequence<I...>, typename Fields::value_type *...columns)
+        {
+            (loadColumn<FieldAt<I>>(frames + offset(I), count, columns), ...);
+        }
+
+        // One tight loop with constant stride per field, which compilers turn into vector code.
+        template <typename F>
+        static void loadColumn(const uint8_t *in, size_t count, typename F::value_type *column)
+        {
+            for (size_t f = 0; f < count; f++)
+            {
+                const uint8_t *value = in + f * size + 1;
+                if constexpr (F::encoding == Encoding::Bool)
+                    column[f] = value[0] != 0;
+                else if constexpr (F::encoding == Encoding::Quantized16)
+                    column[f] = dequantize(quantization(F::measurement_type), static_cast<uint16_t>(value[0] | value[1] << 8));
+                else
+                    std::memcpy(&column[f], value, sizeof(float));
+            }
+        }
+
+        template <typename Values, size_t... I>
+        static bool loadAll(const uint8_t *in, std::index_sequence<I...>, Values &values)
+        {
+            return (FieldAt<I>::load(in + offset(I), std::get<I>(values)) && ...);
+        }
+
+    public:
+        static_assert(sizeof...(Fields) > 0, "A schema needs at least one field");
+        static_assert(detail::unique(headers), "Every (MeasurementType, ChannelID) pair may only appear once");
+        static_assert(!quantized || ((!Fields::quantizable || Fields::encoding == Encoding::Quantized16) && ...),
+                      "A quantized frame must use Encoding::Quantized16 for every quantizable field");
+
+        using Values = std::tuple<typename Fields::value_type...>;
+
+        static constexpr size_t size = prefix + detail::offset(sizes, sizeof...(Fields));
+
+        static_assert(size <= MAX_PAYLOAD_SIZE, "Schema does not fit into a single uplink");
+
+        /**
+         * Packs one value per field into `out`, which must hold `size` bytes.
+         */
+        static void pack(uint8_t *out, typename Fields::value_type... values)
+        {
+            if constexpr (quantized)
+                out[0] = QUANTIZED_CONTROL;
+            storeAll(out, std::index_sequence_for<Fields...>{}, values...);
+        }
+
+        static std::array<uint8_t, size> pack(typename Fields::value_type... values)
+        {
+            std::array<uint8_t, size> out;
+            pack(out.data(), values...);
+            return out;
+        }
+
+        /**
+         * Decodes a frame produced by `pack`.
+         *
+         * @return false if the frame has the wrong length or a header does not
+         *         match the schema.
+         */
+        static bool unpack(const uint8_t *in, size_t length, Values &values)
+        {
+            if (length != size)
+                return false;
+            if constexpr (quantized)
+            {
+                if (in[0] != QUANTIZED_CONTROL)
+                    return false;
+            }
+
+            return loadAll(in, std::index_sequence_for<Fields...>{}, values);
+        }
+
+        /**
+         * Decodes `count` frames stored back to back (`size` bytes each) into
+         * one column array per field, each holding `count` values. Frames are
+         * checked up front; decoding stops before the first one whose header
+         * bytes do not match the schema.
+         *
+         * @return the number of frames decoded.
+         */
+        static size_t unpackColumns(const uint8_t *frames, size_t count, typename Fields::value_type *...columns)
+        {
+            size_t valid = 0;
+            while (valid < count && matches(frames + valid * size))
+                valid++;
+
+            loadColumns(frames, valid, std::index_sequence_for<Fields...>{}, columns...);
+            return valid;
+        }
+
+    private:
+        static bool matches(const uint8_t *frame)
+        {
+            if constexpr (quantized)
+            {
+                if (frame[0] != QUANTIZED_CONTROL)
+                    return false;
+            }
+            for (size_t i = 0; i < sizeof...(Fields); i++)
+            {
+                if (frame[offset(i)] != headers[i])
+                    return false;
+            }
+            return true;
+        }
+    };
+}
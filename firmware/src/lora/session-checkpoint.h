@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Lora::Wan
+{
+    // Uplinks between two session checkpoints in flash.
+    constexpr uint32_t SESSION_CHECKPOINT_INTERVAL = 32;
+
+    /**
+     * Decides when the LoRaWAN session has to be written to flash. Writing
+     * after every uplink would wear the flash out, so the uplink frame
+     * counter is only checkpointed every `SESSION_CHECKPOINT_INTERVAL`
+     * uplinks; a restored session skips that many counts, so a counter is
+     * never reused even if the uplinks since the last checkpoint were lost.
+     */
+    class SessionCheckpoint
+    {
+    public:
+        // The session is new (joined) or was restored with a skipped counter and must be written.
+        void changed() { _changed = true; }
+
+        // Whether the session has to be written at uplink frame counter `fcnt_up`. A counter behind the
+        // checkpoint is covered by it already, the signed difference keeps that from wrapping into a write.
+        bool due(uint32_t fcnt_up) const
+        {
+            return _changed || static_cast<int32_t>(fcnt_up - _saved_fcnt_up) >= static_cast<int32_t>(SESSION_CHECKPOINT_INTERVAL);
+        }
+
+        void saved(uint32_t fcnt_up)
+        {
+            _changed = false;
+            _saved_fcnt_up = fcnt_up;
+        }
+
+        // Uplink frame counter to continue with after restoring a session saved at `fcnt_up`.
+        static uint32_t resume(uint32_t fcnt_up) { return fcnt_up + SESSION_CHECKPOINT_INTERVAL; }
+
+    private:
+        bool _changed = false;
+        uint32_t _saved_fcnt_up = 0;
+    };
+}
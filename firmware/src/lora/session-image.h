@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Lora::Wan
+{
+    // Bump when the layout of the saved LMIC state changes, e.g. after a library update.
+    constexpr uint16_t SESSION_IMAGE_VERSION = 1;
+
+    // CRC-16/CCITT-FALSE
+    inline uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xffff)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            crc ^= static_cast<uint16_t>(data[i]) << 8;
+            for (int bit = 0; bit < 8; bit++)
+                crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        return crc;
+    }
+
+    /**
+     * A saved LMIC session as kept in RTC memory or flash: the raw state
+     * written by `LMIC.saveState`, guarded by a version and a checksum so
+     * that neither a torn write nor a firmware update restores garbage.
+     */
+    template <size_t Capacity>
+    struct SessionImage
+    {
+        static constexpr uint32_t MAGIC = 0x52464c53; // "RFLS"
+
+        uint32_t magic;
+        uint16_t version;
+        uint16_t length;
+        uint16_t crc;
+        uint8_t data[Capacity];
+
+        /**
+         * Copies `length` bytes of LMIC state into the image.
+         *
+         * @return false, leaving the image invalid, if the state does not fit.
+         */
+        bool store(const uint8_t *state, size_t state_length)
+        {
+            clear();
+            if (state_length > Capacity)
+                return false;
+
+            std::memcpy(data, state, state_length);
+            length = static_cast<uint16_t>(state_length);
+            version = SESSION_IMAGE_VERSION;
+            crc = crc16(data, length);
+            magic = MAGIC;
+            return true;
+        }
+
+        bool valid() const
+        {
+            return magic == MAGIC && version == SESSION_IMAGE_VERSION && length <= Capacity && crc == crc16(data, length);
+        }
+
+        void clear() { magic = 0; }
+    };
+}
@@ -0,0 +1,132 @@
+#include "./uplink-queue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Lora::Protocol
+{
+    namespace
+    {
+        constexpr uint8_t header(const DataPoint &dp)
+        {
+            return static_cast<uint8_t>(dp.measurement_type) << 4 | static_cast<uint8_t>(dp.channel_id);
+        }
+
+        void writeU32(uint32_t value, uint8_t *out)
+        {
+            for (size_t i = 0; i < sizeof(uint32_t); i++)
+                out[i] = (value >> (8 * i)) & 0xff;
+        }
+
+        uint32_t readU32(const uint8_t *in)
+        {
+            return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+        }
+    }
+
+    void writeSpillRecord(const QueuedDataPoint &entry, uint8_t *out)
+    {
+        const DataPoint &dp = entry.data_point;
+        out[0] = header(dp);
+        if (const bool *val = std::get_if<bool>(&dp.value))
+        {
+            writeU32(*val, out + 1);
+        }
+        else
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &std::get<float>(dp.value), sizeof(bits));
+            writeU32(bits, out + 1);
+        }
+        out[5] = entry.priority;
+        writeU32(entry.sampled_ms, out + 6);
+    }
+
+    bool readSpillRecord(const uint8_t *in, QueuedDataPoint &entry)
+    {
+        const auto type = static_cast<MeasurementType>(in[0] >> 4);
+        if (static_cast<uint8_t>(type) > static_cast<uint8_t>(MeasurementType::SoundLevel))
+            return false;
+
+        entry.data_point.measurement_type = type;
+        entry.data_point.channel_id = static_cast<ChannelID>(in[0] & 0x0f);
+        const uint32_t bits = readU32(in + 1);
+        if (type == MeasurementType::Boolean)
+        {
+            entry.data_point.value = bits != 0;
+        }
+        else
+        {
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            entry.data_point.value = value;
+        }
+        entry.priority = in[5];
+        entry.sampled_ms = readU32(in + 6);
+        return true;
+    }
+
+    UplinkQueue::PushResult UplinkQueue::push(const QueuedDataPoint &entry, QueuedDataPoint &evicted)
+    {
+        const uint8_t key = header(entry.data_point);
+        for (size_t i = 0; i < _size; i++)
+        {
+            if (header(_entries[i].data_point) == key)
+            {
+                _coalesced++;
+                // An older value, e.g. from the flash spill, never replaces a newer one
+                if (static_cast<int32_t>(entry.sampled_ms - _entries[i].sampled_ms) < 0)
+                    return PushResult::Coalesced;
+
+                QueuedDataPoint merged = entry;
+                merged.priority = std::max(entry.priority, _entries[i].priority);
+                erase(i);
+                insert(merged);
+                return PushResult::Coalesced;
+            }
+        }
+
+        if (!full())
+        {
+            insert(entry);
+            return PushResult::Queued;
+        }
+
+        // The lowest priority is at the end, its oldest entry at the start of that run
+        const uint8_t lowest = _entries[_size - 1].priority;
+        if (entry.priority < lowest)
+        {
+            evicted = entry;
+            return PushResult::Rejected;
+        }
+
+        size_t oldest = _size - 1;
+        while (oldest > 0 && _entries[oldest - 1].priority == lowest)
+            oldest--;
+
+        evicted = _entries[oldest];
+        erase(oldest);
+        insert(entry);
+        return PushResult::Evicted;
+    }
+
+    void UplinkQueue::insert(const QueuedDataPoint &entry)
+    {
+        // After every entry of the same or a higher priority
+        size_t position = _size;
+        while (position > 0 && _entries[position - 1].priority < entry.priority)
+        {
+            _entries[position] = _entries[position - 1];
+            position--;
+        }
+        _entries[position] = entry;
+        _size++;
+    }
+
+    void UplinkQueue::erase(size_t index)
+    {
+        for (size_t i = index + 1; i < _size; i++)
+            _entries[i - 1] = _entries[i];
+        _size--;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "frame-planner.h"
+#include "protocol.h"
+
+namespace Lora::Protocol
+{
+    // Datapoints waiting for an uplink; one drain plans them all at once.
+    constexpr size_t UPLINK_QUEUE_CAPACITY = MAX_PLANNED_DATA_POINTS;
+
+    struct QueuedDataPoint
+    {
+        DataPoint data_point;
+        uint8_t priority;
+        uint32_t sampled_ms; // millis() at sampling
+    };
+
+    // Size of a queued datapoint in its flash spill record.
+    constexpr size_t SPILL_RECORD_SIZE = 10;
+
+    /**
+     * Serializes `entry` for spilling to flash: header, value (uint8 for
+     * Booleans, float otherwise, little endian), priority, sampled_ms.
+     */
+    void writeSpillRecord(const QueuedDataPoint &entry, uint8_t *out);
+
+    // @return false if `in` is no valid spill record
+    bool readSpillRecord(const uint8_t *in, QueuedDataPoint &entry);
+
+    /**
+     * Bounded store-and-forward queue for datapoints that could not be sent
+     * right away, e.g. during a join or duty-cycle backoff. Entries are kept
+     * in order of descending priority, oldest first for equal priorities. A
+     * newer value of a channel that is already queued replaces the old one.
+     */
+    class UplinkQueue
+    {
+    public:
+        enum class PushResult : uint8_t
+        {
+            Queued,
+            // Replaced the queued value of the same channel
+            Coalesced,
+            // Queued, but the queue was full and `evicted` had to make room
+            Evicted,
+            // The queue is full of entries with a higher priority, `entry` was not queued
+            Rejected,
+        };
+
+        /**
+         * Queues `entry`. When the queue is full, the oldest entry of the
+         * lowest priority is evicted, unless `entry` ranks below all of them.
+         */
+        PushResult push(const QueuedDataPoint &entry, QueuedDataPoint &evicted);
+
+        // Removes every entry `remove(index)` returns true for, indices as before the call.
+        template <typename Remove>
+        void removeIf(Remove remove)
+        {
+            size_t kept = 0;
+            for (size_t i = 0; i < _size; i++)
+            {
+                if (!remove(i))
+                    _entries[kept++] = _entries[i];
+            }
+            _size = kept;
+        }
+
+        void clear() { _size = 0; }
+
+        const QueuedDataPoint &operator[](size_t index) const { return _entries[index]; }
+        size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+        bool full() const { return _size == UPLINK_QUEUE_CAPACITY; }
+
+        // Number of values replaced by a newer one of the same channel.
+        uint32_t coalesced() const { return _coalesced; }
+
+    private:
+        void insert(const QueuedDataPoint &entry);
+        void erase(size_t index);
+
+        std::array<QueuedDataPoint, UPLINK_QUEUE_CAPACITY> _entries;
+        size_t _size = 0;
+        uint32_t _coalesced = 0;
+    };
+}
@@ -0,0 +1,628 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "airtime.h"
+#include "change-tracker.h"
+#include "confirmation-policy.h"
+#include "frame-planner.h"
+#include "link-quality.h"
+#include "network-clock.h"
+#include "protocol.h"
+#include "uplink-queue.h"
+
+namespace Lora::Wan
+{
+    // Uplinks between two link status reports, which are also sent whenever the
+    // data rate or TX power changed.
+    constexpr uint32_t LINK_STATUS_INTERVAL = 32;
+
+    // LMIC does not tell which channel it picks until the uplink is gone, so all
+    // airtime is booked to the band of the default channels.
+    constexpr uint8_t AIRTIME_BAND = 0;
+
+    // A retry the airtime budget holds back is tried again after this long,
+    // the ledger frees airtime minute by minute.
+    constexpr uint32_t AIRTIME_RECHECK_MS = 60000;
+
+    struct UplinkSettings
+    {
+        // Send values in their 16 bit fixed point encoding (see quantization.h) instead of raw floats.
+        bool quantized = true;
+        // Duty cycle of the sub-band the default channels live in.
+        float duty_cycle = 0.01f;
+        // Whether the network server adjusts the data rate (ADR); without it the
+        // device raises the data rate itself from the SNR margin of downlinks.
+        bool adr = true;
+        // Frames whose oldest datapoint was sampled longer ago than this carry a
+        // timestamp, if the network time is known.
+        uint32_t dating_age_ms = 2000;
+        // Network time is requested again once the last answer is this old.
+        uint32_t network_time_resync_ms = 24UL * 60 * 60 * 1000;
+        // Records the spill holds before further datapoints are dropped, 0 without a spill.
+        size_t spill_records = 0;
+    };
+
+    /**
+     * The uplink state that outlives a deep sleep, the firmware keeps it in
+     * RTC memory. Every member is initialized in place: a constant-initialized
+     * instance is not reset by the startup code after a wake-up.
+     */
+    struct UplinkMemory
+    {
+        // Remembers the last delivered frame for change-only uplinks.
+        Protocol::ChangeTracker change_tracker;
+        // Uplinks are numbered as they are queued, so a TXCOMPLETE can be told
+        // apart from the frame carrying the change tracker's selection.
+        uint32_t frames_sent = 0;
+        ConfirmationPolicy confirmation_policy;
+        // Quality of received downlinks and the radio settings last reported in an uplink.
+        LinkQuality link_quality;
+        Protocol::LinkStatus reported_link_status{};
+        uint32_t uplinks_since_link_status = LINK_STATUS_INTERVAL;
+        // Airtime of the last uplink, which stretches the publish interval.
+        std::atomic<uint32_t> last_airtime_ms{0};
+        // Acknowledgement of a config downlink (sequence << 8 | status, or -1 for
+        // none), it goes out with the next uplink.
+        std::atomic<int32_t> config_ack{-1};
+    };
+
+    /**
+     * Keeps datapoints the full uplink queue pushes out. Records are
+     * `Protocol::SPILL_RECORD_SIZE` bytes, appended at the end and read back
+     * from the head on; `UplinkScheduler` keeps count of them.
+     */
+    struct NoSpill
+    {
+        // @return whether the record was stored
+        bool append(const uint8_t *) { return false; }
+        // Reads `count` records from record `first` on, returns how many it read.
+        size_t read(size_t, uint8_t *, size_t) { return 0; }
+        // Removes all records.
+        void clear() {}
+    };
+
+    /**
+     * The uplink path of the firmware, apart from LMIC and the hardware.
+     *
+     * Datapoints are queued with their priority and drained into as many
+     * uplinks as the data rate needs, highest priority first. With change-only
+     * uplinks only the channels that changed are queued, with a keyframe now
+     * and then. Frames with older datapoints are dated by a timestamp and
+     * offsets. Frames carrying critical channels go out confirmed and are
+     * retried with backoff, at a lower data rate if they keep failing; the
+     * queue waits meanwhile, so the alarm is not overtaken. Every uplink is
+     * booked against the duty cycle and the daily airtime budget, and the data
+     * rate follows the link unless ADR owns it.
+     *
+     * `Lmic` adapts LMIC and provides, besides what `LmicService` needs,
+     *
+     *     uint32_t millis();                // local clock, starts over on a wake-up
+     *     uint32_t seconds();               // monotonic clock that keeps running through deep sleep
+     *     uint32_t random();
+     *     uint8_t dr();
+     *     void setDr(uint8_t dr);
+     *     int8_t txPower();
+     *     void send(const uint8_t *frame, size_t size, bool confirmed);
+     *     void requestNetworkTime();        // asks for the network time along with the next uplink
+     *
+     * The answer to a network time request goes to `networkClock()`, the
+     * outcome of an uplink to `txComplete`. `Spill` is a `NoSpill` or stores
+     * like it. The simulator runs this class against a simulated LMIC.
+     */
+    template <typename Lmic, typename Spill = NoSpill>
+    class UplinkScheduler
+    {
+    public:
+        UplinkScheduler(Lmic &lmic, UplinkMemory &memory, const UplinkSettings &settings, Spill &spill)
+            : _lmic(lmic), _memory(memory), _settings(settings), _spill(spill)
+        {
+        }
+
+        /**
+         * Change-only uplinks with `deadband` (NaN disables them) and a keyframe
+         * every `keyframe_interval` uplinks, and the daily airtime budget (0 for
+         * none). May be called from another task than the one sending.
+         */
+        void configure(float deadband, uint16_t keyframe_interval, uint32_t airtime_budget_ms)
+        {
+            _deadband.store(deadband, std::memory_order_relaxed);
+            _keyframe_interval.store(keyframe_interval, std::memory_order_relaxed);
+            _airtime_budget_ms.store(airtime_budget_ms, std::memory_order_relaxed);
+        }
+
+        // Selects the datapoints worth sending, sampled at `sampled_ms`, queues and sends them.
+        void publish(const Protocol::DataPoint *data_points, size_t count, uint32_t sampled_ms)
+        {
+            std::array<Protocol::DataPoint, Protocol::MAX_TRACKED_CHANNELS> changed;
+            bool keyframe = true;
+
+            if (count > 0 && configureChangeTracker())
+            {
+                count = _memory.change_tracker.select(data_points, count, changed.data(), keyframe);
+                data_points = changed.data();
+                // No channel changed
+                if (count == 0 && !keyframe)
+                    return;
+            }
+
+            // A keyframe covers every channel, so it coalesces with whatever is still queued
+            if (keyframe)
+                _keyframe_pending = true;
+
+            for (size_t i = 0; i < count; i++)
+                enqueue(data_points[i], sampled_ms);
+
+            drain();
+        }
+
+        /**
+         * Sends the batches in one uplink, dropping the oldest samples of those
+         * that do not fit. `newest_ms` is the local time the newest sample was
+         * taken at.
+         *
+         * @return false if the uplink could not be queued, the caller keeps the batches then
+         */
+        bool publish(const Protocol::Batch *batches, size_t count, uint32_t newest_ms)
+        {
+            size_t trimmed = 0;
+            const bool sent = send([&](Protocol::Encoder &encoder)
+                                   {
+                                       trimmed = 0;
+                                       if (count > 0 && _clock.synchronized() && !encoder.addTimestamp(_clock.toGps(newest_ms)))
+                                           return false;
+                                       for (size_t i = 0; i < count; i++)
+                                       {
+                                           Protocol::Batch batch = batches[i];
+                                           while (batch.count > 1 && Protocol::packed_size(batch) > encoder.remaining())
+                                           {
+                                               batch.samples++;
+                                               batch.count--;
+                                           }
+                                           trimmed += batches[i].count - batch.count;
+                                           if (!encoder.add(batch))
+                                               return false;
+                                       }
+                                       return true; });
+            if (sent)
+                _dropped += trimmed;
+            return sent;
+        }
+
+        // Sends an empty uplink, which starts the OTAA join.
+        bool sendEmpty()
+        {
+            return send([](Protocol::Encoder &)
+                        { return true; });
+        }
+
+        /**
+         * Queues the next uplink once the previous one completed: an
+         * unacknowledged confirmed frame goes first, otherwise what is queued.
+         *
+         * @return whether an uplink was queued
+         */
+        bool sendNext()
+        {
+            if (_confirmed_frame_size > 0)
+                return retryConfirmed();
+            return drain();
+        }
+
+        // Shortens `due_ms`, the time until the caller polls again, to the retry of a confirmed frame.
+        uint32_t dueMs(uint32_t due_ms) const
+        {
+            if (_confirmed_frame_size == 0 || _confirmed_in_flight)
+                return due_ms;
+            const int32_t retry_ms = static_cast<int32_t>(_confirmed_retry_ms - _lmic.millis());
+            return std::min<uint32_t>(due_ms, retry_ms > 0 ? retry_ms : 0);
+        }
+
+        /**
+         * The uplink completed; `acknowledged` if the network confirmed it,
+         * `downlink` if one was received, with its `rssi` (dBm) and `snr` (dB).
+         */
+        void txComplete(bool acknowledged, bool downlink, int16_t rssi, float snr)
+        {
+            // An unconfirmed uplink is as delivered as it gets, a confirmed one needs the ACK
+            if (!_confirmed_in_flight || acknowledged)
+                _memory.change_tracker.acknowledge(_frame_in_flight);
+            if (_confirmed_in_flight)
+                confirmedCompleted(acknowledged);
+
+            auto &link = _memory.link_quality;
+            link.uplink();
+            _memory.uplinks_since_link_status++;
+            if (downlink)
+                link.downlink(rssi, snr);
+
+            const uint8_t dr = _lmic.dr();
+            const uint8_t next_dr = link.adapt(dr, !_settings.adr);
+            if (next_dr != dr)
+                _lmic.setDr(next_dr);
+        }
+
+        // A new session means the backend may have lost the reference frame and the network time may differ.
+        void joined()
+        {
+            _memory.change_tracker.invalidate();
+            _clock.invalidate();
+        }
+
+        // Acknowledges a config downlink with the next uplink.
+        void acknowledgeConfig(uint8_t sequence, Protocol::ConfigStatus status)
+        {
+            _memory.config_ack.store(sequence << 8 | static_cast<uint8_t>(status), std::memory_order_relaxed);
+        }
+
+        // Whether nothing is queued, spilled or waiting for a retry.
+        bool idle() const { return _queue.empty() && _spilled == 0 && _confirmed_frame_size == 0; }
+
+        // Shortest publish interval that keeps uplinks like the last one within the duty cycle and airtime budget.
+        uint32_t minPublishIntervalMs() const
+        {
+            return Protocol::minUplinkIntervalMs(_memory.last_airtime_ms.load(std::memory_order_relaxed), _settings.duty_cycle,
+                                                 _airtime_budget_ms.load(std::memory_order_relaxed));
+        }
+
+        // Data rate, TX power and last downlink as reported in uplinks.
+        Protocol::LinkStatus linkStatus() const
+        {
+            const auto &link = _memory.link_quality;
+            return {_lmic.dr(), _lmic.txPower(), link.rssi(), static_cast<int8_t>(std::lround(link.snr()))};
+        }
+
+        Protocol::NetworkClock &networkClock() { return _clock; }
+        const LinkQuality &linkQuality() const { return _memory.link_quality; }
+        const Protocol::AirtimeLedger &airtimeLedger() const { return _ledger; }
+        // Datapoints waiting in the queue and the spill.
+        size_t queueDepth() const { return _queue.size() + _spilled; }
+        // Datapoints and batch samples dropped for lack of room.
+        uint32_t dropped() const { return _dropped; }
+        // Queued values replaced by a newer one of the same channel.
+        uint32_t coalesced() const { return _queue.coalesced(); }
+        // Confirmed uplinks given up on.
+        uint32_t confirmedFailed() const { return _confirmed_failed; }
+
+    private:
+        // Whether the next uplink reports the link status.
+        bool linkStatusDue() const
+        {
+            const auto status = linkStatus();
+            const auto &reported = _memory.reported_link_status;
+            return _memory.uplinks_since_link_status >= LINK_STATUS_INTERVAL || status.dr != reported.dr ||
+                   status.tx_power_dbm != reported.tx_power_dbm;
+        }
+
+        // Bytes of the control entries `send` puts in front of the next frame.
+        size_t controlOverhead() const
+        {
+            return (_memory.config_ack.load(std::memory_order_relaxed) < 0 ? 0 : Protocol::CONFIG_ACK_PACKED_SIZE) +
+                   (linkStatusDue() ? Protocol::LINK_STATUS_PACKED_SIZE : 0);
+        }
+
+        // Payload limit at the data rate the next uplink goes out with, less the control entries of `send`.
+        size_t maxPayloadSize() const
+        {
+            return Protocol::maxPayloadSize(_lmic.dr()) - controlOverhead();
+        }
+
+        // Hands the frame numbered `number` to LMIC, unless it would exceed the airtime budget.
+        bool transmit(const uint8_t *frame, size_t size, bool confirmed, uint32_t number)
+        {
+            // Rounded up, so the ledger never undercounts
+            const uint32_t airtime_ms = (Protocol::airtimeUs(_lmic.dr(), size) + 999) / 1000;
+            const uint32_t now_ms = _lmic.millis();
+            if (!_ledger.allows(now_ms / 1000, AIRTIME_BAND, airtime_ms, _settings.duty_cycle, _airtime_budget_ms.load(std::memory_order_relaxed)))
+                return false;
+
+            if (_clock.stale(now_ms, _settings.network_time_resync_ms))
+                _lmic.requestNetworkTime();
+
+            _lmic.send(frame, size, confirmed);
+            _ledger.record(now_ms / 1000, AIRTIME_BAND, airtime_ms);
+            _memory.last_airtime_ms.store(airtime_ms, std::memory_order_relaxed);
+            _frame_in_flight = number;
+            _confirmed_in_flight = confirmed;
+            return true;
+        }
+
+        // Encodes the next uplink into the TX buffer via `encode` and queues it, `confirmed` if asked to.
+        // Returns false if a TX/RX is still pending or the frame did not fit, the caller keeps its data then.
+        template <typename Encode>
+        bool send(Encode encode, bool confirmed = false)
+        {
+            if (_lmic.pending())
+                return false;
+
+            int32_t ack = _memory.config_ack.load(std::memory_order_relaxed);
+            const bool report_link = linkStatusDue();
+            Protocol::Encoder encoder(_tx_buffer.data(), std::min(_tx_buffer.size(), Protocol::maxPayloadSize(_lmic.dr())));
+            if (ack >= 0)
+                encoder.addConfigAck(ack >> 8, static_cast<Protocol::ConfigStatus>(ack & 0xff));
+            if (report_link)
+                encoder.addLinkStatus(linkStatus());
+            if (!encode(encoder) || encoder.overflowed())
+                return false;
+
+            if (!transmit(encoder.data(), encoder.size(), confirmed, _memory.frames_sent + 1))
+                return false;
+            _memory.frames_sent++;
+
+            // Unless a newer downlink replaced it meanwhile
+            _memory.config_ack.compare_exchange_strong(ack, -1);
+            if (report_link)
+            {
+                _memory.reported_link_status = linkStatus();
+                _memory.uplinks_since_link_status = 0;
+            }
+            if (confirmed)
+            {
+                std::copy(encoder.data(), encoder.data() + encoder.size(), _confirmed_frame.begin());
+                _confirmed_frame_size = encoder.size();
+                _confirmed_frame_number = _memory.frames_sent;
+                _memory.confirmation_policy.sent(_lmic.seconds());
+            }
+            return true;
+        }
+
+        // Resends the unacknowledged confirmed frame once its backoff passed, at a lower data rate if it keeps failing.
+        bool retryConfirmed()
+        {
+            if (_confirmed_in_flight || static_cast<int32_t>(_lmic.millis() - _confirmed_retry_ms) < 0 || _lmic.pending())
+                return false;
+
+            const uint8_t dr = _lmic.dr();
+            if (_memory.confirmation_policy.stepDown() && dr > 0 && _confirmed_frame_size <= Protocol::maxPayloadSize(dr - 1))
+                _lmic.setDr(dr - 1);
+            if (transmit(_confirmed_frame.data(), _confirmed_frame_size, true, _confirmed_frame_number))
+                return true;
+
+            // Otherwise the caller would be due right away until the budget allows it
+            _confirmed_retry_ms = _lmic.millis() + AIRTIME_RECHECK_MS;
+            return false;
+        }
+
+        // Evaluates the outcome of a confirmed uplink that just completed.
+        void confirmedCompleted(bool acknowledged)
+        {
+            auto &policy = _memory.confirmation_policy;
+            _confirmed_in_flight = false;
+            if (acknowledged)
+            {
+                policy.delivered();
+                _confirmed_frame_size = 0;
+            }
+            else if (policy.failed())
+            {
+                _confirmed_retry_ms = _lmic.millis() + policy.backoffMs(_lmic.random());
+            }
+            else
+            {
+                _confirmed_failed++;
+                _confirmed_frame_size = 0;
+            }
+        }
+
+        // Applies the change-only uplink config. Returns false when they are disabled.
+        bool configureChangeTracker()
+        {
+            const float deadband = _deadband.load(std::memory_order_relaxed);
+            if (std::isnan(deadband))
+                return false;
+
+            _memory.change_tracker.configure(deadband, _keyframe_interval.load(std::memory_order_relaxed));
+            return true;
+        }
+
+        // Appends `entry` to the spill, unless that is full.
+        bool spill(const Protocol::QueuedDataPoint &entry)
+        {
+            if (_spill_head + _spilled >= _settings.spill_records)
+                return false;
+
+            uint8_t record[Protocol::SPILL_RECORD_SIZE];
+            Protocol::writeSpillRecord(entry, record);
+            if (!_spill.append(record))
+                return false;
+            _spilled++;
+            return true;
+        }
+
+        /**
+         * Moves spilled datapoints back into the queue while it has room,
+         * oldest first. The spill is only read from the head on and cleared
+         * once all of it is back.
+         */
+        void unspill()
+        {
+            const size_t room = Protocol::UPLINK_QUEUE_CAPACITY - _queue.size();
+            if (_spilled == 0 || room == 0)
+                return;
+
+            std::array<uint8_t, Protocol::UPLINK_QUEUE_CAPACITY * Protocol::SPILL_RECORD_SIZE> records;
+            const size_t wanted = std::min(room, _spilled);
+            const size_t count = _spill.read(_spill_head, records.data(), wanted);
+            for (size_t i = 0; i < count; i++)
+            {
+                Protocol::QueuedDataPoint entry, evicted;
+                if (Protocol::readSpillRecord(records.data() + i * Protocol::SPILL_RECORD_SIZE, entry))
+                    _queue.push(entry, evicted);
+            }
+
+            // A short read means the spill lost records, nothing behind them is left
+            _spilled = count < wanted ? 0 : _spilled - count;
+            _spill_head += count;
+            if (_spilled == 0)
+            {
+                _spill.clear();
+                _spill_head = 0;
+            }
+        }
+
+        // Queues a datapoint; whatever a full queue pushes out is spilled or dropped.
+        void enqueue(const Protocol::DataPoint &data_point, uint32_t sampled_ms)
+        {
+            using PushResult = Protocol::UplinkQueue::PushResult;
+
+            Protocol::QueuedDataPoint evicted;
+            const auto result = _queue.push({data_point, Protocol::defaultPriority(data_point.measurement_type), sampled_ms}, evicted);
+            if ((result == PushResult::Evicted || result == PushResult::Rejected) && !spill(evicted))
+                _dropped++;
+        }
+
+        /**
+         * Sends as many queued datapoints as the current data rate allows,
+         * highest priority first, the rest stays queued for the next uplinks.
+         * Frames with older datapoints are dated by a timestamp and offsets.
+         *
+         * @return whether an uplink was queued
+         */
+        bool drain()
+        {
+            if (_lmic.pending())
+                return false;
+            unspill();
+            if (_queue.empty())
+                return false;
+
+            const size_t count = _queue.size();
+            std::array<Protocol::DataPoint, Protocol::UPLINK_QUEUE_CAPACITY> data_points;
+            std::array<uint8_t, Protocol::UPLINK_QUEUE_CAPACITY> priorities;
+            uint32_t oldest_ms = _queue[0].sampled_ms;
+            for (size_t i = 0; i < count; i++)
+            {
+                data_points[i] = _queue[i].data_point;
+                priorities[i] = _queue[i].priority;
+                if (static_cast<int32_t>(_queue[i].sampled_ms - oldest_ms) < 0)
+                    oldest_ms = _queue[i].sampled_ms;
+            }
+
+            // Seconds after the timestamp of the frame, all 0 for undated frames
+            std::array<uint32_t, Protocol::UPLINK_QUEUE_CAPACITY> offsets{};
+            const bool dated = _clock.synchronized() && _lmic.millis() - oldest_ms >= _settings.dating_age_ms;
+            const uint32_t base_s = dated ? _clock.toGps(oldest_ms) : 0;
+            const bool delta = !_keyframe_pending;
+            const bool quantized = _settings.quantized;
+
+            size_t overhead = (delta ? 1 : 0) + (quantized ? 1 : 0);
+            if (dated)
+            {
+                overhead += Protocol::TIMESTAMP_PACKED_SIZE;
+                for (size_t i = 0; i < count; i++)
+                {
+                    offsets[i] = _clock.toGps(_queue[i].sampled_ms) - base_s;
+                    // Each distinct offset may cost an offset entry
+                    if (offsets[i] != 0 && std::find(offsets.begin(), offsets.begin() + i, offsets[i]) == offsets.begin() + i)
+                        overhead += Protocol::offset_packed_size(offsets[i]);
+                }
+            }
+
+            if (_planner.plan(data_points.data(), priorities.data(), count, maxPayloadSize(), overhead, quantized) == 0)
+            {
+                // Queued datapoints that do not fit into any uplink
+                _dropped += count;
+                _queue.clear();
+                return false;
+            }
+
+            // The first frame, oldest datapoints first so that offsets only grow
+            std::array<uint8_t, Protocol::UPLINK_QUEUE_CAPACITY> selected;
+            size_t selected_count = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (_planner.frameOf(i) == 0)
+                    selected[selected_count++] = static_cast<uint8_t>(i);
+            }
+            std::stable_sort(selected.begin(), selected.begin() + selected_count, [&](uint8_t a, uint8_t b)
+                             { return offsets[a] < offsets[b]; });
+
+            uint8_t criticality = 0;
+            for (size_t i = 0; i < selected_count; i++)
+                criticality = std::max(criticality, priorities[selected[i]]);
+            const bool confirmed = _memory.confirmation_policy.confirm(criticality, _lmic.seconds());
+
+            const bool sent = send([&](Protocol::Encoder &encoder)
+                                   {
+                                       if (delta && !encoder.addControl(Protocol::ControlCode::Delta))
+                                           return false;
+                                       if (dated && !encoder.addTimestamp(base_s))
+                                           return false;
+                                       if (quantized && !encoder.enableQuantization())
+                                           return false;
+                                       encoder.enableFlags();
+
+                                       // Datapoints sharing an offset go in one run, so Booleans still fold into flags
+                                       std::array<Protocol::DataPoint, Protocol::UPLINK_QUEUE_CAPACITY> run;
+                                       uint32_t offset = 0;
+                                       for (size_t start = 0, end = 0; start < selected_count; start = end)
+                                       {
+                                           size_t run_count = 0;
+                                           while (end < selected_count && offsets[selected[end]] == offsets[selected[start]])
+                                               run[run_count++] = data_points[selected[end++]];
+
+                                           if (offsets[selected[start]] != offset)
+                                           {
+                                               offset = offsets[selected[start]];
+                                               if (!encoder.addOffset(offset))
+                                                   return false;
+                                           }
+                                           if (!encoder.add(run.data(), run_count))
+                                               return false;
+                                       }
+                                       return true; },
+                                   confirmed);
+            if (!sent)
+                return false;
+
+            _keyframe_pending = false;
+            _queue.removeIf([this](size_t i)
+                            { return _planner.frameOf(i) == 0; });
+            // The selection is out with the last frame that empties the queue
+            if (_queue.empty() && _spilled == 0)
+                _memory.change_tracker.sent(_memory.frames_sent);
+            return true;
+        }
+
+        Lmic &_lmic;
+        UplinkMemory &_memory;
+        const UplinkSettings _settings;
+        Spill &_spill;
+
+        std::atomic<float> _deadband{NAN};
+        std::atomic<uint16_t> _keyframe_interval{0};
+        std::atomic<uint32_t> _airtime_budget_ms{0};
+
+        // Uplink frames are encoded straight into this buffer, so publishing never touches the heap.
+        std::array<uint8_t, Protocol::MAX_PAYLOAD_SIZE> _tx_buffer;
+
+        // Each uplink takes as many datapoints as the payload limit of the
+        // current data rate allows, the rest goes out once it completed.
+        Protocol::UplinkQueue _queue;
+        Protocol::FramePlanner _planner;
+        uint32_t _dropped = 0;
+        size_t _spilled = 0;
+        // Records at the head of the spill that are back in the queue already.
+        size_t _spill_head = 0;
+        // The next frame from the queue starts with a keyframe selection.
+        bool _keyframe_pending = false;
+        uint32_t _frame_in_flight = 0;
+
+        // Network time, used to date frames carrying buffered samples.
+        Protocol::NetworkClock _clock;
+        Protocol::AirtimeLedger _ledger;
+
+        // A copy of the last confirmed frame, resent after a backoff until it is acknowledged or given up on.
+        std::array<uint8_t, Protocol::MAX_PAYLOAD_SIZE> _confirmed_frame;
+        size_t _confirmed_frame_size = 0;
+        uint32_t _confirmed_frame_number = 0;
+        bool _confirmed_in_flight = false;
+        uint32_t _confirmed_retry_ms = 0;
+        uint32_t _confirmed_failed = 0;
+    };
+}
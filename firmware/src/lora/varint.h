@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LEB128-style variable length integers as used by the batch frames: seven
+// bits per byte, least significant group first, high bit set on every byte
+// but the last. Signed values are zig-zag mapped first so that small
+// negative deltas stay small on the wire.
+namespace Lora::Protocol::Varint
+{
+    // A 64 bit value never needs more than ten bytes.
+    constexpr size_t MAX_SIZE = 10;
+
+    constexpr uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    constexpr int64_t unzigzag(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    constexpr size_t size(uint64_t value)
+    {
+        size_t bytes = 1;
+        while (value >= 0x80)
+        {
+            value >>= 7;
+            bytes++;
+        }
+        return bytes;
+    }
+
+    // Writes `value` to `out`, which must have room for `size(value)` bytes.
+    inline size_t write(uint64_t value, uint8_t *out)
+    {
+        size_t written = 0;
+        while (value >= 0x80)
+        {
+            out[written++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        out[written++] = static_cast<uint8_t>(value);
+        return written;
+    }
+
+    /**
+     * Reads a varint from `in`.
+     *
+     * @return the number of bytes consumed, or 0 if the input ends early or
+     *         the value is longer than `MAX_SIZE` bytes.
+     */
+    inline size_t read(const uint8_t *in, size_t length, uint64_t &value)
+    {
+        value = 0;
+        for (size_t i = 0; i < length && i < MAX_SIZE; i++)
+        {
+            value |= static_cast<uint64_t>(in[i] & 0x7f) << (7 * i);
+            if ((in[i] & 0x80) == 0)
+                return i + 1;
+        }
+        return 0;
+    }
+}
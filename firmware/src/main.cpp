@@ -2,7 +2,9 @@
 
 // Libraries
 #include <Arduino.h>
+#include <cmath>
 #include <esp32-hal-log.h>
+#include <esp_sleep.h>
 
 #define SCP_IMPLEMENTATION
 
@@ -17,8 +19,13 @@
 
 #if FEATURE_SENSOR_DS18B20
 #include "sensors/sensor-ds18b20.h"
+#include "sensors/temperature-conversion.h"
 #endif
 
+#include "sensors/distance-filter.h"
+#include "sensors/sample-buffer.h"
+#include "sensors/sampling-scheduler.h"
+
 // Button
 #ifdef BUTTON_PIN
 #include "button/button.h"
@@ -35,27 +42,321 @@
 // LoRaWAN
 #ifdef FEATURE_LORAWAN_ENABLED
 #include "lora/lora-wan.h"
+#include "lora/batcher.h"
 #endif
 
 // Default publish interval (seconds) used when `publishInterval` is not set in
 // the runtime configuration. Configurable at runtime via the SCP config key.
 #define PUBLISH_INTERVAL_DEFAULT_S 30
 unsigned long last_print_time = 0;
+unsigned long last_sample_time = 0;
+
+// Parses a config value holding a positive number of seconds, falling back to
+// `fallback` when it is unset or invalid.
+unsigned long configSeconds(const std::string &value, unsigned long fallback)
+{
+    if (!value.empty())
+    {
+        char *end = nullptr;
+        unsigned long parsed = strtoul(value.c_str(), &end, 10);
+        if (end != value.c_str() && parsed > 0)
+            return parsed;
+    }
+    return fallback;
+}
 
 // Returns the configured publish interval in milliseconds, falling back to the
-// default when the `publishInterval` config key is unset or invalid.
+// default when the `publishInterval` config key is unset or invalid. It is
+// stretched when uplinks would otherwise exceed the duty cycle or airtime budget.
 unsigned long publishIntervalMs()
 {
-    const auto &interval = Configuration::Configurator::getConfig().publishInterval;
-    unsigned long seconds = PUBLISH_INTERVAL_DEFAULT_S;
-    if (!interval.empty())
+    const unsigned long interval_ms = configSeconds(Configuration::Configurator::getConfig().publishInterval, PUBLISH_INTERVAL_DEFAULT_S) * 1000UL;
+#ifdef FEATURE_LORAWAN_ENABLED
+    return std::max<unsigned long>(interval_ms, Lora::Wan::minPublishIntervalMs());
+#else
+    return interval_ms;
+#endif
+}
+
+// Returns the configured sample interval in seconds. When `sampleInterval` is
+// set, readings are taken at that rate and sent as batches on every publish;
+// when unset (0) each uplink carries only the latest reading.
+unsigned long sampleIntervalS()
+{
+    return configSeconds(Configuration::Configurator::getConfig().sampleInterval, 0);
+}
+
+// Light-sleep between loop passes when nothing is due. The timer and the
+// button wake the device; serial input does not, so SCP needs a button press
+// first. Off by default.
+#ifndef FEATURE_LIGHT_SLEEP
+#define FEATURE_LIGHT_SLEEP false
+#endif
+
+// Deep-sleep between uplinks, keeping the LoRaWAN session in RTC memory. Each
+// wake-up samples and publishes once, so batching (`sampleInterval`) is not
+// available. Off by default.
+#ifndef FEATURE_DEEP_SLEEP
+#define FEATURE_DEEP_SLEEP false
+#endif
+
+// Shorter idle times are not worth entering light sleep for.
+#define LIGHT_SLEEP_MIN_MS 10
+
+// Milliseconds until a task last run at `last` with period `interval_ms` is due again.
+unsigned long untilDue(unsigned long now, unsigned long last, unsigned long interval_ms)
+{
+    const unsigned long elapsed = now - last;
+    return elapsed >= interval_ms ? 0 : interval_ms - elapsed;
+}
+
+// Sleeps for `idle_ms` if light sleep is enabled and it is worth it.
+void idle([[maybe_unused]] unsigned long idle_ms)
+{
+#if FEATURE_LIGHT_SLEEP
+    if (idle_ms < LIGHT_SLEEP_MIN_MS)
+        return;
+
+    esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(idle_ms) * 1000);
+#ifdef BUTTON_PIN
+    gpio_wakeup_enable(static_cast<gpio_num_t>(BUTTON_PIN), GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+#endif
+    Serial.flush();
+    esp_light_sleep_start();
+#endif
+}
+
+// Sampling of the HC-SR04: a background period (0 samples before publishes
+// only) and the samples taken before each publish. The module needs 60 ms to
+// settle between two measurements.
+#ifndef HCSR04_SAMPLE_PERIOD_MS
+#define HCSR04_SAMPLE_PERIOD_MS 0
+#endif
+#ifndef HCSR04_OVERSAMPLING
+#define HCSR04_OVERSAMPLING 5
+#endif
+#define HCSR04_BURST_SPACING_MS 100
+
+// Samples of all sensors, enough for the bursts of one publish.
+#define SAMPLE_BUFFER_CAPACITY 32
+
+// Samples the median of distances runs over; outliers are rejected while
+// they make up less than half of it.
+#define DISTANCE_FILTER_WINDOW 9
+
+Sensor::SamplingScheduler scheduler;
+Sensor::SampleBuffer<SAMPLE_BUFFER_CAPACITY> samples;
+
+// Parses a config value holding a number, falling back to `fallback` when it
+// is unset or invalid.
+float configFloat(const std::string &value, float fallback)
+{
+    if (!value.empty())
     {
         char *end = nullptr;
-        unsigned long parsed = strtoul(interval.c_str(), &end, 10);
-        if (end != interval.c_str() && parsed > 0)
-            seconds = parsed;
+        const float parsed = strtof(value.c_str(), &end);
+        if (end != value.c_str())
+            return parsed;
     }
-    return seconds * 1000UL;
+    return fallback;
+}
+
+// Returns the `processNoise` config value, the variance (cm²) the level may
+// drift per second, or the filter's default when it is unset or invalid.
+float processNoise()
+{
+    const float fallback = Sensor::DISTANCE_FILTER_DEFAULTS.process_noise;
+    const float noise = configFloat(Configuration::Configurator::getConfig().processNoise, fallback);
+    return noise > 0.0f ? noise : fallback;
+}
+
+// Air temperature (°C) assumed when there is no DS18B20 reading and
+// `airTemperature` is not set in the runtime configuration.
+#define AIR_TEMPERATURE_DEFAULT_C 20.0f
+
+// Air temperature for the speed of sound: the DS18B20's reading if there is
+// one, the `airTemperature` config value otherwise.
+float airTemperatureC()
+{
+#if FEATURE_SENSOR_DS18B20
+    const float measured = Sensor::DS18B20::temperatureC();
+    if (!std::isnan(measured))
+        return measured;
+#endif
+    return configFloat(Configuration::Configurator::getConfig().airTemperature, AIR_TEMPERATURE_DEFAULT_C);
+}
+
+#if FEATURE_SENSOR_HCSR04
+int hcsr04_sensor = -1;
+Sensor::DistanceFilter<DISTANCE_FILTER_WINDOW> hcsr04_filter;
+
+// Batches need a reading every sample interval, bursts alone only come before publishes.
+uint32_t hcsr04PeriodMs()
+{
+    const unsigned long sample_interval = sampleIntervalS();
+    return sample_interval > 0 ? sample_interval * 1000UL : HCSR04_SAMPLE_PERIOD_MS;
+}
+#endif
+
+// Sampling of the DS18B20 probes: one conversion per period and one before
+// each publish, which ends in time at any resolution.
+#ifndef DS18B20_SAMPLE_PERIOD_MS
+#define DS18B20_SAMPLE_PERIOD_MS 60000
+#endif
+
+#if FEATURE_SENSOR_DS18B20
+int ds18b20_sensor = -1;
+
+// Returns the `temperatureResolution` config value in bits, 9 to 12; more
+// bits take longer to convert. 12 when unset or invalid.
+uint8_t temperatureResolution()
+{
+    const float bits = configFloat(Configuration::Configurator::getConfig().temperatureResolution, Sensor::DS18B20_MAX_RESOLUTION);
+    return Sensor::clampResolution(std::lround(bits));
+}
+#endif
+
+// Registers the enabled sensors with the scheduler.
+void scheduleSensors()
+{
+#if FEATURE_SENSOR_HCSR04
+    hcsr04_sensor = scheduler.add({hcsr04PeriodMs(), HCSR04_OVERSAMPLING, HCSR04_BURST_SPACING_MS, Sensor::NO_BUS}, millis());
+#endif
+#if FEATURE_SENSOR_DS18B20
+    ds18b20_sensor = scheduler.add({DS18B20_SAMPLE_PERIOD_MS, 1, Sensor::conversionTimeMs(Sensor::DS18B20_MAX_RESOLUTION), Sensor::NO_BUS}, millis());
+#endif
+}
+
+// Starts the measurements the scheduler has due and buffers the results of finished ones.
+void sampleSensors()
+{
+    const uint32_t now = millis();
+    int sensor;
+    while ((sensor = scheduler.due(now)) >= 0)
+    {
+#if FEATURE_SENSOR_HCSR04
+        if (sensor == hcsr04_sensor)
+        {
+            Sensor::HCSR04::setTemperature(airTemperatureC());
+            Sensor::HCSR04::measure();
+        }
+#endif
+#if FEATURE_SENSOR_DS18B20
+        if (sensor == ds18b20_sensor)
+        {
+            Sensor::DS18B20::setResolution(temperatureResolution());
+            Sensor::DS18B20::measure();
+        }
+#endif
+    }
+
+#if FEATURE_SENSOR_DS18B20
+    // Read before the HC-SR04's echo is converted
+    Sensor::DS18B20::loop();
+#endif
+
+#if FEATURE_SENSOR_HCSR04
+    scheduler.setPeriod(hcsr04_sensor, hcsr04PeriodMs());
+    // A measurement without echo is no sample
+    if (Sensor::HCSR04::loop() && Sensor::HCSR04::measureDistanceCm() >= 0)
+    {
+        const Sensor::Sample sample = {static_cast<uint8_t>(hcsr04_sensor), Sensor::HCSR04::measureDistanceCm(), static_cast<uint32_t>(millis())};
+        samples.push(sample);
+        hcsr04_filter.setProcessNoise(processNoise());
+        if (!hcsr04_filter.add(sample.value, sample.sampled_ms))
+            log_d("HCSR04:\t%.2f cm rejected as outlier", sample.value);
+    }
+#endif
+}
+
+// Whether samples for the next publish are outstanding.
+bool samplesPending()
+{
+#if FEATURE_SENSOR_HCSR04
+    if (Sensor::HCSR04::busy())
+        return true;
+#endif
+#if FEATURE_SENSOR_DS18B20
+    if (Sensor::DS18B20::busy())
+        return true;
+#endif
+    return scheduler.bursting();
+}
+
+// The filtered distance of `sensor` if it took a sample since `since_ms`, NaN otherwise.
+template <size_t N>
+float filteredDistance(int sensor, const Sensor::DistanceFilter<N> &filter, uint32_t since_ms)
+{
+    Sensor::Sample sample;
+    if (!filter.valid() || !samples.latest(static_cast<uint8_t>(sensor), sample) || static_cast<int32_t>(sample.sampled_ms - since_ms) < 0)
+        return NAN;
+    return filter.value();
+}
+
+// Upper bound of datapoints a single uplink carries.
+#define MAX_DATA_POINTS 4
+
+// Channel of the first DS18B20 probe, the others follow. The dashboard keys
+// series by channel alone, so it stays clear of the distance on channel 0.
+#ifndef DS18B20_FIRST_CHANNEL
+#define DS18B20_FIRST_CHANNEL 1
+#endif
+
+// Collects the readings of all enabled sensors since `since_ms` into
+// `data_points` and returns how many were written.
+size_t collectDataPoints([[maybe_unused]] Lora::Protocol::DataPoint *data_points, [[maybe_unused]] uint32_t since_ms)
+{
+    size_t count = 0;
+
+#if FEATURE_SENSOR_HCSR04
+    // Without a fresh sample the channel is left out, a batch restarts after the gap
+    const float distance = filteredDistance(hcsr04_sensor, hcsr04_filter, since_ms);
+    if (!std::isnan(distance))
+        data_points[count++] = {Lora::Protocol::MeasurementType::Distance, Lora::Protocol::ChannelID::_0, distance};
+#endif
+
+#if FEATURE_SENSOR_DS18B20
+    // A channel per probe from DS18B20_FIRST_CHANNEL on, in the order of their ROM addresses
+    for (size_t probe = 0; probe < Sensor::DS18B20::probes() && count < MAX_DATA_POINTS; probe++)
+    {
+        const float temperature = Sensor::DS18B20::temperatureC(probe);
+        if (!std::isnan(temperature))
+            data_points[count++] = {Lora::Protocol::MeasurementType::Temperature, static_cast<Lora::Protocol::ChannelID>(DS18B20_FIRST_CHANNEL + probe), temperature};
+    }
+#endif
+
+    return count;
+}
+
+Lora::Protocol::Batcher<MAX_DATA_POINTS> batcher;
+
+// Whether this boot or wake-up published anything yet.
+bool published = false;
+
+// Sends everything collected since the last uplink.
+void publish()
+{
+    published = true;
+    std::array<Lora::Protocol::DataPoint, MAX_DATA_POINTS> data_points;
+    const unsigned long sample_interval = sampleIntervalS();
+    if (sample_interval == 0)
+    {
+        Lora::Wan::publish2TTN(data_points.data(), collectDataPoints(data_points.data(), last_print_time));
+        return;
+    }
+
+    unsigned long newest_sample_time = last_sample_time;
+    if (batcher.samples() == 0)
+    {
+        batcher.add(data_points.data(), collectDataPoints(data_points.data(), last_sample_time));
+        newest_sample_time = millis();
+    }
+
+    std::array<Lora::Protocol::Batch, MAX_DATA_POINTS> batches;
+    const auto period = static_cast<uint16_t>(std::min<unsigned long>(sample_interval, UINT16_MAX));
+    if (Lora::Wan::publish2TTN(batches.data(), batcher.batches(batches.data(), period), newest_sample_time))
+        batcher.clear();
 }
 
 // Main functions
@@ -86,6 +387,12 @@ void setup()
     Sensor::HCSR04::setup();
 #endif
 
+#if FEATURE_SENSOR_DS18B20
+    Sensor::DS18B20::setup();
+    Sensor::DS18B20::setResolution(temperatureResolution());
+#endif
+    scheduleSensors();
+
 #if FEATURE_SENSOR_VL53L1X
 //    Sensor::VL53L1X::setup();
 #endif
@@ -102,8 +409,17 @@ void setup()
 
 // LoRaWAN
 #ifdef FEATURE_LORAWAN_ENABLED
-    Lora::Wan::setup();
-    Lora::Wan::publish2TTN(); // Initial Send to Trigger OTAA Join
+    if (Lora::Wan::setup())
+    {
+#if FEATURE_DEEP_SLEEP
+        // Woke up with a session, send right away
+        last_print_time = millis() - publishIntervalMs();
+#endif
+    }
+    else
+    {
+        Lora::Wan::publish2TTN(); // Initial Send to Trigger OTAA Join
+    }
 #endif
 }
 
@@ -113,16 +429,23 @@ void loop()
 
     // Publish Something, or Lora Does Noting
     unsigned long current_time = millis();
-    if (current_time - last_print_time >= publishIntervalMs())
+    scheduler.publishAt(last_print_time + publishIntervalMs(), current_time);
+    sampleSensors();
+
+    const unsigned long sample_interval = sampleIntervalS();
+    if (sample_interval > 0 && current_time - last_sample_time >= sample_interval * 1000UL)
     {
-        Lora::Wan::publish2TTN();
-        last_print_time = current_time;
+        std::array<Lora::Protocol::DataPoint, MAX_DATA_POINTS> data_points;
+        batcher.add(data_points.data(), collectDataPoints(data_points.data(), last_sample_time));
+        last_sample_time = current_time;
     }
 
-// Sensor
-#if FEATURE_SENSOR_HCSR04
-    Sensor::HCSR04::loop();
-#endif
+    // The bursts before it end on time, unless the publish was due right away
+    if (current_time - last_print_time >= publishIntervalMs() && !samplesPending())
+    {
+        publish();
+        last_print_time = current_time;
+    }
 
 // #if FEATURE_SENSOR_VL53L1X
 //     Sensor::VL53L1X::loop();
@@ -139,8 +462,33 @@ void loop()
 //     Display::SD1306::loop();
 // #endif
 
+    // Whatever is due first bounds the time the loop may idle
+    current_time = millis();
+    // A publish waiting for samples is bound by the sensors
+    unsigned long idle_ms = samplesPending() ? UINT32_MAX : untilDue(current_time, last_print_time, publishIntervalMs());
+    if (sample_interval > 0)
+        idle_ms = std::min(idle_ms, untilDue(current_time, last_sample_time, sample_interval * 1000UL));
+    idle_ms = std::min<unsigned long>(idle_ms, scheduler.untilDue(current_time));
+#if FEATURE_SENSOR_DS18B20
+    if (Sensor::DS18B20::busy())
+        idle_ms = std::min<unsigned long>(idle_ms, Sensor::DS18B20::untilDone());
+#endif
+#if FEATURE_SENSOR_HCSR04
+    // Light sleep would miss the edges of the echo
+    if (Sensor::HCSR04::busy())
+        idle_ms = 0;
+#endif
+
 // LoRaWAN
 #ifdef FEATURE_LORAWAN_ENABLED
-    Lora::Wan::loop();
+    idle_ms = std::min<unsigned long>(idle_ms, Lora::Wan::loop());
+
+#if FEATURE_DEEP_SLEEP
+    // Everything of this wake-up went out, sleep until the next publish
+    if (published && Lora::Wan::idle())
+        Lora::Wan::sleep(untilDue(millis(), last_print_time, publishIntervalMs()));
 #endif
+#endif
+
+    idle(idle_ms);
 }
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace Sensor
+{
+    // Scales a median absolute deviation to the standard deviation of normally distributed samples.
+    constexpr float MAD_SIGMA = 1.4826f;
+
+    /**
+     * Median of the newest `N` values, in fixed memory. The median ignores
+     * single shots off by any amount, such as echoes of the barrel wall.
+     */
+    template <size_t N>
+    class MedianFilter
+    {
+        static_assert(N > 0, "MedianFilter needs a window");
+
+    public:
+        void add(float value)
+        {
+            _values[_next] = value;
+            _next = (_next + 1) % N;
+            _size = std::min(_size + 1, N);
+        }
+
+        // Median of the window, the mean of the middle two for an even count. Not for an empty window.
+        float median() const
+        {
+            std::array<float, N> sorted;
+            std::copy(_values.begin(), _values.begin() + _size, sorted.begin());
+            return medianOf(sorted.data(), _size);
+        }
+
+        // Median of how far the values lie from `center`.
+        float deviation(float center) const
+        {
+            std::array<float, N> deviations;
+            for (size_t i = 0; i < _size; i++)
+                deviations[i] = std::fabs(_values[i] - center);
+            return medianOf(deviations.data(), _size);
+        }
+
+        size_t size() const { return _size; }
+        void clear() { _size = _next = 0; }
+
+    private:
+        // Reorders `values`.
+        static float medianOf(float *values, size_t count)
+        {
+            const size_t middle = count / 2;
+            std::nth_element(values, values + middle, values + count);
+            if (count % 2 == 1)
+                return values[middle];
+            return (values[middle] + *std::max_element(values, values + middle)) / 2.0f;
+        }
+
+        std::array<float, N> _values;
+        size_t _next = 0;
+        size_t _size = 0;
+    };
+
+    /**
+     * Estimates a slowly changing level, e.g. the water in the barrel, from
+     * noisy measurements: a random walk with `process_noise` (variance per
+     * second) observed with `measurement_noise` (variance).
+     */
+    class KalmanFilter
+    {
+    public:
+        KalmanFilter(float process_noise, float measurement_noise)
+            : _process_noise(process_noise), _measurement_noise(measurement_noise) {}
+
+        // Takes `measurement`, `dt_s` seconds after the previous one; returns the new estimate.
+        float update(float measurement, float dt_s)
+        {
+            if (!_initialized)
+            {
+                _initialized = true;
+                _estimate = measurement;
+                _variance = _measurement_noise;
+                return _estimate;
+            }
+
+            _variance += _process_noise * dt_s;
+            const float gain = _variance / (_variance + _measurement_noise);
+            _estimate += gain * (measurement - _estimate);
+            _variance *= 1.0f - gain;
+            return _estimate;
+        }
+
+        void setProcessNoise(float process_noise) { _process_noise = process_noise; }
+
+        float estimate() const { return _estimate; }
+        float variance() const { return _variance; }
+        bool initialized() const { return _initialized; }
+        void reset() { _initialized = false; }
+
+    private:
+        float _process_noise;
+        float _measurement_noise;
+        bool _initialized = false;
+        float _estimate = 0.0f;
+        float _variance = 0.0f;
+    };
+
+    struct DistanceFilterConfig
+    {
+        // Variance (cm²) the level may drift per second
+        float process_noise;
+        // Variance (cm²) of a single measurement
+        float measurement_noise;
+        // Samples further than this many standard deviations from the median are outliers
+        float outlier_threshold;
+        // Lower bound of that standard deviation (cm), identical samples have none
+        float min_deviation;
+    };
+
+    // Suits the ultrasonic and time-of-flight sensors in a barrel.
+    constexpr DistanceFilterConfig DISTANCE_FILTER_DEFAULTS = {0.01f, 1.0f, 3.0f, 1.0f};
+
+    /**
+     * The distance path of the ranging sensors: a sample further from the
+     * median of the last `N` than `outlier_threshold` scaled median absolute
+     * deviations is rejected, every other updates a Kalman filter with that
+     * median. Rejected samples still enter the window, so a real jump of the
+     * level passes once it makes up half the window.
+     */
+    template <size_t N>
+    class DistanceFilter
+    {
+    public:
+        explicit DistanceFilter(const DistanceFilterConfig &config = DISTANCE_FILTER_DEFAULTS)
+            : _config(config), _kalman(config.process_noise, config.measurement_noise) {}
+
+        // Feeds the sample taken at `sampled_ms`; @return false if it was rejected as an outlier
+        bool add(float value, uint32_t sampled_ms)
+        {
+            // A window of three decides, fewer do not
+            if (_window.size() >= 3)
+            {
+                const float median = _window.median();
+                const float deviation = std::max(MAD_SIGMA * _window.deviation(median), _config.min_deviation);
+                if (std::fabs(value - median) > _config.outlier_threshold * deviation)
+                {
+                    _window.add(value);
+                    _rejected++;
+                    return false;
+                }
+            }
+
+            _window.add(value);
+            const float dt_s = _kalman.initialized() ? (sampled_ms - _last_ms) / 1000.0f : 0.0f;
+            _kalman.update(_window.median(), dt_s);
+            _last_ms = sampled_ms;
+            return true;
+        }
+
+        void setProcessNoise(float process_noise) { _kalman.setProcessNoise(process_noise); }
+
+        // The filtered distance; only valid once a sample was accepted.
+        float value() const { return _kalman.estimate(); }
+        bool valid() const { return _kalman.initialized(); }
+
+        // Number of samples rejected as outliers.
+        uint32_t rejected() const { return _rejected; }
+
+    private:
+        DistanceFilterConfig _config;
+        MedianFilter<N> _window;
+        KalmanFilter _kalman;
+        uint32_t _last_ms = 0;
+        uint32_t _rejected = 0;
+    };
+}
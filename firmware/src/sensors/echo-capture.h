@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+namespace Sensor
+{
+    // Speed of sound in dry air at 20 °C.
+    constexpr float SPEED_OF_SOUND_M_S = 343.0f;
+
+    // Speed of sound (m/s) in dry air at `temperature_c`, linearized; off by less than 0.2 % from -30 to 50 °C.
+    constexpr float speedOfSound(float temperature_c)
+    {
+        return 331.3f + 0.606f * temperature_c;
+    }
+
+    // Air temperature steps the echo conversion is cached for, 0.5 °C are 0.1 % of the distance.
+    constexpr float TEMPERATURE_STEP_C = 0.5f;
+
+    // Distance (cm) of the obstacle an ultrasonic echo of `echo_us` round trip came from.
+    constexpr float echoDistanceCm(uint32_t echo_us, float speed_of_sound_m_s = SPEED_OF_SOUND_M_S)
+    {
+        return echo_us * speed_of_sound_m_s / 20000.0f;
+    }
+
+    // Round trip time (µs) of an echo from `distance_cm` away.
+    constexpr uint32_t echoTimeUs(float distance_cm, float speed_of_sound_m_s = SPEED_OF_SOUND_M_S)
+    {
+        return static_cast<uint32_t>(distance_cm * 20000.0f / speed_of_sound_m_s);
+    }
+
+    /**
+     * Converts echo times to distances at the speed of sound of the air
+     * temperature, 20 °C until one is set. The factor is recomputed only
+     * when the temperature moves to another `TEMPERATURE_STEP_C`, so a
+     * conversion is a single multiplication.
+     */
+    class EchoConverter
+    {
+    public:
+        EchoConverter() { setTemperature(20.0f); }
+
+        // Takes the air temperature, NaN (no reading) keeps the previous one.
+        void setTemperature(float temperature_c)
+        {
+            if (std::isnan(temperature_c))
+                return;
+
+            const long step = std::lround(temperature_c / TEMPERATURE_STEP_C);
+            if (step == _step)
+                return;
+            _step = step;
+            _speed_m_s = speedOfSound(step * TEMPERATURE_STEP_C);
+            _cm_per_us = _speed_m_s / 20000.0f;
+        }
+
+        float distanceCm(uint32_t echo_us) const { return echo_us * _cm_per_us; }
+
+        // Speed of sound at the temperature step in use.
+        float speed() const { return _speed_m_s; }
+
+    private:
+        long _step = LONG_MIN;
+        float _speed_m_s = SPEED_OF_SOUND_M_S;
+        float _cm_per_us = SPEED_OF_SOUND_M_S / 20000.0f;
+    };
+
+    /**
+     * Times an ultrasonic echo from the edges of the echo pin, which its
+     * interrupt handler passes to `edge`. The main loop starts a measurement
+     * after the trigger pulse and polls for the result, so neither side ever
+     * waits for the echo. Times are in µs of a free running clock.
+     */
+    class EchoCapture
+    {
+    public:
+        enum class State : uint8_t
+        {
+            // No measurement running
+            Idle,
+            Waiting,
+            // The echo ended, `poll` returned its duration
+            Done,
+            // No complete echo within the timeout
+            Timeout,
+        };
+
+        // The trigger pulse went out at `now_us`.
+        void start(uint32_t now_us)
+        {
+            _start_us = now_us;
+            _edges.store(0, std::memory_order_relaxed);
+            _running.store(true, std::memory_order_release);
+        }
+
+        // An edge of the echo pin to `level` at `now_us`; safe to call from an interrupt handler,
+        // always inlined so that it ends up in the handler's IRAM.
+        __attribute__((always_inline)) inline void edge(bool level, uint32_t now_us)
+        {
+            if (!_running.load(std::memory_order_acquire))
+                return;
+
+            if (level)
+            {
+                _rise_us = now_us;
+                _edges.store(1, std::memory_order_release);
+            }
+            else if (_edges.load(std::memory_order_relaxed) == 1)
+            {
+                _fall_us = now_us;
+                _edges.store(2, std::memory_order_release);
+            }
+        }
+
+        // Whether a measurement is running, until `poll` reported its end.
+        bool running() const { return _running.load(std::memory_order_relaxed); }
+
+        /**
+         * Checks the running measurement. `Done` and `Timeout` are reported
+         * once, after that the capture is idle until the next `start`.
+         *
+         * @param timeout_us longest time from the trigger to the end of the echo
+         * @param echo_us    the duration of the echo pulse when `Done`
+         */
+        State poll(uint32_t now_us, uint32_t timeout_us, uint32_t &echo_us)
+        {
+            if (!_running.load(std::memory_order_relaxed))
+                return State::Idle;
+
+            if (_edges.load(std::memory_order_acquire) == 2)
+            {
+                _running.store(false, std::memory_order_relaxed);
+                echo_us = _fall_us - _rise_us;
+                return State::Done;
+            }
+
+            if (now_us - _start_us > timeout_us)
+            {
+                _running.store(false, std::memory_order_relaxed);
+                return State::Timeout;
+            }
+            return State::Waiting;
+        }
+
+    private:
+        std::atomic<bool> _running{false};
+        std::atomic<uint8_t> _edges{0};
+        uint32_t _start_us = 0;
+        uint32_t _rise_us = 0;
+        uint32_t _fall_us = 0;
+    };
+}
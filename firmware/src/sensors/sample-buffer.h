@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Sensor
+{
+    struct Sample
+    {
+        // Id the sensor got from its `SamplingScheduler`
+        uint8_t sensor;
+        float value;
+        uint32_t sampled_ms; // millis() at sampling
+    };
+
+    /**
+     * Timestamped samples of all sensors, the newest `Capacity` of them; a
+     * full buffer overwrites its oldest sample. Fixed memory, for the main
+     * loop only.
+     */
+    template <size_t Capacity>
+    class SampleBuffer
+    {
+    public:
+        void push(const Sample &sample)
+        {
+            _samples[(_first + _size) % Capacity] = sample;
+            if (_size < Capacity)
+                _size++;
+            else
+                _first = (_first + 1) % Capacity;
+        }
+
+        /**
+         * Copies the values `sensor` sampled at or after `since_ms` to `out`,
+         * oldest first, and returns how many. Stops after `max` values.
+         */
+        size_t values(uint8_t sensor, uint32_t since_ms, float *out, size_t max) const
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < _size && count < max; i++)
+            {
+                const Sample &sample = (*this)[i];
+                if (sample.sensor == sensor && static_cast<int32_t>(sample.sampled_ms - since_ms) >= 0)
+                    out[count++] = sample.value;
+            }
+            return count;
+        }
+
+        // @return false if there is no sample of `sensor`
+        bool latest(uint8_t sensor, Sample &sample) const
+        {
+            for (size_t i = _size; i-- > 0;)
+            {
+                if ((*this)[i].sensor == sensor)
+                {
+                    sample = (*this)[i];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // The `index`-th oldest sample.
+        const Sample &operator[](size_t index) const { return _samples[(_first + index) % Capacity]; }
+        size_t size() const { return _size; }
+        void clear() { _size = 0; }
+
+    private:
+        std::array<Sample, Capacity> _samples;
+        size_t _first = 0;
+        size_t _size = 0;
+    };
+}
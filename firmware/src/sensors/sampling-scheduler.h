@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Sensor
+{
+    // Upper bound of sensors one scheduler samples.
+    constexpr size_t MAX_SCHEDULED_SENSORS = 4;
+
+    // Sensors sharing a bus sample this far apart.
+    constexpr uint32_t BUS_SLOT_MS = 20;
+
+    // Bus of a sensor with pins of its own, it never waits for another sensor.
+    constexpr uint8_t NO_BUS = 0xff;
+
+    struct SamplingPlan
+    {
+        // Background sampling period, 0 samples in bursts only
+        uint32_t period_ms;
+        // Samples taken right before each publish
+        uint8_t burst;
+        uint32_t burst_spacing_ms;
+        uint8_t bus;
+    };
+
+    /**
+     * Decides when each sensor takes a sample, independent of how fast the
+     * main loop spins: every `period_ms`, plus a burst of `burst` samples
+     * ending right before each publish, so a publish carries fresh,
+     * oversampled readings. Sensors on the same bus are phase shifted by
+     * `BUS_SLOT_MS` each, so their samples never start at the same time.
+     * Times are millis(), wrapping around is fine.
+     */
+    class SamplingScheduler
+    {
+    public:
+        // @return the id of the sensor, -1 if `MAX_SCHEDULED_SENSORS` are scheduled already
+        int add(const SamplingPlan &plan, uint32_t now_ms)
+        {
+            if (_count == MAX_SCHEDULED_SENSORS)
+                return -1;
+
+            uint32_t phase_ms = 0;
+            if (plan.bus != NO_BUS)
+            {
+                for (size_t i = 0; i < _count; i++)
+                    phase_ms += _sensors[i].plan.bus == plan.bus ? BUS_SLOT_MS : 0;
+            }
+
+            _sensors[_count] = {plan, phase_ms, now_ms + phase_ms, 0, 0};
+            return static_cast<int>(_count++);
+        }
+
+        // Changes the background period of `sensor`, it is next due one period after its last sample.
+        void setPeriod(int sensor, uint32_t period_ms)
+        {
+            Schedule &schedule = _sensors[sensor];
+            if (schedule.plan.period_ms == period_ms)
+                return;
+            schedule.next_ms += period_ms - schedule.plan.period_ms;
+            schedule.plan.period_ms = period_ms;
+        }
+
+        /**
+         * The next publish is at `publish_ms`: schedules the bursts to end
+         * one spacing before it, or to start right away if that is too late
+         * already. Calling it again for the same publish changes nothing.
+         */
+        void publishAt(uint32_t publish_ms, uint32_t now_ms)
+        {
+            if (_scheduled && publish_ms == _publish_ms)
+                return;
+            _scheduled = true;
+            _publish_ms = publish_ms;
+
+            for (size_t i = 0; i < _count; i++)
+            {
+                Schedule &schedule = _sensors[i];
+                schedule.burst_left = schedule.plan.burst;
+                const uint32_t length_ms = schedule.plan.burst * schedule.plan.burst_spacing_ms;
+                const uint32_t start_ms = publish_ms - length_ms - schedule.phase_ms;
+                schedule.burst_next_ms = reached(now_ms, start_ms) ? now_ms + schedule.phase_ms : start_ms;
+            }
+        }
+
+        // @return a sensor due for a sample, -1 if none is; call until it returns -1
+        int due(uint32_t now_ms)
+        {
+            for (size_t i = 0; i < _count; i++)
+            {
+                Schedule &schedule = _sensors[i];
+                if (schedule.burst_left > 0 && reached(now_ms, schedule.burst_next_ms))
+                {
+                    schedule.burst_left--;
+                    schedule.burst_next_ms += schedule.plan.burst_spacing_ms;
+                    return static_cast<int>(i);
+                }
+
+                if (schedule.plan.period_ms > 0 && reached(now_ms, schedule.next_ms))
+                {
+                    // Skip the periods the loop missed rather than catching up
+                    while (reached(now_ms, schedule.next_ms))
+                        schedule.next_ms += schedule.plan.period_ms;
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        }
+
+        // Milliseconds until a sensor is due, UINT32_MAX if none ever is.
+        uint32_t untilDue(uint32_t now_ms) const
+        {
+            uint32_t until_ms = UINT32_MAX;
+            for (size_t i = 0; i < _count; i++)
+            {
+                const Schedule &schedule = _sensors[i];
+                if (schedule.burst_left > 0)
+                    until_ms = std::min(until_ms, until(now_ms, schedule.burst_next_ms));
+                if (schedule.plan.period_ms > 0)
+                    until_ms = std::min(until_ms, until(now_ms, schedule.next_ms));
+            }
+            return until_ms;
+        }
+
+        // Whether samples of the bursts before the next publish are outstanding.
+        bool bursting() const
+        {
+            for (size_t i = 0; i < _count; i++)
+            {
+                if (_sensors[i].burst_left > 0)
+                    return true;
+            }
+            return false;
+        }
+
+        size_t size() const { return _count; }
+
+    private:
+        struct Schedule
+        {
+            SamplingPlan plan;
+            uint32_t phase_ms;
+            uint32_t next_ms;
+            uint8_t burst_left;
+            uint32_t burst_next_ms;
+        };
+
+        static bool reached(uint32_t now_ms, uint32_t at_ms)
+        {
+            return static_cast<int32_t>(now_ms - at_ms) >= 0;
+        }
+
+        static uint32_t until(uint32_t now_ms, uint32_t at_ms)
+        {
+            return reached(now_ms, at_ms) ? 0 : at_ms - now_ms;
+        }
+
+        std::array<Schedule, MAX_SCHEDULED_SENSORS> _sensors;
+        size_t _count = 0;
+        bool _scheduled = false;
+        uint32_t _publish_ms = 0;
+    };
+}
@@ -1,27 +1,120 @@
 #include <Arduino.h>
 
-// Function to initialize the sensor
+#if FEATURE_SENSOR_DS18B20
+#include <array>
+#include <cmath>
+#include <DallasTemperature.h>
+#include <OneWire.h>
+
+#include "sensor-ds18b20.h"
+#include "temperature-conversion.h"
+
+// Probes read from the bus, the rest is ignored.
+#ifndef DS18B20_MAX_PROBES
+#define DS18B20_MAX_PROBES 3
+#endif
+
+// Resolution until `setResolution` picks another one.
+#ifndef DS18B20_RESOLUTION
+#define DS18B20_RESOLUTION 12
+#endif
+
 namespace Sensor
 {
     namespace DS18B20
     {
-        /**
-         * @brief Do a measurement using the sensor and print the distance in centimeters.
-         *
-         * @return float
-         */
-        float measureDistanceCm()
+        static OneWire oneWire(SENSOR_PIN_DATA);
+        static DallasTemperature dallas(&oneWire);
+
+        static std::array<DeviceAddress, DS18B20_MAX_PROBES> addresses;
+        static std::array<float, DS18B20_MAX_PROBES> temperatures;
+        static size_t probeCount = 0;
+        static uint8_t resolution = DS18B20_RESOLUTION;
+        static TemperatureConversion conversion;
+
+        void setup()
+        {
+            log_i("Setup DS18B20 sensor");
+            dallas.begin();
+            temperatures.fill(NAN);
+
+            // The ROM addresses spare the search on every read
+            const size_t found = dallas.getDeviceCount();
+            for (size_t i = 0; i < found && probeCount < DS18B20_MAX_PROBES; i++)
+            {
+                if (dallas.getAddress(addresses[probeCount], i))
+                    probeCount++;
+            }
+            if (found > DS18B20_MAX_PROBES)
+                log_w("DS18B20:\t%u probes found, reading %u", found, DS18B20_MAX_PROBES);
+            log_i("DS18B20:\t%u probes", probeCount);
+
+            // Conversions run on their own, the loop comes back for the result
+            dallas.setWaitForConversion(false);
+            for (size_t i = 0; i < probeCount; i++)
+                dallas.setResolution(addresses[i], resolution);
+        }
+
+        void setResolution(uint8_t bits)
         {
-            return 5.0;
+            bits = clampResolution(bits);
+            if (bits == resolution)
+                return;
+
+            resolution = bits;
+            for (size_t i = 0; i < probeCount; i++)
+                dallas.setResolution(addresses[i], resolution);
+            log_d("DS18B20:\t%u bit resolution", resolution);
         }
 
-        void setup()
+        void measure()
+        {
+            if (probeCount == 0 || busy())
+                return;
+
+            // Skip ROM, all probes convert at once
+            dallas.requestTemperatures();
+            conversion.start(millis(), resolution);
+        }
+
+        bool busy()
+        {
+            return conversion.running();
+        }
+
+        uint32_t untilDone()
+        {
+            return conversion.untilFinished(millis());
+        }
+
+        bool loop()
         {
-            log_i("DS18B20 sensor");
+            if (!conversion.finished(millis()))
+                return false;
+
+            for (size_t i = 0; i < probeCount; i++)
+            {
+                const float temperature = dallas.getTempC(addresses[i]);
+                temperatures[i] = temperature == DEVICE_DISCONNECTED_C ? NAN : temperature;
+                log_v("DS18B20:\t%u: %.2f °C", i, temperatures[i]);
+            }
+            return true;
+        }
+
+        size_t probes()
+        {
+            return probeCount;
         }
-        void loop()
+
+        float temperatureC(size_t probe)
+        {
+            return probe < probeCount ? temperatures[probe] : NAN;
+        }
+
+        float temperatureC()
         {
-            log_v("DS18B20 sensor");
+            return temperatureC(0);
         }
     } // namespace DS18B20
 } // namespace Sensor
+#endif
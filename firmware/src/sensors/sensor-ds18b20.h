@@ -1,12 +1,31 @@
 #pragma once
 
-// HCSR04 sensor
+#include <cstddef>
+#include <cstdint>
+
+// DS18B20 temperature probes on one 1-Wire bus
 namespace Sensor
 {
     namespace DS18B20
     {
-        float measureDistanceCm();
+        // Finds the probes on the bus and caches their ROM addresses.
         void setup();
-        void loop();
+        // Resolution of all probes in bits, 9 (94 ms per conversion) to 12 (750 ms).
+        void setResolution(uint8_t bits);
+        // Starts a conversion on all probes at once, unless one is running.
+        void measure();
+        // Whether a conversion is running; it finishes on its own, light sleep is fine.
+        bool busy();
+        // Milliseconds until the running conversion is done.
+        uint32_t untilDone();
+        // Reads the probes once their conversion is done; returns true then.
+        bool loop();
+
+        // Number of probes found at setup.
+        size_t probes();
+        // Latest temperature (°C) of `probe`, NaN without a reading.
+        float temperatureC(size_t probe);
+        // Latest temperature (°C) of the first probe, NaN without a reading.
+        float temperatureC();
     } // namespace DS18B20
 } // namespace Sensor
@@ -1,37 +1,98 @@
 #include <Arduino.h>
+#include <esp_timer.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
 
-// Library for HCSR04 sensor
-#include <HCSR04.h>
+#include "echo-capture.h"
+#include "sensor-hcsr04.h"
+
+// The echo starts about 0.5 ms after the trigger, on top of its round trip.
+#define HCSR04_ECHO_DELAY_US 1000
+
+// Coldest air the echo timeout allows for, sound is slowest then.
+#define HCSR04_MIN_TEMPERATURE_C -30.0f
 
 namespace Sensor
 {
     namespace HCSR04
     {
-        // Create the sensor object
-        UltraSonicDistanceSensor distanceSensor(SENSOR_PIN_TRIGGER, SENSOR_PIN_ECHO, SENSOR_MAX_DISTANCE);
-
-        /**
-         * @brief Do a measurement using the sensor and print the distance in centimeters.
-         *
-         * @return float
-         */
+        static EchoCapture capture;
+        static EchoConverter converter;
+        static float distanceCm = -1.0f;
+
+        static constexpr uint32_t timeoutUs()
+        {
+            return echoTimeUs(SENSOR_MAX_DISTANCE, speedOfSound(HCSR04_MIN_TEMPERATURE_C)) + HCSR04_ECHO_DELAY_US;
+        }
+
+        // Timestamps the edges of the echo pulse, the main loop picks the result up. It has to stay in
+        // IRAM: the pin is read from the GPIO registers (gpio_get_level lives in flash), `edge` is inlined.
+        static void IRAM_ATTR onEcho()
+        {
+            capture.edge(gpio_ll_get_level(&GPIO, SENSOR_PIN_ECHO), static_cast<uint32_t>(esp_timer_get_time()));
+        }
+
+        // Sends the 10 µs trigger pulse, the module answers with the echo.
+        static void trigger()
+        {
+            digitalWrite(SENSOR_PIN_TRIGGER, HIGH);
+            delayMicroseconds(10);
+            digitalWrite(SENSOR_PIN_TRIGGER, LOW);
+            capture.start(static_cast<uint32_t>(esp_timer_get_time()));
+        }
+
         float measureDistanceCm()
         {
-            float distance = distanceSensor.measureDistanceCm();
-            return distance;
+            return distanceCm;
         }
 
-        /* @deprecated */
         void setup()
         {
             log_i("Setup HCSR04 sensor");
+            pinMode(SENSOR_PIN_TRIGGER, OUTPUT);
+            digitalWrite(SENSOR_PIN_TRIGGER, LOW);
+            pinMode(SENSOR_PIN_ECHO, INPUT);
+            attachInterrupt(digitalPinToInterrupt(SENSOR_PIN_ECHO), onEcho, CHANGE);
+        }
+
+        void setTemperature(float temperature_c)
+        {
+            converter.setTemperature(temperature_c);
+        }
+
+        void measure()
+        {
+            if (!busy())
+                trigger();
+        }
+
+        bool busy()
+        {
+            return capture.running();
         }
 
-        void loop()
+        bool loop()
         {
-            float distance = measureDistanceCm();
-            // Output float mesurement to serial console with 2 decimal places
-            log_v("HCSR04:\t%.2f cm", distance);
+            uint32_t echo_us;
+            const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+            switch (capture.poll(now_us, timeoutUs(), echo_us))
+            {
+            case EchoCapture::State::Done:
+            {
+                const float distance = converter.distanceCm(echo_us);
+                distanceCm = distance <= SENSOR_MAX_DISTANCE ? distance : -1.0f;
+                log_v("HCSR04:\t%.2f cm", distanceCm);
+                return true;
+            }
+            case EchoCapture::State::Timeout:
+                distanceCm = -1.0f;
+                log_v("HCSR04:\tno echo");
+                return true;
+            case EchoCapture::State::Waiting:
+            case EchoCapture::State::Idle:
+                break;
+            }
+            return false;
         }
     }
 } // namespace Sensor
@@ -1,12 +1,22 @@
 #pragma once
 
+#include <cstdint>
+
 // HCSR04 sensor
 namespace Sensor
 {
     namespace HCSR04
     {
+        // Latest measured distance, -1 if there was no echo within `SENSOR_MAX_DISTANCE`. Never blocks.
         float measureDistanceCm();
         void setup();
-        void loop();
+        // Air temperature (°C) the speed of sound is corrected for, NaN keeps the previous one.
+        void setTemperature(float temperature_c);
+        // Triggers a measurement, unless one is running.
+        void measure();
+        // Whether a measurement is waiting for its echo; light sleep would miss its edges.
+        bool busy();
+        // Collects the echo; returns true when a measurement completed, `measureDistanceCm` has its result.
+        bool loop();
     }
 }
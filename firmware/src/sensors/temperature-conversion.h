@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Sensor
+{
+    // Resolutions of a DS18B20, from 0.5 °C to 0.0625 °C.
+    constexpr uint8_t DS18B20_MIN_RESOLUTION = 9;
+    constexpr uint8_t DS18B20_MAX_RESOLUTION = 12;
+
+    constexpr uint8_t clampResolution(long bits)
+    {
+        return static_cast<uint8_t>(std::min<long>(std::max<long>(bits, DS18B20_MIN_RESOLUTION), DS18B20_MAX_RESOLUTION));
+    }
+
+    // Longest conversion time (ms) of a DS18B20 at `bits`, halving with every bit less than 12.
+    constexpr uint32_t conversionTimeMs(uint8_t bits)
+    {
+        return 750u >> (DS18B20_MAX_RESOLUTION - clampResolution(bits));
+    }
+
+    /**
+     * Tracks a temperature conversion the probes run on their own, so the
+     * main loop comes back once it is done instead of waiting for it.
+     * Times are millis(), wrapping around is fine.
+     */
+    class TemperatureConversion
+    {
+    public:
+        void start(uint32_t now_ms, uint8_t bits)
+        {
+            _started_ms = now_ms;
+            _duration_ms = conversionTimeMs(bits);
+            _running = true;
+        }
+
+        // Whether the conversion is done; true once, after that it is idle until the next `start`.
+        bool finished(uint32_t now_ms)
+        {
+            if (!_running || now_ms - _started_ms < _duration_ms)
+                return false;
+            _running = false;
+            return true;
+        }
+
+        // Milliseconds until the running conversion is done, 0 if none is running.
+        uint32_t untilFinished(uint32_t now_ms) const
+        {
+            const uint32_t elapsed_ms = now_ms - _started_ms;
+            return !_running || elapsed_ms >= _duration_ms ? 0 : _duration_ms - elapsed_ms;
+        }
+
+        bool running() const { return _running; }
+
+    private:
+        bool _running = false;
+        uint32_t _started_ms = 0;
+        uint32_t _duration_ms = 0;
+    };
+}
@@ -0,0 +1,271 @@
+#define DOCTEST_CONFIG_IMPLEMENT // REQUIRED: Enable custom main()
+#include <doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "lora/decoder.h"
+#include "lora/protocol.h"
+#include "lora/schema.h"
+
+using namespace Lora::Protocol;
+
+// A frame using every entry kind the encoder knows about
+static size_t mixedFrame(uint8_t *buffer, size_t capacity, float distance)
+{
+  const DataPoint data_points[] = {
+      {MeasurementType::Distance, ChannelID::_0, distance},
+      {MeasurementType::Boolean, ChannelID::_0, true},
+      {MeasurementType::Boolean, ChannelID::_1, false},
+      {MeasurementType::Float, ChannelID::_3, 0.25f},
+  };
+  const float samples[] = {20.0f, 20.5f, 21.0f};
+
+  Encoder encoder(buffer, capacity);
+  encoder.addControl(ControlCode::Delta);
+  encoder.add(Batch{MeasurementType::Temperature, ChannelID::_1, -2, 60, samples, 3});
+  encoder.enableQuantization();
+  encoder.enableFlags();
+  encoder.add(data_points, 4);
+  REQUIRE_FALSE(encoder.overflowed());
+  return encoder.size();
+}
+
+TEST_SUITE("decoder")
+{
+  TEST_CASE("streams every entry of a frame")
+  {
+    std::array<uint8_t, 64> buffer;
+    const size_t length = mixedFrame(buffer.data(), buffer.size(), 87.3f);
+
+    std::vector<Entry::Kind> kinds;
+    for (const auto &entry : decode(buffer.data(), length))
+    {
+      kinds.push_back(entry.kind);
+      switch (entry.kind)
+      {
+      case Entry::Kind::Batch:
+      {
+        float samples[3];
+        REQUIRE(entry.batch.samples(samples, 3) == 3);
+        CHECK(samples[1] == doctest::Approx(20.5f));
+        break;
+      }
+      case Entry::Kind::DataPoint:
+        if (entry.data_point.measurement_type == MeasurementType::Distance)
+          CHECK(std::get<float>(entry.data_point.value) == doctest::Approx(87.3f).epsilon(0.001));
+        else
+          CHECK(std::get<float>(entry.data_point.value) == 0.25f);
+        break;
+      case Entry::Kind::Flags:
+        CHECK(entry.flags == 0b01);
+        CHECK(entry.highest_flag == ChannelID::_1);
+        break;
+      default:
+        break;
+      }
+    }
+
+    const std::vector<Entry::Kind> expected = {
+        Entry::Kind::Control, Entry::Kind::Batch, Entry::Kind::Control,
+        Entry::Kind::DataPoint, Entry::Kind::Flags, Entry::Kind::DataPoint};
+    CHECK(kinds == expected);
+  }
+
+  TEST_CASE("stops at malformed input")
+  {
+    std::array<uint8_t, 64> buffer;
+    const size_t length = mixedFrame(buffer.data(), buffer.size(), 87.3f);
+
+    // Cutting the frame anywhere but between two entries leaves an invalid tail
+    const size_t boundaries[] = {1, 1 + 9, 1 + 9 + 1, 1 + 9 + 1 + 3, 1 + 9 + 1 + 3 + 2};
+    for (size_t truncated = 1; truncated < length; truncated++)
+    {
+      Entry::Kind last = Entry::Kind::Control;
+      for (const auto &entry : decode(buffer.data(), truncated))
+        last = entry.kind;
+
+      const bool boundary = std::find(std::begin(boundaries), std::end(boundaries), truncated) != std::end(boundaries);
+      CHECK((last == Entry::Kind::Invalid) != boundary);
+    }
+
+    const uint8_t reserved[] = {0xFE};
+    CHECK(decode(reserved, 1).begin()->kind == Entry::Kind::Invalid);
+  }
+
+  TEST_CASE("decodes many frames into columns")
+  {
+    std::vector<std::array<uint8_t, 64>> buffers(3);
+    std::vector<const uint8_t *> frames;
+    std::vector<size_t> lengths;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      frames.push_back(buffers[i].data());
+      lengths.push_back(mixedFrame(buffers[i].data(), buffers[i].size(), 10.0f * i));
+    }
+    lengths[1] -= 2; // corrupt the middle frame
+
+    constexpr size_t capacity = 32;
+    std::array<uint32_t, capacity> frame;
+    std::array<MeasurementType, capacity> type;
+    std::array<ChannelID, capacity> channel;
+    std::array<float, capacity> value;
+    std::array<int32_t, capacity> offset;
+    std::array<uint32_t, capacity> timestamp;
+    const Columns columns{frame.data(), type.data(), channel.data(), value.data(), offset.data(), timestamp.data(), capacity};
+
+    const auto result = decodeFrames(frames.data(), lengths.data(), frames.size(), columns);
+    CHECK(result.invalid_frames == 1);
+    CHECK_FALSE(result.truncated);
+    REQUIRE(result.rows == 2 * 7);
+
+    // Batch samples are dated back from the frame, newest last
+    CHECK(offset[0] == -120);
+    CHECK(offset[2] == 0);
+    CHECK(timestamp[2] == 0);
+    CHECK(frame[7] == 2);
+    CHECK(value[10] == doctest::Approx(20.0f));
+
+    const Columns small{frame.data(), type.data(), channel.data(), value.data(), offset.data(), timestamp.data(), 10};
+    const auto partial = decodeFrames(frames.data(), lengths.data(), frames.size(), small);
+    CHECK(partial.truncated);
+    CHECK(partial.rows == 7);
+  }
+
+  TEST_CASE("dates rows by the frame timestamp")
+  {
+    const float samples[] = {20.0f, 20.5f, 21.0f};
+    std::array<uint8_t, 64> buffer;
+    Encoder encoder(buffer);
+    encoder.addTimestamp(1400000000);
+    encoder.add(Batch{MeasurementType::Temperature, ChannelID::_1, -2, 60, samples, 3});
+    encoder.add(DataPoint{MeasurementType::Distance, ChannelID::_0, 87.0f});
+    encoder.addOffset(300);
+    encoder.add(DataPoint{MeasurementType::Distance, ChannelID::_0, 88.0f});
+    REQUIRE_FALSE(encoder.overflowed());
+    CHECK(encoder.size() == TIMESTAMP_PACKED_SIZE + 9 + 5 + offset_packed_size(300) + 5);
+
+    const uint8_t *frames[] = {buffer.data()};
+    const size_t lengths[] = {encoder.size()};
+    constexpr size_t capacity = 8;
+    std::array<uint32_t, capacity> frame;
+    std::array<MeasurementType, capacity> type;
+    std::array<ChannelID, capacity> channel;
+    std::array<float, capacity> value;
+    std::array<int32_t, capacity> offset;
+    std::array<uint32_t, capacity> timestamp;
+    const Columns columns{frame.data(), type.data(), channel.data(), value.data(), offset.data(), timestamp.data(), capacity};
+
+    REQUIRE(decodeFrames(frames, lengths, 1, columns).rows == 5);
+    CHECK(timestamp[0] == 1400000000);
+    CHECK(timestamp[4] == 1400000000);
+    CHECK(offset[0] == -120);
+    CHECK(offset[3] == 0);
+    CHECK(offset[4] == 300);
+
+    // Both entries must be complete
+    for (size_t truncated : {size_t(2), TIMESTAMP_PACKED_SIZE + 9 + 5 + 1})
+      CHECK(decodeFrames(frames, &truncated, 1, columns).invalid_frames == 1);
+  }
+
+  TEST_CASE("reads config acknowledgements")
+  {
+    std::array<uint8_t, 16> buffer;
+    Encoder encoder(buffer);
+    encoder.addConfigAck(42, ConfigStatus::Applied);
+    encoder.add(DataPoint{MeasurementType::Distance, ChannelID::_0, 87.0f});
+
+    auto entry = decode(buffer.data(), encoder.size()).begin();
+    REQUIRE(entry->kind == Entry::Kind::Control);
+    CHECK(entry->control == ControlCode::ConfigAck);
+    CHECK(entry->config_sequence == 42);
+    CHECK(entry->config_status == ConfigStatus::Applied);
+    CHECK((++entry)->kind == Entry::Kind::DataPoint);
+
+    CHECK(decode(buffer.data(), 2).begin()->kind == Entry::Kind::Invalid);
+  }
+
+  TEST_CASE("reads the link status")
+  {
+    std::array<uint8_t, LINK_STATUS_PACKED_SIZE> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.addLinkStatus({3, 14, -117, -9}));
+
+    const auto entry = decode(buffer.data(), encoder.size()).begin();
+    REQUIRE(entry->control == ControlCode::LinkStatus);
+    CHECK(entry->link_status.dr == 3);
+    CHECK(entry->link_status.tx_power_dbm == 14);
+    CHECK(entry->link_status.rssi_dbm == -117);
+    CHECK(entry->link_status.snr_db == -9);
+
+    encoder.reset();
+    REQUIRE(encoder.addLinkStatus({0, 0, -300, 0}));
+    CHECK(decode(buffer.data(), encoder.size()).begin()->link_status.rssi_dbm == -255);
+  }
+
+  TEST_CASE("schema columns match the encoder")
+  {
+    using Uplink = Schema<
+        Field<MeasurementType::Distance, ChannelID::_0, Encoding::Quantized16>,
+        Field<MeasurementType::Boolean, ChannelID::_0, Encoding::Bool>>;
+
+    constexpr size_t count = 100;
+    std::vector<uint8_t> frames(count * Uplink::size);
+    for (size_t f = 0; f < count; f++)
+      Uplink::pack(frames.data() + f * Uplink::size, 0.5f * f, f % 2 == 0);
+    frames[90 * Uplink::size + 1] = 0x41; // wrong channel
+
+    std::array<float, count> distance;
+    std::array<bool, count> overflow;
+    REQUIRE(Uplink::unpackColumns(frames.data(), count, distance.data(), overflow.data()) == 90);
+    CHECK(distance[89] == doctest::Approx(44.5f));
+    CHECK(overflow[88]);
+    CHECK_FALSE(overflow[89]);
+  }
+
+  TEST_CASE("throughput")
+  {
+    constexpr size_t count = 20000;
+    std::vector<uint8_t> storage(count * 64);
+    std::vector<const uint8_t *> frames(count);
+    std::vector<size_t> lengths(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      frames[i] = storage.data() + i * 64;
+      lengths[i] = mixedFrame(storage.data() + i * 64, 64, 0.1f * (i % 1000));
+    }
+
+    constexpr size_t capacity = count * 7;
+    std::vector<uint32_t> frame(capacity);
+    std::vector<MeasurementType> type(capacity);
+    std::vector<ChannelID> channel(capacity);
+    std::vector<float> value(capacity);
+    std::vector<int32_t> offset(capacity);
+    std::vector<uint32_t> timestamp(capacity);
+    const Columns columns{frame.data(), type.data(), channel.data(), value.data(), offset.data(), timestamp.data(), capacity};
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = decodeFrames(frames.data(), lengths.data(), count, columns);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(result.rows == capacity);
+    MESSAGE("decodeFrames: " << static_cast<uint64_t>(count / elapsed.count()) << " frames/s");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  doctest::Context context;
+
+  // BEGIN:: PLATFORMIO REQUIRED OPTIONS
+  context.setOption("success", true);     // Report successful tests
+  context.setOption("no-exitcode", true); // Do not return non-zero code on failed test case
+  // END:: PLATFORMIO REQUIRED OPTIONS
+
+  // YOUR CUSTOM DOCTEST OPTIONS
+
+  context.applyCommandLine(argc, argv);
+  return context.run();
+}
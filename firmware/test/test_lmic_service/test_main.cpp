@@ -0,0 +1,483 @@
+#define DOCTEST_CONFIG_IMPLEMENT // REQUIRED: Enable custom main()
+#include <doctest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "lora/confirmation-policy.h"
+#include "lora/link-quality.h"
+#include "lora/lmic-service.h"
+#include "lora/session-checkpoint.h"
+#include "lora/session-image.h"
+#include "lora/uplink-scheduler.h"
+
+using namespace Lora::Wan;
+
+// Stands in for LMIC with a simulated millisecond clock. An uplink is a TX
+// job followed by the RX1 and RX2 windows; the TX/RX is pending until the
+// last of them ran.
+class FakeLmic
+{
+public:
+  explicit FakeLmic(uint32_t &now) : _now(now) {}
+
+  uint32_t run()
+  {
+    while (!_jobs.empty() && _jobs.front() <= _now)
+    {
+      late_ms = std::max(late_ms, _now - _jobs.front());
+      _jobs.erase(_jobs.begin());
+    }
+    return _jobs.empty() ? 60000 : _jobs.front() - _now;
+  }
+
+  bool pending() const { return !_jobs.empty(); }
+
+  void send() { _jobs = {_now + 10, _now + 1060, _now + 2060}; }
+
+  uint32_t late_ms = 0;
+
+private:
+  uint32_t &_now;
+  std::vector<uint32_t> _jobs;
+};
+
+// The former Lora::Wan::loop, which delayed until shortly before the next job.
+static uint32_t legacyPoll(FakeLmic &lmic, uint32_t &now)
+{
+  const uint32_t free_ms = lmic.run();
+  if (free_ms < LMIC_JOB_MARGIN_MS)
+    return 0;
+  if (lmic.pending())
+    now += free_ms - LMIC_JOB_MARGIN_MS;
+  return 0;
+}
+
+struct Latency
+{
+  uint32_t sample_late_ms = 0;
+  uint32_t lmic_late_ms = 0;
+  uint32_t sleep_ms = 0;
+};
+
+/**
+ * Runs the main loop for a simulated minute: a sensor is sampled every
+ * 250 ms and an uplink is queued every 10 s. Every pass costs 1 ms and the
+ * loop sleeps until whichever comes first, the next sample or `poll`.
+ */
+template <typename Poll>
+static Latency simulate(uint32_t &now, FakeLmic &lmic, Poll poll)
+{
+  Latency latency;
+  uint32_t next_sample = 0;
+  uint32_t next_uplink = 0;
+
+  while (now < 60000)
+  {
+    const uint32_t lora_ms = poll([&]
+                   {
+                     if (now < next_uplink)
+                       return false;
+                     lmic.send();
+                     next_uplink += 10000;
+                     return true; });
+
+    if (now >= next_sample)
+    {
+      latency.sample_late_ms = std::max(latency.sample_late_ms, now - next_sample);
+      next_sample += 250;
+    }
+
+    now += 1;
+    const uint32_t sleep_ms = std::min(lora_ms, next_sample > now ? next_sample - now : 0);
+    latency.sleep_ms += sleep_ms;
+    now += sleep_ms;
+  }
+
+  latency.lmic_late_ms = lmic.late_ms;
+  return latency;
+}
+
+TEST_SUITE("lmic service")
+{
+  TEST_CASE("keeps the main loop responsive during TX/RX")
+  {
+    uint32_t now = 0;
+    FakeLmic legacy_lmic(now);
+    const Latency before = simulate(now, legacy_lmic, [&](auto idle)
+                    {
+                      if (!legacy_lmic.pending())
+                        idle();
+                      return legacyPoll(legacy_lmic, now); });
+
+    now = 0;
+    FakeLmic lmic(now);
+    LmicService<FakeLmic> service(lmic);
+    const Latency after = simulate(now, lmic, [&](auto idle)
+                   { return service.poll(idle); });
+
+    MESSAGE("delay(): sample latency " << before.sample_late_ms << " ms, LMIC latency " << before.lmic_late_ms << " ms");
+    MESSAGE("poll(): sample latency " << after.sample_late_ms << " ms, LMIC latency " << after.lmic_late_ms << " ms, "
+                     << after.sleep_ms * 100 / 60000 << " % asleep");
+
+    CHECK(before.sample_late_ms > 500);
+    CHECK(after.sample_late_ms <= 1);
+    CHECK(after.lmic_late_ms == 0);
+    CHECK(after.sleep_ms > 50000);
+  }
+
+  TEST_CASE("reports the time until the next job")
+  {
+    uint32_t now = 0;
+    FakeLmic lmic(now);
+    LmicService<FakeLmic> service(lmic);
+
+    CHECK(service.poll([&]
+             { lmic.send(); return true; }) == 0);
+    now = 20;
+    CHECK(service.poll([]
+             { return false; }) == 1060 - 20 - LMIC_JOB_MARGIN_MS);
+    now = 1000;
+    CHECK(service.poll([]
+             { return false; }) == 0);
+  }
+}
+
+TEST_SUITE("session image")
+{
+  TEST_CASE("restores only intact sessions")
+  {
+    CHECK(crc16(reinterpret_cast<const uint8_t *>("123456789"), 9) == 0x29b1);
+
+    const uint8_t state[] = {0x26, 0x01, 0x1b, 0x7a, 0x05, 0x00};
+    SessionImage<16> image{};
+    CHECK_FALSE(image.valid());
+
+    REQUIRE(image.store(state, sizeof(state)));
+    CHECK(image.valid());
+    CHECK(image.length == sizeof(state));
+
+    image.data[4] ^= 1;
+    CHECK_FALSE(image.valid());
+    image.data[4] ^= 1;
+    image.version++;
+    CHECK_FALSE(image.valid());
+
+    uint8_t large[17] = {};
+    CHECK_FALSE(image.store(large, sizeof(large)));
+    CHECK_FALSE(image.valid());
+  }
+}
+
+TEST_SUITE("session checkpoint")
+{
+  TEST_CASE("never reuses an uplink counter")
+  {
+    SessionCheckpoint checkpoint;
+    checkpoint.changed();
+    REQUIRE(checkpoint.due(0));
+    checkpoint.saved(0);
+
+    // Power is lost after 100 uplinks each boot; the restored counter must stay ahead
+    uint32_t saved = 0;
+    uint32_t used = 0;
+    size_t writes = 0;
+    for (int boot = 0; boot < 5; boot++)
+    {
+      uint32_t fcnt_up = SessionCheckpoint::resume(saved);
+      CHECK(fcnt_up > used);
+      checkpoint.changed();
+      for (int uplink = 0; uplink < 100; uplink++, fcnt_up++)
+      {
+        if (checkpoint.due(fcnt_up))
+        {
+          checkpoint.saved(fcnt_up);
+          saved = fcnt_up;
+          writes++;
+        }
+        used = fcnt_up;
+      }
+    }
+    CHECK(writes == 5 * 4);
+  }
+
+  TEST_CASE("is not due for a counter behind the checkpoint")
+  {
+    SessionCheckpoint checkpoint;
+    checkpoint.saved(SessionCheckpoint::resume(1000));
+
+    // A session from RTC memory continues below the counter the flash restore skipped to
+    CHECK_FALSE(checkpoint.due(1001));
+    CHECK_FALSE(checkpoint.due(1000 + 2 * SESSION_CHECKPOINT_INTERVAL - 1));
+    CHECK(checkpoint.due(1000 + 2 * SESSION_CHECKPOINT_INTERVAL));
+  }
+}
+
+TEST_SUITE("confirmation policy")
+{
+  TEST_CASE("confirms critical channels up to the daily cap")
+  {
+    ConfirmationPolicy policy;
+    CHECK_FALSE(policy.confirm(CONFIRMED_PRIORITY - 1, 0));
+
+    for (uint32_t i = 0; i < CONFIRMED_MAX_PER_DAY; i++)
+    {
+      REQUIRE(policy.confirm(CONFIRMED_PRIORITY, i * 60));
+      policy.sent(i * 60);
+    }
+    CHECK_FALSE(policy.confirm(CONFIRMED_PRIORITY, 3600));
+    // A day after the first one
+    CHECK(policy.confirm(CONFIRMED_PRIORITY, 24 * 60 * 60));
+  }
+
+  TEST_CASE("retries with backoff and steps the data rate down")
+  {
+    ConfirmationPolicy policy;
+    policy.sent(0);
+
+    std::vector<uint32_t> backoffs;
+    std::vector<bool> step_downs;
+    while (policy.failed())
+    {
+      // Without jitter, the jitter adds up to as much again
+      backoffs.push_back(policy.backoffMs(0));
+      step_downs.push_back(policy.stepDown());
+      CHECK(policy.backoffMs(12345) >= backoffs.back());
+      CHECK(policy.backoffMs(12345) <= 2 * backoffs.back());
+    }
+
+    CHECK(backoffs.size() == CONFIRMED_MAX_RETRIES);
+    CHECK(backoffs[1] > backoffs[0]);
+    CHECK(backoffs[2] > backoffs[1]);
+    CHECK(std::all_of(backoffs.begin(), backoffs.end(), [](uint32_t b)
+                      { return 2 * b <= CONFIRMED_BACKOFF_MAX_MS; }));
+    CHECK((step_downs == std::vector<bool>{false, true, true}));
+
+    // Gave up, the next confirmed uplink starts over
+    CHECK(policy.failed());
+    CHECK_FALSE(policy.stepDown());
+  }
+}
+
+TEST_SUITE("link quality")
+{
+  TEST_CASE("steps down without downlinks")
+  {
+    LinkQuality link;
+    uint8_t dr = 5;
+    for (uint32_t i = 0; i < 3 * LINK_FALLBACK_UPLINKS; i++)
+    {
+      link.uplink();
+      dr = link.adapt(dr, true);
+    }
+    CHECK(dr == 2);
+
+    link.downlink(-90, 5.0f);
+    link.uplink();
+    CHECK(link.adapt(dr, true) == dr);
+    CHECK(link.uplinksSinceDownlink() == 1);
+  }
+
+  TEST_CASE("leaves the data rate to ADR")
+  {
+    LinkQuality link;
+    uint8_t dr = 5;
+    for (uint32_t i = 0; i < 3 * LINK_FALLBACK_UPLINKS; i++)
+    {
+      link.uplink();
+      dr = link.adapt(dr, false);
+    }
+    // LMIC's ADR backoff steps down on its own, a second step would double it
+    CHECK(dr == 5);
+  }
+
+  TEST_CASE("raises the data rate by the margin")
+  {
+    LinkQuality link;
+    // SF12 needs -20 dB: 10 dB installation margin plus 7 dB leaves two steps
+    for (size_t i = 0; i < LINK_HISTORY; i++)
+      link.downlink(-100, i == 3 ? -3.0f : -8.0f);
+    CHECK(link.rssi() == -100);
+    CHECK(link.snr() == -8.0f);
+    CHECK(link.margin(0) == 17.0f);
+
+    CHECK(link.adapt(0, false) == 0);
+    CHECK(link.adapt(0, true) == 2);
+    // The history was measured at DR0
+    CHECK(link.adapt(2, true) == 2);
+
+    for (size_t i = 0; i < LINK_HISTORY; i++)
+      link.downlink(-40, 20.0f);
+    CHECK(link.adapt(2, true) == LINK_MAX_DR);
+  }
+}
+
+// Stands in for LMIC below the uplink scheduler: an uplink is pending until
+// `complete` reports its outcome.
+struct FakeUplinkLmic
+{
+  uint32_t run() { return 60000; }
+  bool pending() const { return in_flight; }
+  uint32_t millis() const { return now_ms; }
+  uint32_t seconds() const { return now_ms / 1000; }
+  uint32_t random() const { return 0; }
+  uint8_t dr() const { return data_rate; }
+  void setDr(uint8_t next) { data_rate = next; }
+  int8_t txPower() const { return 14; }
+  void requestNetworkTime() { time_requests++; }
+
+  void send(const uint8_t *frame, size_t size, bool confirmed)
+  {
+    frames.emplace_back(frame, frame + size);
+    in_flight = true;
+    last_confirmed = confirmed;
+  }
+
+  uint32_t now_ms = 0;
+  uint8_t data_rate = 5;
+  bool in_flight = false;
+  bool last_confirmed = false;
+  uint32_t time_requests = 0;
+  std::vector<std::vector<uint8_t>> frames;
+};
+
+using FakeScheduler = UplinkScheduler<FakeUplinkLmic>;
+
+// Completes the uplink in flight, `acknowledged` by a downlink if asked to.
+static void complete(FakeUplinkLmic &lmic, FakeScheduler &uplinks, bool acknowledged = false)
+{
+  lmic.in_flight = false;
+  uplinks.txComplete(acknowledged, acknowledged, -90, 5.0f);
+}
+
+TEST_SUITE("uplink scheduler")
+{
+  TEST_CASE("sends no keyframe after a rebuild with the memory kept")
+  {
+    const Lora::Protocol::DataPoint data_points[] = {
+        {Lora::Protocol::MeasurementType::Distance, Lora::Protocol::ChannelID::_0, 80.0f},
+        {Lora::Protocol::MeasurementType::Temperature, Lora::Protocol::ChannelID::_0, 12.5f},
+    };
+    FakeUplinkLmic lmic;
+    UplinkMemory memory;
+    const UplinkSettings settings;
+    NoSpill spill;
+
+    {
+      FakeScheduler uplinks(lmic, memory, settings, spill);
+      uplinks.configure(1.0f, 20, 0);
+      uplinks.publish(data_points, 2, lmic.now_ms);
+      REQUIRE(lmic.frames.size() == 1);
+      complete(lmic, uplinks);
+    }
+
+    // Deep sleep: the scheduler starts over, its memory does not
+    lmic.now_ms = 0;
+    FakeScheduler uplinks(lmic, memory, settings, spill);
+    uplinks.configure(1.0f, 20, 0);
+    uplinks.publish(data_points, 2, lmic.now_ms);
+    CHECK(lmic.frames.size() == 1);
+
+    const Lora::Protocol::DataPoint moved[] = {
+        {Lora::Protocol::MeasurementType::Distance, Lora::Protocol::ChannelID::_0, 90.0f},
+        data_points[1],
+    };
+    uplinks.publish(moved, 2, lmic.now_ms);
+    REQUIRE(lmic.frames.size() == 2);
+    CHECK(lmic.frames[1].size() < lmic.frames[0].size());
+    CHECK(uplinks.idle());
+  }
+
+  TEST_CASE("retries a confirmed uplink until it is acknowledged")
+  {
+    const Lora::Protocol::DataPoint alarm[] = {
+        {Lora::Protocol::MeasurementType::Boolean, Lora::Protocol::ChannelID::_0, 1.0f},
+    };
+    FakeUplinkLmic lmic;
+    UplinkMemory memory;
+    const UplinkSettings settings;
+    NoSpill spill;
+    FakeScheduler uplinks(lmic, memory, settings, spill);
+
+    uplinks.publish(alarm, 1, lmic.now_ms);
+    REQUIRE(lmic.frames.size() == 1);
+    CHECK(lmic.last_confirmed);
+    complete(lmic, uplinks);
+    CHECK_FALSE(uplinks.idle());
+
+    // Nothing goes out before the backoff passed
+    CHECK_FALSE(uplinks.sendNext());
+    // Half the backoff without jitter
+    CHECK(uplinks.dueMs(60000) == CONFIRMED_BACKOFF_MS / 2);
+    lmic.now_ms += CONFIRMED_BACKOFF_MS / 2;
+    REQUIRE(uplinks.sendNext());
+    CHECK(lmic.frames[1] == lmic.frames[0]);
+
+    complete(lmic, uplinks, true);
+    CHECK(uplinks.idle());
+    CHECK(uplinks.confirmedFailed() == 0);
+  }
+
+  TEST_CASE("holds uplinks back beyond the airtime budget")
+  {
+    const Lora::Protocol::DataPoint data_point[] = {
+        {Lora::Protocol::MeasurementType::Temperature, Lora::Protocol::ChannelID::_0, 12.5f},
+    };
+    FakeUplinkLmic lmic;
+    lmic.data_rate = 0;
+    UplinkMemory memory;
+    const UplinkSettings settings;
+    NoSpill spill;
+    FakeScheduler uplinks(lmic, memory, settings, spill);
+    uplinks.configure(NAN, 20, 2500);
+
+    uplinks.publish(data_point, 1, lmic.now_ms);
+    REQUIRE(lmic.frames.size() == 1);
+    complete(lmic, uplinks);
+    // Stretched so that a day of such uplinks fits the budget
+    CHECK(uplinks.minPublishIntervalMs() > 12UL * 60 * 60 * 1000);
+
+    // A second SF12 uplink exceeds the 2.5 s of airtime a day
+    lmic.now_ms += 60 * 60 * 1000;
+    uplinks.publish(data_point, 1, lmic.now_ms);
+    CHECK(lmic.frames.size() == 1);
+    CHECK(uplinks.queueDepth() == 1);
+  }
+
+  TEST_CASE("waits for the airtime budget before retrying")
+  {
+    const Lora::Protocol::DataPoint alarm[] = {
+        {Lora::Protocol::MeasurementType::Boolean, Lora::Protocol::ChannelID::_0, 1.0f},
+    };
+    FakeUplinkLmic lmic;
+    lmic.data_rate = 0;
+    UplinkMemory memory;
+    const UplinkSettings settings;
+    NoSpill spill;
+    FakeScheduler uplinks(lmic, memory, settings, spill);
+    uplinks.configure(NAN, 20, 2000);
+
+    uplinks.publish(alarm, 1, lmic.now_ms);
+    REQUIRE(lmic.frames.size() == 1);
+    complete(lmic, uplinks);
+
+    lmic.now_ms += CONFIRMED_BACKOFF_MS;
+    CHECK_FALSE(uplinks.sendNext());
+    CHECK(uplinks.dueMs(60000) == AIRTIME_RECHECK_MS);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  doctest::Context context;
+
+  // BEGIN:: PLATFORMIO REQUIRED OPTIONS
+  context.setOption("success", true);     // Report successful tests
+  context.setOption("no-exitcode", true); // Do not return non-zero code on failed test case
+  // END:: PLATFORMIO REQUIRED OPTIONS
+
+  // YOUR CUSTOM DOCTEST OPTIONS
+
+  context.applyCommandLine(argc, argv);
+  return context.run();
+}
@@ -0,0 +1,901 @@
+#define DOCTEST_CONFIG_IMPLEMENT // REQUIRED: Enable custom main()
+#include <doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "lora/airtime.h"
+#include "lora/batcher.h"
+#include "lora/change-tracker.h"
+#include "lora/config-downlink.h"
+#include "lora/decoder.h"
+#include "lora/frame-planner.h"
+#include "lora/network-clock.h"
+#include "lora/protocol.h"
+#include "lora/quantization.h"
+#include "lora/sample-ring.h"
+#include "lora/schema.h"
+#include "lora/uplink-queue.h"
+#include "lora/varint.h"
+
+using namespace Lora::Protocol;
+
+// A slowly draining barrel, distance in cm sampled once a minute with some ripple noise.
+static std::array<float, 60> distanceTrace()
+{
+  std::array<float, 60> trace;
+  for (size_t i = 0; i < trace.size(); i++)
+    trace[i] = 42.0f + 0.05f * i + ((i % 3) == 0 ? 0.2f : -0.1f);
+  return trace;
+}
+
+TEST_SUITE("varint")
+{
+  TEST_CASE("zig-zag maps small magnitudes to small values")
+  {
+    CHECK(Varint::zigzag(0) == 0);
+    CHECK(Varint::zigzag(-1) == 1);
+    CHECK(Varint::zigzag(1) == 2);
+    CHECK(Varint::zigzag(-2) == 3);
+    CHECK(Varint::unzigzag(Varint::zigzag(INT64_MIN)) == INT64_MIN);
+    CHECK(Varint::unzigzag(Varint::zigzag(INT64_MAX)) == INT64_MAX);
+  }
+
+  TEST_CASE("round-trips across byte boundaries")
+  {
+    for (uint64_t value : std::initializer_list<uint64_t>{0, 127, 128, 16383, 16384, UINT64_MAX})
+    {
+      uint8_t buffer[Varint::MAX_SIZE];
+      const size_t written = Varint::write(value, buffer);
+      CHECK(written == Varint::size(value));
+
+      uint64_t read;
+      CHECK(Varint::read(buffer, written, read) == written);
+      CHECK(read == value);
+    }
+  }
+
+  TEST_CASE("rejects truncated input")
+  {
+    const uint8_t truncated[] = {0x80, 0x80};
+    uint64_t value;
+    CHECK(Varint::read(truncated, sizeof(truncated), value) == 0);
+  }
+}
+
+TEST_SUITE("batch")
+{
+  TEST_CASE("round-trips a recorded trace")
+  {
+    const auto trace = distanceTrace();
+    const Batch batch{MeasurementType::Distance, ChannelID::_2, -1, 60, trace.data(), static_cast<uint8_t>(trace.size())};
+
+    std::array<uint8_t, MAX_PAYLOAD_SIZE> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.add(batch));
+    CHECK(encoder.size() == packed_size(batch));
+
+    DecodedBatch decoded;
+    REQUIRE(decodeBatch(encoder.data(), encoder.size(), decoded) == encoder.size());
+    CHECK(decoded.measurement_type == MeasurementType::Distance);
+    CHECK(decoded.channel_id == ChannelID::_2);
+    CHECK(decoded.scale == -1);
+    CHECK(decoded.period_s == 60);
+    REQUIRE(decoded.count == trace.size());
+    for (size_t i = 0; i < trace.size(); i++)
+      CHECK(decoded.samples[i] == doctest::Approx(trace[i]).epsilon(0.002));
+
+    const float raw = trace.size() * packed_size(DataPoint{MeasurementType::Distance, ChannelID::_2, 0.0f});
+    MESSAGE("batch bytes/sample: " << static_cast<float>(encoder.size()) / trace.size()
+                                   << " (single datapoints: " << raw / trace.size() << ")");
+    CHECK(encoder.size() < raw / 3);
+  }
+
+  TEST_CASE("handles negative deltas and large jumps")
+  {
+    const float samples[] = {-12.5f, 30000.0f, -30000.0f, 0.0f};
+    const Batch batch{MeasurementType::Temperature, ChannelID::_0, -2, 1, samples, 4};
+
+    std::array<uint8_t, 64> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.add(batch));
+
+    DecodedBatch decoded;
+    REQUIRE(decodeBatch(encoder.data(), encoder.size(), decoded) == encoder.size());
+    for (size_t i = 0; i < 4; i++)
+      CHECK(decoded.samples[i] == doctest::Approx(samples[i]));
+  }
+
+  TEST_CASE("rejects invalid batches")
+  {
+    const float samples[] = {1.0f};
+    std::array<uint8_t, 64> buffer;
+    Encoder encoder(buffer);
+
+    CHECK_FALSE(encoder.add(Batch{MeasurementType::Boolean, ChannelID::_0, 0, 1, samples, 1}));
+    CHECK_FALSE(encoder.add(Batch{MeasurementType::Distance, ChannelID::_0, 0, 1, samples, 0}));
+    CHECK(encoder.size() == 0);
+    CHECK_FALSE(encoder.overflowed());
+  }
+
+  TEST_CASE("reports overflow without writing")
+  {
+    const auto trace = distanceTrace();
+    const Batch batch{MeasurementType::Distance, ChannelID::_0, -1, 60, trace.data(), static_cast<uint8_t>(trace.size())};
+
+    std::array<uint8_t, 16> buffer;
+    Encoder encoder(buffer);
+    CHECK_FALSE(encoder.add(batch));
+    CHECK(encoder.overflowed());
+    CHECK(encoder.size() == 0);
+  }
+
+  TEST_CASE("rejects truncated frames")
+  {
+    const float samples[] = {1.0f, 2.0f, 3.0f};
+    const Batch batch{MeasurementType::Distance, ChannelID::_0, -1, 60, samples, 3};
+
+    std::array<uint8_t, 32> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.add(batch));
+
+    DecodedBatch decoded;
+    for (size_t length = 0; length < encoder.size(); length++)
+      CHECK(decodeBatch(encoder.data(), length, decoded) == 0);
+  }
+
+  TEST_CASE("batcher keeps the most recent samples")
+  {
+    Batcher<2> batcher;
+    for (size_t i = 0; i < MAX_BATCH_SAMPLES + 3; i++)
+    {
+      const DataPoint data_points[] = {
+          {MeasurementType::Distance, ChannelID::_0, static_cast<float>(i)},
+          {MeasurementType::Boolean, ChannelID::_0, true},
+      };
+      batcher.add(data_points, 2);
+    }
+
+    Batch batches[2];
+    REQUIRE(batcher.batches(batches, 30) == 1);
+    CHECK(batches[0].count == MAX_BATCH_SAMPLES);
+    CHECK(batches[0].period_s == 30);
+    CHECK(batches[0].samples[0] == 3.0f);
+    CHECK(batches[0].samples[MAX_BATCH_SAMPLES - 1] == static_cast<float>(MAX_BATCH_SAMPLES + 2));
+
+    batcher.clear();
+    CHECK(batcher.batches(batches, 30) == 0);
+  }
+
+  TEST_CASE("batcher keys channels by type and channel")
+  {
+    Batcher<3> batcher;
+    const DataPoint first[] = {
+        {MeasurementType::Distance, ChannelID::_0, 80.0f},
+        {MeasurementType::Temperature, ChannelID::_1, 20.0f},
+    };
+    const DataPoint reordered[] = {
+        {MeasurementType::Temperature, ChannelID::_1, 21.0f},
+        {MeasurementType::Distance, ChannelID::_0, 81.0f},
+    };
+    batcher.add(first, 2);
+    batcher.add(reordered, 2);
+
+    Batch batches[3];
+    REQUIRE(batcher.batches(batches, 60) == 2);
+    CHECK(batches[0].measurement_type == MeasurementType::Distance);
+    CHECK(batches[0].samples[0] == 80.0f);
+    CHECK(batches[0].samples[1] == 81.0f);
+    CHECK(batches[1].measurement_type == MeasurementType::Temperature);
+    CHECK(batches[1].channel_id == ChannelID::_1);
+    CHECK(batches[1].samples[0] == 20.0f);
+    CHECK(batches[1].samples[1] == 21.0f);
+  }
+
+  TEST_CASE("batcher restarts a channel after a gap or NaN")
+  {
+    Batcher<3> batcher;
+    const DataPoint both[] = {
+        {MeasurementType::Temperature, ChannelID::_1, 20.0f},
+        {MeasurementType::Temperature, ChannelID::_2, 10.0f},
+    };
+    const DataPoint missing[] = {{MeasurementType::Temperature, ChannelID::_2, 11.0f}};
+    const DataPoint disconnected[] = {
+        {MeasurementType::Temperature, ChannelID::_1, 21.0f},
+        {MeasurementType::Temperature, ChannelID::_2, NAN},
+    };
+
+    batcher.add(both, 2);
+    batcher.add(missing, 1);
+    batcher.add(disconnected, 2);
+    batcher.add(both, 2);
+
+    Batch batches[3];
+    REQUIRE(batcher.batches(batches, 60) == 2);
+    CHECK(batches[0].channel_id == ChannelID::_1);
+    REQUIRE(batches[0].count == 2);
+    CHECK(batches[0].samples[0] == 21.0f);
+    CHECK(batches[1].channel_id == ChannelID::_2);
+    REQUIRE(batches[1].count == 1);
+    CHECK(batches[1].samples[0] == 10.0f);
+
+    // A channel without the most recent sample has no batch
+    batcher.add(missing, 1);
+    CHECK(batcher.batches(batches, 60) == 1);
+    CHECK(batches[0].channel_id == ChannelID::_2);
+  }
+
+  TEST_CASE("rejects batches holding NaN")
+  {
+    const float samples[] = {20.0f, NAN, 21.0f};
+    const Batch batch{MeasurementType::Temperature, ChannelID::_0, -2, 60, samples, 3};
+    CHECK(packed_size(batch) == 0);
+
+    std::array<uint8_t, 32> buffer;
+    Encoder encoder(buffer);
+    CHECK_FALSE(encoder.add(batch));
+    CHECK(encoder.size() == 0);
+    CHECK_FALSE(encoder.overflowed());
+  }
+}
+
+TEST_SUITE("quantization")
+{
+  TEST_CASE("round-trips within half a step")
+  {
+    const DataPoint data_points[] = {
+        {MeasurementType::Distance, ChannelID::_0, 123.45f},
+        {MeasurementType::Temperature, ChannelID::_0, -12.345f},
+        {MeasurementType::Voltage, ChannelID::_0, 3.7012f},
+        {MeasurementType::Boolean, ChannelID::_0, true},
+        {MeasurementType::Float, ChannelID::_1, 1.0e9f},
+    };
+
+    std::array<uint8_t, 64> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.enableQuantization());
+    REQUIRE(encoder.add(data_points, 5));
+    CHECK(encoder.size() == 1 + 3 * 3 + 2 + 5);
+
+    size_t offset = 1;
+    for (const auto &expected : data_points)
+    {
+      DataPoint decoded;
+      const size_t consumed = decodeDataPoint(encoder.data() + offset, encoder.size() - offset, true, decoded);
+      REQUIRE(consumed > 0);
+      offset += consumed;
+
+      CHECK(decoded.measurement_type == expected.measurement_type);
+      CHECK(decoded.channel_id == expected.channel_id);
+      if (const float *value = std::get_if<float>(&expected.value))
+        CHECK(std::fabs(std::get<float>(decoded.value) - *value) <= quantization(expected.measurement_type).step / 2 + 1e-4f);
+      else
+        CHECK(std::get<bool>(decoded.value) == std::get<bool>(expected.value));
+    }
+    CHECK(offset == encoder.size());
+  }
+
+  TEST_CASE("marks out of range readings as invalid")
+  {
+    const Quantization q = quantization(MeasurementType::Distance);
+    CHECK(quantize(q, -1.0f) == Quantization::QUANTIZED_INVALID);
+    CHECK(quantize(q, NAN) == Quantization::QUANTIZED_INVALID);
+    CHECK(quantize(q, q.max()) == Quantization::QUANTIZED_INVALID - 1);
+    CHECK(std::isnan(dequantize(q, Quantization::QUANTIZED_INVALID)));
+  }
+
+  TEST_CASE("shrinks a typical frame by about 40%")
+  {
+    const DataPoint data_points[] = {
+        {MeasurementType::Distance, ChannelID::_0, 87.3f},
+        {MeasurementType::Temperature, ChannelID::_0, 18.25f},
+        {MeasurementType::Voltage, ChannelID::_0, 3.91f},
+        {MeasurementType::Humidity, ChannelID::_0, 64.2f},
+    };
+
+    std::array<uint8_t, 64> raw_buffer, quantized_buffer;
+    Encoder raw(raw_buffer), quantized(quantized_buffer);
+    REQUIRE(raw.add(data_points, 4));
+    REQUIRE(quantized.enableQuantization());
+    REQUIRE(quantized.add(data_points, 4));
+
+    MESSAGE("raw " << raw.size() << " bytes, quantized " << quantized.size() << " bytes");
+    CHECK(quantized.size() * 10 <= raw.size() * 7);
+  }
+
+  TEST_CASE("schema is bit-exact with the encoder")
+  {
+    using Uplink = Schema<
+        Field<MeasurementType::Distance, ChannelID::_0, Encoding::Quantized16>,
+        Field<MeasurementType::Boolean, ChannelID::_1, Encoding::Bool>,
+        Field<MeasurementType::Float, ChannelID::_2, Encoding::Float32>>;
+    static_assert(Uplink::size == 1 + 3 + 2 + 5);
+
+    const DataPoint data_points[] = {
+        {MeasurementType::Distance, ChannelID::_0, 42.1f},
+        {MeasurementType::Boolean, ChannelID::_1, true},
+        {MeasurementType::Float, ChannelID::_2, 0.5f},
+    };
+    std::array<uint8_t, 64> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.enableQuantization());
+    REQUIRE(encoder.add(data_points, 3));
+
+    const auto frame = Uplink::pack(42.1f, true, 0.5f);
+    REQUIRE(encoder.size() == frame.size());
+    CHECK(std::equal(frame.begin(), frame.end(), encoder.data()));
+
+    Uplink::Values values;
+    REQUIRE(Uplink::unpack(frame.data(), frame.size(), values));
+    CHECK(std::get<0>(values) == doctest::Approx(42.1f).epsilon(0.001));
+    CHECK(std::get<1>(values));
+    CHECK(std::get<2>(values) == 0.5f);
+  }
+}
+
+TEST_SUITE("flags")
+{
+  TEST_CASE("folds contiguous boolean channels into one entry")
+  {
+    const DataPoint data_points[] = {
+        {MeasurementType::Boolean, ChannelID::_0, true},  // overflow
+        {MeasurementType::Distance, ChannelID::_0, 1.0f},
+        {MeasurementType::Boolean, ChannelID::_2, true},  // pump running
+        {MeasurementType::Boolean, ChannelID::_1, false}, // lid open
+    };
+
+    std::array<uint8_t, 16> buffer;
+    Encoder encoder(buffer);
+    encoder.enableFlags();
+    REQUIRE(encoder.add(data_points, 4));
+    REQUIRE(encoder.size() == 2 + 5);
+    CHECK(encoder.data()[0] == 0xC2);
+    CHECK(encoder.data()[1] == 0b101);
+    CHECK(encoder.data()[2] == 0x40);
+
+    uint16_t values;
+    ChannelID highest;
+    CHECK(decodeFlags(encoder.data(), encoder.size(), values, highest) == 2);
+    CHECK(values == 0b101);
+    CHECK(highest == ChannelID::_2);
+  }
+
+  TEST_CASE("keeps booleans as datapoints unless enabled")
+  {
+    const std::vector<DataPoint> data_points = {
+        {MeasurementType::Boolean, ChannelID::_0, true},
+        {MeasurementType::Boolean, ChannelID::_1, false},
+    };
+
+    const auto packed = packDataPoints(data_points);
+    REQUIRE(packed.size() == calculate_packed_bytes(data_points));
+    CHECK((packed == std::vector<uint8_t>{0x00, 0x01, 0x01, 0x00}));
+
+    using Uplink = Schema<
+        Field<MeasurementType::Boolean, ChannelID::_0, Encoding::Bool>,
+        Field<MeasurementType::Boolean, ChannelID::_1, Encoding::Bool>>;
+    const auto frame = Uplink::pack(true, false);
+    std::array<uint8_t, 16> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.add(data_points.data(), data_points.size()));
+    REQUIRE(encoder.size() == frame.size());
+    CHECK(std::equal(frame.begin(), frame.end(), encoder.data()));
+  }
+
+  TEST_CASE("uses two bitmap bytes above channel 7")
+  {
+    std::array<uint8_t, 8> buffer;
+    Encoder encoder(buffer);
+    REQUIRE(encoder.addFlags(0xffff, ChannelID::_9));
+    REQUIRE(encoder.size() == 3);
+    CHECK(encoder.data()[0] == 0xC9);
+
+    uint16_t values;
+    ChannelID highest;
+    CHECK(decodeFlags(encoder.data(), encoder.size(), values, highest) == 3);
+    CHECK(values == 0x03ff);
+    CHECK(highest == ChannelID::_9);
+    CHECK(decodeFlags(encoder.data(), 2, values, highest) == 0);
+  }
+
+  TEST_CASE("keeps sparse or duplicate booleans as single datapoints")
+  {
+    std::array<uint8_t, 16> buffer;
+    Encoder encoder(buffer);
+    encoder.enableFlags();
+
+    const DataPoint sparse[] = {
+        {MeasurementType::Boolean, ChannelID::_0, true},
+        {MeasurementType::Boolean, ChannelID::_3, true},
+    };
+    REQUIRE(encoder.add(sparse, 2));
+    CHECK(encoder.size() == 4);
+
+    const DataPoint duplicate[] = {
+        {MeasurementType::Boolean, ChannelID::_0, true},
+        {MeasurementType::Boolean, ChannelID::_1, true},
+        {MeasurementType::Boolean, ChannelID::_1, false},
+    };
+    encoder.reset();
+    REQUIRE(encoder.add(duplicate, 3));
+    CHECK(encoder.size() == 6);
+
+    const DataPoint single[] = {{MeasurementType::Boolean, ChannelID::_0, true}};
+    encoder.reset();
+    REQUIRE(encoder.add(single, 1));
+    CHECK(encoder.size() == 2);
+  }
+
+}
+
+TEST_SUITE("change tracker")
+{
+  TEST_CASE("sends only channels outside the deadband")
+  {
+    ChangeTracker tracker;
+    tracker.configure(0.5f, 4);
+
+    DataPoint data_points[] = {
+        {MeasurementType::Distance, ChannelID::_0, 80.0f},
+        {MeasurementType::Temperature, ChannelID::_0, 12.0f},
+        {MeasurementType::Boolean, ChannelID::_0, false},
+    };
+    DataPoint selected[3];
+    bool keyframe;
+
+    // Nothing acknowledged yet, so the first frame is a keyframe
+    CHECK(tracker.select(data_points, 3, selected, keyframe) == 3);
+    CHECK(keyframe);
+    tracker.sent(1);
+    tracker.acknowledge(1);
+
+    data_points[0].value = 80.4f;
+    CHECK(tracker.select(data_points, 3, selected, keyframe) == 0);
+    CHECK_FALSE(keyframe);
+
+    data_points[0].value = 80.6f;
+    data_points[2].value = true;
+    REQUIRE(tracker.select(data_points, 3, selected, keyframe) == 2);
+    CHECK_FALSE(keyframe);
+    CHECK(selected[0].measurement_type == MeasurementType::Distance);
+    CHECK(selected[1].measurement_type == MeasurementType::Boolean);
+  }
+
+  TEST_CASE("compares against the last acknowledged frame only")
+  {
+    ChangeTracker tracker;
+    tracker.configure(0.5f, 0);
+
+    DataPoint data_point{MeasurementType::Distance, ChannelID::_0, 10.0f};
+    DataPoint selected;
+    bool keyframe;
+
+    tracker.select(&data_point, 1, &selected, keyframe);
+    tracker.sent(1);
+    tracker.acknowledge(1);
+
+    // Never acknowledged, so the next frame still compares against 10.0
+    data_point.value = 11.0f;
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 1);
+    data_point.value = 10.2f;
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 0);
+  }
+
+  TEST_CASE("sends a keyframe every interval and after invalidation")
+  {
+    ChangeTracker tracker;
+    tracker.configure(1.0f, 3);
+
+    const DataPoint data_point{MeasurementType::Distance, ChannelID::_0, 10.0f};
+    DataPoint selected;
+    bool keyframe;
+
+    const bool expected[] = {true, false, false, true, false, false, true};
+    uint32_t frame = 0;
+    for (bool expected_keyframe : expected)
+    {
+      tracker.select(&data_point, 1, &selected, keyframe);
+      CHECK(keyframe == expected_keyframe);
+      tracker.sent(++frame);
+      tracker.acknowledge(frame);
+    }
+
+    tracker.invalidate();
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 1);
+    CHECK(keyframe);
+  }
+
+  TEST_CASE("acknowledges only the frame carrying the selection")
+  {
+    ChangeTracker tracker;
+    tracker.configure(0.5f, 0);
+
+    DataPoint data_point{MeasurementType::Distance, ChannelID::_0, 10.0f};
+    DataPoint selected;
+    bool keyframe;
+
+    // Completed before the selection went out, e.g. the join trigger or a batch
+    tracker.select(&data_point, 1, &selected, keyframe);
+    tracker.acknowledge(1);
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 1);
+    CHECK(keyframe);
+
+    // Another frame completing while the selection is in flight
+    tracker.sent(3);
+    tracker.acknowledge(2);
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 1);
+    CHECK(keyframe);
+
+    tracker.sent(4);
+    tracker.acknowledge(4);
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 0);
+    CHECK_FALSE(keyframe);
+
+    // A later frame delivering does not acknowledge a selection twice
+    data_point.value = 11.0f;
+    tracker.select(&data_point, 1, &selected, keyframe);
+    tracker.acknowledge(4);
+    data_point.value = 10.2f;
+    CHECK(tracker.select(&data_point, 1, &selected, keyframe) == 0);
+  }
+}
+
+TEST_SUITE("frame planner")
+{
+  // 30 channels of a busy station: 10 flags, 12 levels and 8 other readings
+  static std::array<DataPoint, 30> station()
+  {
+    std::array<DataPoint, 30> data_points;
+    for (size_t i = 0; i < data_points.size(); i++)
+    {
+      const auto channel = static_cast<ChannelID>(i % 16);
+      if (i < 8)
+        data_points[i] = {MeasurementType::Temperature, channel, 10.0f + i};
+      else if (i < 20)
+        data_points[i] = {MeasurementType::Distance, channel, 50.0f + i};
+      else
+        data_points[i] = {MeasurementType::Boolean, channel, (i % 2) == 0};
+    }
+    return data_points;
+  }
+
+  TEST_CASE("every frame fits the limit of every data rate")
+  {
+    const auto data_points = station();
+    std::array<uint8_t, 30> priorities;
+    for (size_t i = 0; i < data_points.size(); i++)
+      priorities[i] = defaultPriority(data_points[i].measurement_type);
+
+    for (uint8_t dr = 0; dr < EU868_MAX_PAYLOAD_SIZE.size(); dr++)
+    {
+      for (bool quantized : {false, true})
+      {
+        const size_t limit = maxPayloadSize(dr);
+        const size_t overhead = quantized ? 1 : 0;
+
+        FramePlanner planner;
+        const size_t frames = planner.plan(data_points.data(), priorities.data(), data_points.size(), limit, overhead, quantized);
+        REQUIRE(frames > 0);
+
+        size_t total_bytes = 0, total_points = 0;
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+          std::array<DataPoint, 30> selected;
+          const size_t count = planner.collect(data_points.data(), frame, selected.data());
+          CHECK(count > 0);
+          total_points += count;
+
+          std::array<uint8_t, MAX_PAYLOAD_SIZE> buffer;
+          Encoder encoder(buffer.data(), limit);
+          if (quantized)
+            REQUIRE(encoder.enableQuantization());
+          CHECK(encoder.add(selected.data(), count));
+          total_bytes += encoder.size();
+        }
+        CHECK(total_points == data_points.size());
+
+        // No frame could have been saved: the data does not fit into one frame less
+        CHECK((frames - 1) * limit < total_bytes);
+        MESSAGE("DR" << int(dr) << (quantized ? " quantized" : "") << ": " << frames << " frame(s) for " << total_bytes << " bytes");
+      }
+    }
+  }
+
+  TEST_CASE("puts the highest priorities into the first frame")
+  {
+    const auto data_points = station();
+    std::array<uint8_t, 30> priorities;
+    for (size_t i = 0; i < data_points.size(); i++)
+      priorities[i] = defaultPriority(data_points[i].measurement_type);
+
+    FramePlanner planner;
+    REQUIRE(planner.plan(data_points.data(), priorities.data(), data_points.size(), maxPayloadSize(0), 0, false) > 1);
+
+    for (size_t i = 0; i < data_points.size(); i++)
+    {
+      if (data_points[i].measurement_type == MeasurementType::Boolean)
+        CHECK(planner.frameOf(i) == 0);
+      if (data_points[i].measurement_type == MeasurementType::Temperature)
+        CHECK(planner.frameOf(i) > 0);
+    }
+  }
+
+  TEST_CASE("rejects datapoints larger than a frame")
+  {
+    const DataPoint data_point{MeasurementType::Distance, ChannelID::_0, 1.0f};
+    const uint8_t priority = 0;
+
+    FramePlanner planner;
+    CHECK(planner.plan(&data_point, &priority, 1, 5, 1, false) == 0);
+    CHECK(planner.plan(&data_point, &priority, 1, 5, 0, false) == 1);
+  }
+}
+
+TEST_SUITE("network clock")
+{
+  TEST_CASE("maps local time to GPS seconds")
+  {
+    NetworkClock clock;
+    CHECK_FALSE(clock.synchronized());
+    CHECK(clock.stale(0, 1000));
+
+    clock.synchronize(1400000000, 5000);
+    CHECK(clock.toGps(5000) == 1400000000);
+    CHECK(clock.toGps(7999) == 1400000002);
+    // Sampled before the time was known
+    CHECK(clock.toGps(4999) == 1399999999);
+    CHECK(clock.toGps(0) == 1399999995);
+    CHECK_FALSE(clock.stale(6000, 1000));
+    CHECK(clock.stale(6001, 1000));
+
+    clock.invalidate();
+    CHECK_FALSE(clock.synchronized());
+  }
+
+  TEST_CASE("survives millis() wrapping around")
+  {
+    NetworkClock clock;
+    clock.synchronize(1400000000, UINT32_MAX - 999);
+    CHECK(clock.toGps(UINT32_MAX - 999) == 1400000000);
+    CHECK(clock.toGps(2000) == 1400000003);
+    CHECK_FALSE(clock.stale(2000, 5000));
+  }
+
+  TEST_CASE("keeps its age when restored")
+  {
+    NetworkClock clock;
+    clock.restore(1400000600, 50, 600000);
+    CHECK(clock.synchronized());
+    CHECK(clock.toGps(1050) == 1400000601);
+    CHECK(clock.age(1050) == 601000);
+    CHECK(clock.stale(1050, 600000));
+  }
+}
+
+TEST_SUITE("uplink queue")
+{
+  static QueuedDataPoint queued(MeasurementType type, uint8_t channel, float value, uint8_t priority, uint32_t sampled_ms)
+  {
+    return {{type, static_cast<ChannelID>(channel), value}, priority, sampled_ms};
+  }
+
+  TEST_CASE("orders by priority and coalesces channels")
+  {
+    UplinkQueue queue;
+    QueuedDataPoint evicted;
+    CHECK(queue.push(queued(MeasurementType::Temperature, 0, 18.0f, 0, 100), evicted) == UplinkQueue::PushResult::Queued);
+    CHECK(queue.push(queued(MeasurementType::Distance, 0, 80.0f, 1, 200), evicted) == UplinkQueue::PushResult::Queued);
+    CHECK(queue.push(queued(MeasurementType::Voltage, 0, 3.9f, 0, 300), evicted) == UplinkQueue::PushResult::Queued);
+    CHECK(queue.push(queued(MeasurementType::Temperature, 0, 19.0f, 0, 400), evicted) == UplinkQueue::PushResult::Coalesced);
+
+    REQUIRE(queue.size() == 3);
+    CHECK(queue[0].data_point.measurement_type == MeasurementType::Distance);
+    CHECK(queue[1].data_point.measurement_type == MeasurementType::Voltage);
+    CHECK(std::get<float>(queue[2].data_point.value) == 19.0f);
+    CHECK(queue[2].sampled_ms == 400);
+    CHECK(queue.coalesced() == 1);
+
+    // Older values, e.g. from the flash spill, are dropped
+    CHECK(queue.push(queued(MeasurementType::Temperature, 0, 17.0f, 0, 50), evicted) == UplinkQueue::PushResult::Coalesced);
+    CHECK(std::get<float>(queue[2].data_point.value) == 19.0f);
+
+    queue.removeIf([](size_t i)
+                   { return i != 1; });
+    REQUIRE(queue.size() == 1);
+    CHECK(queue[0].data_point.measurement_type == MeasurementType::Voltage);
+  }
+
+  TEST_CASE("evicts the oldest entry of the lowest priority when full")
+  {
+    UplinkQueue queue;
+    QueuedDataPoint evicted;
+    for (uint8_t i = 0; i < UPLINK_QUEUE_CAPACITY; i++)
+      queue.push(queued(static_cast<MeasurementType>(1 + i / 16), i % 16, i, i < 4 ? 0 : 1, i), evicted);
+    REQUIRE(queue.full());
+
+    CHECK(queue.push(queued(MeasurementType::Humidity, 0, 50.0f, 1, 1000), evicted) == UplinkQueue::PushResult::Evicted);
+    CHECK(evicted.sampled_ms == 0);
+    CHECK(queue.push(queued(MeasurementType::Boolean, 0, false, 0, 1001), evicted) == UplinkQueue::PushResult::Evicted);
+    CHECK(evicted.sampled_ms == 1);
+
+    for (int i = 0; i < 3; i++)
+      queue.push(queued(MeasurementType::Humidity, 1 + i, 50.0f, 1, 1002 + i), evicted);
+    CHECK(queue.push(queued(MeasurementType::pH, 0, 7.0f, 0, 2000), evicted) == UplinkQueue::PushResult::Rejected);
+    CHECK(evicted.data_point.measurement_type == MeasurementType::pH);
+    CHECK(queue.size() == UPLINK_QUEUE_CAPACITY);
+  }
+
+  TEST_CASE("spill records round trip")
+  {
+    uint8_t record[SPILL_RECORD_SIZE];
+    QueuedDataPoint restored;
+
+    writeSpillRecord(queued(MeasurementType::Distance, 3, 87.25f, 1, 123456789), record);
+    REQUIRE(readSpillRecord(record, restored));
+    CHECK(restored.data_point.channel_id == ChannelID::_3);
+    CHECK(std::get<float>(restored.data_point.value) == 87.25f);
+    CHECK(restored.priority == 1);
+    CHECK(restored.sampled_ms == 123456789);
+
+    writeSpillRecord({{MeasurementType::Boolean, ChannelID::_1, true}, 2, 5}, record);
+    REQUIRE(readSpillRecord(record, restored));
+    CHECK(std::get<bool>(restored.data_point.value));
+
+    record[0] = 0xF1;
+    CHECK_FALSE(readSpillRecord(record, restored));
+  }
+}
+
+TEST_SUITE("sample ring")
+{
+  TEST_CASE("packs datapoints")
+  {
+    const DataPoint distance{MeasurementType::Distance, ChannelID::_2, 87.25f};
+    const auto sample = PackedSample::pack(distance, 1234, PackedSample::END_OF_PUBLISH);
+    CHECK(sample.header == 0x42);
+    CHECK(sample.flags == PackedSample::END_OF_PUBLISH);
+    CHECK(std::get<float>(sample.unpack().value) == 87.25f);
+
+    const auto flag = PackedSample::pack({MeasurementType::Boolean, ChannelID::_1, true}, 0).unpack();
+    CHECK(flag.channel_id == ChannelID::_1);
+    CHECK(std::get<bool>(flag.value));
+  }
+
+  TEST_CASE("passes every item in order between two threads")
+  {
+    SpscRing<uint32_t, 64> ring;
+    uint32_t item;
+    CHECK_FALSE(ring.pop(item));
+    for (uint32_t i = 0; i < 64; i++)
+      REQUIRE(ring.push(i));
+    CHECK_FALSE(ring.push(64));
+    for (uint32_t i = 0; i < 64; i++)
+      REQUIRE(ring.pop(item));
+
+    constexpr uint32_t count = 1000000;
+    std::thread producer([&]
+                         {
+                           for (uint32_t i = 0; i < count; i++)
+                             while (!ring.push(i))
+                               std::this_thread::yield(); });
+
+    uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < count)
+    {
+      if (ring.pop(item))
+        ordered = ordered && item == expected++;
+      else
+        std::this_thread::yield();
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(ring.size() == 0);
+  }
+}
+
+TEST_SUITE("airtime")
+{
+  TEST_CASE("matches the LoRa airtime formula")
+  {
+    // 10 byte payloads, the numbers of the common airtime calculators
+    CHECK(airtimeUs(5, 10) == 61696);
+    CHECK(airtimeUs(0, 51) == 2793472);
+    CHECK(airtimeUs(0, 10) > airtimeUs(1, 10));
+    CHECK(airtimeUs(6, 10) < airtimeUs(5, 10));
+    CHECK(airtimeUs(7, 10) == (5 + 3 + 1 + 23 + 2) * 160);
+
+    for (uint8_t dr = 0; dr < 6; dr++)
+      MESSAGE("DR" << int(dr) << ": " << airtimeUs(dr, 12) / 1000.0 << " ms for 12 bytes, "
+                   << minUplinkIntervalMs(airtimeUs(dr, 12) / 1000, 0.01f, 30000) / 1000 << " s between uplinks");
+  }
+
+  TEST_CASE("stretches the interval to the tighter limit")
+  {
+    // 1 % duty cycle
+    CHECK(minUplinkIntervalMs(100, 0.01f, 0) == 10000);
+    // 30 s a day: 300 uplinks of 100 ms, one every 288 s
+    CHECK(minUplinkIntervalMs(100, 0.01f, 30000) == 288000);
+  }
+
+  TEST_CASE("keeps a rolling ledger")
+  {
+    AirtimeLedger ledger;
+    ledger.record(0, 0, 1000);
+    ledger.record(1800, 0, 2000);
+    ledger.record(1800, 1, 500);
+    CHECK(ledger.hourly(1800, 0) == 3000);
+    CHECK(ledger.hourly(1800, 1) == 500);
+    CHECK(ledger.daily(1800) == 3500);
+
+    // An hour later the first record left the hourly window
+    CHECK(ledger.hourly(3600 + 59, 0) == 2000);
+    CHECK(ledger.daily(3600 + 59) == 3500);
+    CHECK(ledger.daily(25 * 3600) == 0);
+
+    CHECK(ledger.allows(1800, 0, 33000, 0.01f, 0));
+    CHECK_FALSE(ledger.allows(1800, 0, 33001, 0.01f, 0));
+    CHECK_FALSE(ledger.allows(1800, 1, 100, 0.01f, 3500));
+    CHECK(ledger.allows(1800, 1, 100, 0.01f, 3600));
+  }
+}
+
+TEST_SUITE("config downlink")
+{
+  TEST_CASE("parses numbers and text")
+  {
+    // sequence 7, publishInterval = 300, deadband = "0.5"
+    const uint8_t payload[] = {7, 0x00, 0xac, 0x02, 0x42, 3, '0', '.', '5'};
+    ConfigDownlink downlink;
+    REQUIRE(parseConfigDownlink(payload, sizeof(payload), downlink) == ConfigStatus::Applied);
+    CHECK(downlink.sequence == 7);
+    REQUIRE(downlink.count == 2);
+    CHECK(std::string(downlink.settings[0].key) == "publishInterval");
+    CHECK(std::string(downlink.settings[0].value) == "300");
+    CHECK(std::string(downlink.settings[1].key) == "deadband");
+    CHECK(std::string(downlink.settings[1].value) == "0.5");
+  }
+
+  TEST_CASE("rejects the whole downlink")
+  {
+    ConfigDownlink downlink;
+    const uint8_t unknown[] = {1, 0x00, 30, 0x3f, 1};
+    CHECK(parseConfigDownlink(unknown, sizeof(unknown), downlink) == ConfigStatus::UnknownKey);
+    CHECK(downlink.count == 0);
+
+    const uint8_t truncated[] = {1, 0x42, 3, '0', '.'};
+    CHECK(parseConfigDownlink(truncated, sizeof(truncated), downlink) == ConfigStatus::Malformed);
+    const uint8_t line_break[] = {1, 0x42, 2, '1', '\n'};
+    CHECK(parseConfigDownlink(line_break, sizeof(line_break), downlink) == ConfigStatus::Malformed);
+    const uint8_t reserved_kind[] = {1, 0x80, 1};
+    CHECK(parseConfigDownlink(reserved_kind, sizeof(reserved_kind), downlink) == ConfigStatus::Malformed);
+    CHECK(parseConfigDownlink(nullptr, 0, downlink) == ConfigStatus::Malformed);
+  }
+
+  TEST_CASE("acknowledges in the uplink")
+  {
+    std::array<uint8_t, CONFIG_ACK_PACKED_SIZE> buffer;
+    Encoder encoder(buffer);
+    CHECK(encoder.addConfigAck(7, ConfigStatus::UnknownKey));
+    CHECK(buffer[0] == 0xF6);
+    CHECK(buffer[1] == 7);
+    CHECK(buffer[2] == 2);
+    CHECK_FALSE(encoder.addConfigAck(8, ConfigStatus::Applied));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  doctest::Context context;
+
+  // BEGIN:: PLATFORMIO REQUIRED OPTIONS
+  context.setOption("success", true);     // Report successful tests
+  context.setOption("no-exitcode", true); // Do not return non-zero code on failed test case
+  // END:: PLATFORMIO REQUIRED OPTIONS
+
+  // YOUR CUSTOM DOCTEST OPTIONS
+
+  context.applyCommandLine(argc, argv);
+  return context.run();
+}
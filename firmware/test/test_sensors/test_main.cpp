@@ -0,0 +1,391 @@
+#define DOCTEST_CONFIG_IMPLEMENT // REQUIRED: Enable custom main()
+#include <doctest.h>
+
+#include <array>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "sensors/distance-filter.h"
+#include "sensors/echo-capture.h"
+#include "sensors/sample-buffer.h"
+#include "sensors/sampling-scheduler.h"
+#include "sensors/temperature-conversion.h"
+
+#include "traces.h"
+
+using namespace Sensor;
+
+// Root mean square error of `filter` against the reference level, from the `skip`-th sample on.
+template <size_t N, size_t Length>
+static float filteredError(DistanceFilter<N> &filter, const Traces::TraceSample (&trace)[Length], size_t skip)
+{
+  float sum = 0.0f;
+  for (size_t i = 0; i < Length; i++)
+  {
+    filter.add(trace[i].distance_cm, trace[i].sampled_ms);
+    if (i >= skip)
+      sum += std::pow(filter.value() - trace[i].reference_cm, 2.0f);
+  }
+  return std::sqrt(sum / (Length - skip));
+}
+
+TEST_SUITE("echo capture")
+{
+  TEST_CASE("converts echo times")
+  {
+    // 1 m and back at 343 m/s
+    CHECK(echoDistanceCm(5831) == doctest::Approx(100.0f).epsilon(0.001));
+    CHECK(echoTimeUs(40.0f) == 2332);
+    CHECK(echoDistanceCm(echoTimeUs(87.0f)) == doctest::Approx(87.0f).epsilon(0.001));
+  }
+
+  TEST_CASE("corrects for the air temperature")
+  {
+    CHECK(speedOfSound(0.0f) == doctest::Approx(331.3f));
+    CHECK(speedOfSound(20.0f) == doctest::Approx(SPEED_OF_SOUND_M_S).epsilon(0.002));
+
+    EchoConverter converter;
+    CHECK(converter.distanceCm(5831) == doctest::Approx(100.0f).epsilon(0.002));
+
+    // A seasonal swing of 40 °C moves a meter by 7 cm
+    converter.setTemperature(-5.0f);
+    const float winter = converter.distanceCm(5831);
+    converter.setTemperature(35.0f);
+    const float summer = converter.distanceCm(5831);
+    CHECK(summer - winter == doctest::Approx(7.07f).epsilon(0.01));
+    CHECK(summer == doctest::Approx(echoDistanceCm(5831, speedOfSound(35.0f))));
+
+    // Recomputed per step only, a missing reading keeps the temperature
+    converter.setTemperature(20.0f);
+    const float speed = converter.speed();
+    converter.setTemperature(20.2f);
+    CHECK(converter.speed() == speed);
+    converter.setTemperature(NAN);
+    CHECK(converter.speed() == speed);
+    converter.setTemperature(20.3f);
+    CHECK(converter.speed() == doctest::Approx(speedOfSound(20.5f)));
+  }
+
+  TEST_CASE("times the echo from its edges")
+  {
+    EchoCapture capture;
+    uint32_t echo_us = 0;
+    CHECK(capture.poll(0, 3000, echo_us) == EchoCapture::State::Idle);
+
+    // Edges outside of a measurement are ignored
+    capture.edge(true, 10);
+    capture.start(UINT32_MAX - 100); // across the wrap of the µs clock
+    CHECK(capture.poll(UINT32_MAX, 3000, echo_us) == EchoCapture::State::Waiting);
+    capture.edge(false, 400); // a falling edge without rising one
+    capture.edge(true, 400);
+    capture.edge(false, 2732);
+    CHECK(capture.poll(2800, 3000, echo_us) == EchoCapture::State::Done);
+    CHECK(echo_us == 2332);
+    CHECK(capture.poll(2900, 3000, echo_us) == EchoCapture::State::Idle);
+
+    capture.start(10000);
+    capture.edge(true, 10500);
+    CHECK(capture.poll(13000, 3000, echo_us) == EchoCapture::State::Waiting);
+    CHECK(capture.poll(13001, 3000, echo_us) == EchoCapture::State::Timeout);
+    CHECK(capture.poll(13002, 3000, echo_us) == EchoCapture::State::Idle);
+  }
+
+  TEST_CASE("takes edges from another thread")
+  {
+    EchoCapture capture;
+    uint32_t echo_us = 0;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+      capture.start(0);
+      std::thread isr([&]
+                      {
+                        capture.edge(true, 100);
+                        capture.edge(false, 100 + i); });
+      EchoCapture::State state;
+      while ((state = capture.poll(0, 3000, echo_us)) == EchoCapture::State::Waiting)
+        ;
+      isr.join();
+      REQUIRE(state == EchoCapture::State::Done);
+      REQUIRE(echo_us == i);
+    }
+  }
+}
+
+TEST_SUITE("sampling scheduler")
+{
+  TEST_CASE("samples every period, whatever the loop rate")
+  {
+    SamplingScheduler scheduler;
+    const int sensor = scheduler.add({1000, 0, 100, NO_BUS}, 0);
+    REQUIRE(sensor == 0);
+
+    size_t samples = 0;
+    for (uint32_t now = 0; now < 10000; now++)
+    {
+      while (scheduler.due(now) == sensor)
+        samples++;
+    }
+    CHECK(samples == 10);
+    CHECK(scheduler.untilDue(9999) == 1);
+
+    // A loop that stalled samples once, not for every period it missed
+    CHECK(scheduler.due(15500) == sensor);
+    CHECK(scheduler.due(15500) == -1);
+    CHECK(scheduler.untilDue(15500) == 500);
+
+    scheduler.setPeriod(sensor, 0);
+    CHECK(scheduler.untilDue(15500) == UINT32_MAX);
+  }
+
+  TEST_CASE("bursts end right before the publish")
+  {
+    SamplingScheduler scheduler;
+    const int sensor = scheduler.add({0, 5, 100, NO_BUS}, 0);
+    CHECK(scheduler.untilDue(0) == UINT32_MAX);
+
+    scheduler.publishAt(30000, 0);
+    CHECK(scheduler.bursting());
+    CHECK(scheduler.untilDue(0) == 29500);
+
+    std::vector<uint32_t> times;
+    for (uint32_t now = 0; now <= 30000; now += 10)
+    {
+      while (scheduler.due(now) == sensor)
+        times.push_back(now);
+    }
+    CHECK((times == std::vector<uint32_t>{29500, 29600, 29700, 29800, 29900}));
+    CHECK_FALSE(scheduler.bursting());
+
+    // Same publish, no second burst
+    scheduler.publishAt(30000, 30000);
+    CHECK_FALSE(scheduler.bursting());
+
+    // Too late for the burst to end on time, it starts right away
+    scheduler.publishAt(60000, 59800);
+    CHECK(scheduler.due(59800) == sensor);
+    CHECK(scheduler.due(59800) == -1);
+    CHECK(scheduler.untilDue(59800) == 100);
+  }
+
+  TEST_CASE("shifts sensors on the same bus")
+  {
+    SamplingScheduler scheduler;
+    const int a = scheduler.add({1000, 2, 100, 0}, 0);
+    const int b = scheduler.add({1000, 2, 100, 0}, 0);
+    const int c = scheduler.add({1000, 2, 100, NO_BUS}, 0);
+
+    CHECK(scheduler.due(0) == a);
+    CHECK(scheduler.due(0) == c);
+    CHECK(scheduler.due(0) == -1);
+    CHECK(scheduler.untilDue(0) == BUS_SLOT_MS);
+    CHECK(scheduler.due(BUS_SLOT_MS) == b);
+
+    // Bursts alike, b samples one slot ahead of a
+    SamplingScheduler bursts;
+    const int d = bursts.add({0, 2, 100, 0}, 0);
+    const int e = bursts.add({0, 2, 100, 0}, 0);
+    bursts.publishAt(5000, 100);
+    CHECK(bursts.due(4780 - 1) == -1);
+    CHECK(bursts.due(4780) == e);
+    CHECK(bursts.due(4780) == -1);
+    CHECK(bursts.due(4800) == d);
+    CHECK(bursts.due(4880) == e);
+    CHECK(bursts.due(4900) == d);
+  }
+
+  TEST_CASE("works across the wrap of millis()")
+  {
+    SamplingScheduler scheduler;
+    const int sensor = scheduler.add({0, 2, 100, NO_BUS}, UINT32_MAX - 1000);
+    scheduler.publishAt(50, UINT32_MAX - 1000);
+    CHECK(scheduler.untilDue(UINT32_MAX - 1000) == 851);
+    CHECK(scheduler.due(UINT32_MAX - 150) == -1);
+    CHECK(scheduler.due(UINT32_MAX - 149) == sensor);
+    CHECK(scheduler.due(UINT32_MAX) == sensor);
+    CHECK_FALSE(scheduler.bursting());
+  }
+
+  TEST_CASE("holds a fixed number of sensors")
+  {
+    SamplingScheduler scheduler;
+    for (size_t i = 0; i < MAX_SCHEDULED_SENSORS; i++)
+      CHECK(scheduler.add({1000, 1, 100, NO_BUS}, 0) == static_cast<int>(i));
+    CHECK(scheduler.add({1000, 1, 100, NO_BUS}, 0) == -1);
+    CHECK(scheduler.size() == MAX_SCHEDULED_SENSORS);
+  }
+}
+
+TEST_SUITE("sample buffer")
+{
+  TEST_CASE("keeps the newest samples of every sensor")
+  {
+    SampleBuffer<4> buffer;
+    Sample sample;
+    CHECK_FALSE(buffer.latest(0, sample));
+
+    buffer.push({0, 10.0f, 100});
+    buffer.push({1, 20.0f, 110});
+    buffer.push({0, 11.0f, 200});
+    CHECK(buffer.latest(0, sample));
+    CHECK(sample.value == 11.0f);
+    CHECK(sample.sampled_ms == 200);
+
+    std::array<float, 4> values;
+    CHECK(buffer.values(0, 0, values.data(), values.size()) == 2);
+    CHECK(values[0] == 10.0f);
+    CHECK(values[1] == 11.0f);
+    CHECK(buffer.values(0, 150, values.data(), values.size()) == 1);
+    CHECK(buffer.values(0, 0, values.data(), 1) == 1);
+
+    // The oldest samples make room
+    buffer.push({0, 12.0f, 300});
+    buffer.push({0, 13.0f, 400});
+    CHECK(buffer.size() == 4);
+    CHECK(buffer[0].sensor == 1);
+    CHECK(buffer.values(0, 0, values.data(), values.size()) == 3);
+    CHECK(values[0] == 11.0f);
+    CHECK(values[2] == 13.0f);
+
+    buffer.clear();
+    CHECK_FALSE(buffer.latest(1, sample));
+  }
+}
+
+TEST_SUITE("distance filter")
+{
+  TEST_CASE("takes the median of a ring buffer")
+  {
+    MedianFilter<5> median;
+    median.add(3.0f);
+    CHECK(median.median() == 3.0f);
+    median.add(1.0f);
+    CHECK(median.median() == 2.0f);
+    median.add(100.0f);
+    CHECK(median.median() == 3.0f);
+    CHECK(median.deviation(3.0f) == 2.0f);
+
+    // The oldest values make room
+    for (float value : {7.0f, 8.0f, 9.0f, 10.0f})
+      median.add(value);
+    CHECK(median.size() == 5);
+    CHECK(median.median() == 9.0f);
+
+    median.clear();
+    CHECK(median.size() == 0);
+  }
+
+  TEST_CASE("Kalman filter converges and follows by its process noise")
+  {
+    KalmanFilter still(0.01f, 1.0f);
+    KalmanFilter agile(1.0f, 1.0f);
+    CHECK(still.update(50.0f, 0.0f) == 50.0f);
+    agile.update(50.0f, 0.0f);
+    for (int i = 0; i < 10; i++)
+    {
+      still.update(60.0f, 1.0f);
+      agile.update(60.0f, 1.0f);
+    }
+    CHECK(still.estimate() > 50.0f);
+    CHECK(still.estimate() < agile.estimate());
+    CHECK(agile.estimate() == doctest::Approx(60.0f).epsilon(0.001));
+    CHECK(still.variance() < agile.variance());
+  }
+
+  TEST_CASE("rejects wall echoes and ripples")
+  {
+    // Three outliers in a row still leave the window a majority of the surface
+    DistanceFilter<9> filter;
+    size_t outliers = 0;
+    size_t rejected_surface = 0;
+    for (const auto &sample : Traces::RIPPLES)
+    {
+      const bool accepted = filter.add(sample.distance_cm, sample.sampled_ms);
+      outliers += sample.outlier;
+      CHECK_FALSE((sample.outlier && accepted));
+      rejected_surface += !sample.outlier && !accepted;
+    }
+    CHECK(filter.rejected() == outliers + rejected_surface);
+    CHECK(rejected_surface < 5);
+  }
+
+  TEST_CASE("filters a still level below the sensor's noise")
+  {
+    float raw = 0.0f;
+    for (const auto &sample : Traces::RIPPLES)
+      raw += std::pow(sample.distance_cm - sample.reference_cm, 2.0f);
+    raw = std::sqrt(raw / (sizeof(Traces::RIPPLES) / sizeof(Traces::RIPPLES[0])));
+
+    DistanceFilter<9> filter;
+    const float filtered = filteredError(filter, Traces::RIPPLES, 10);
+    CHECK(raw > 10.0f);
+    CHECK(filtered < 0.3f);
+  }
+
+  TEST_CASE("follows a refill by its process noise")
+  {
+    DistanceFilterConfig agile_config = DISTANCE_FILTER_DEFAULTS;
+    agile_config.process_noise = 1.0f;
+    DistanceFilter<9> agile(agile_config);
+    DistanceFilter<9> still;
+
+    // The jump passes once it fills half the window
+    for (size_t i = 0; i < 135; i++)
+    {
+      agile.add(Traces::REFILL[i].distance_cm, Traces::REFILL[i].sampled_ms);
+      still.add(Traces::REFILL[i].distance_cm, Traces::REFILL[i].sampled_ms);
+    }
+    CHECK(agile.value() == doctest::Approx(46.0f).epsilon(0.02));
+    CHECK(still.value() > agile.value() + 5.0f);
+
+    // The default is slower, and steadier once settled
+    for (size_t i = 135; i < 240; i++)
+      still.add(Traces::REFILL[i].distance_cm, Traces::REFILL[i].sampled_ms);
+    CHECK(still.value() == doctest::Approx(46.0f).epsilon(0.02));
+  }
+}
+
+TEST_SUITE("temperature conversion")
+{
+  TEST_CASE("takes longer the more bits")
+  {
+    CHECK(conversionTimeMs(9) == 93);
+    CHECK(conversionTimeMs(10) == 187);
+    CHECK(conversionTimeMs(11) == 375);
+    CHECK(conversionTimeMs(12) == 750);
+    CHECK(clampResolution(4) == DS18B20_MIN_RESOLUTION);
+    CHECK(clampResolution(16) == DS18B20_MAX_RESOLUTION);
+    CHECK(conversionTimeMs(16) == 750);
+  }
+
+  TEST_CASE("finishes without waiting for it")
+  {
+    TemperatureConversion conversion;
+    CHECK_FALSE(conversion.running());
+    CHECK_FALSE(conversion.finished(0));
+    CHECK(conversion.untilFinished(0) == 0);
+
+    conversion.start(UINT32_MAX - 50, 10); // across the wrap of millis()
+    CHECK(conversion.running());
+    CHECK(conversion.untilFinished(UINT32_MAX) == 137);
+    CHECK_FALSE(conversion.finished(135));
+    CHECK(conversion.finished(136));
+    CHECK_FALSE(conversion.finished(137));
+    CHECK_FALSE(conversion.running());
+  }
+}
+
+int main(int argc, char **argv)
+{
+  doctest::Context context;
+
+  // BEGIN:: PLATFORMIO REQUIRED OPTIONS
+  context.setOption("success", true);     // Report successful tests
+  context.setOption("no-exitcode", true); // Do not return non-zero code on failed test case
+  // END:: PLATFORMIO REQUIRED OPTIONS
+
+  // YOUR CUSTOM DOCTEST OPTIONS
+
+  context.applyCommandLine(argc, argv);
+  return context.run();
+}
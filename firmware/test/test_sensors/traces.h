@@ -0,0 +1,507 @@
+#pragma once
+
+#include <cstdint>
+
+// Synthetic HC-SR04 traces, one sample per second, modelled on readings in a
+// rain barrel: the surface with 0.7 cm of noise at the module's 1/3 cm steps,
+// interspersed with echoes off the wall (18-40 cm) and ripples that scatter
+// the pulse (95-125 cm). Every sample carries the true level and whether it
+// is such an outlier.
+namespace Traces
+{
+    struct TraceSample
+    {
+        uint32_t sampled_ms;
+        float distance_cm;
+        float reference_cm;
+        bool outlier;
+    };
+
+    // Still level, 8 % outliers
+    constexpr TraceSample RIPPLES[] = {
+        {0, 81.3f, 82.0f, false},
+        {1000, 81.7f, 82.0f, false},
+        {2000, 82.0f, 82.0f, false},
+        {3000, 82.0f, 82.0f, false},
+        {4000, 82.3f, 82.0f, false},
+        {5000, 84.3f, 82.0f, false},
+        {6000, 81.0f, 82.0f, false},
+        {7000, 82.0f, 82.0f, false},
+        {8000, 82.7f, 82.0f, false},
+        {9000, 81.3f, 82.0f, false},
+        {10000, 83.0f, 82.0f, false},
+        {11000, 82.3f, 82.0f, false},
+        {12000, 83.3f, 82.0f, false},
+        {13000, 82.3f, 82.0f, false},
+        {14000, 82.7f, 82.0f, false},
+        {15000, 81.3f, 82.0f, false},
+        {16000, 82.3f, 82.0f, false},
+        {17000, 81.3f, 82.0f, false},
+        {18000, 82.3f, 82.0f, false},
+        {19000, 82.3f, 82.0f, false},
+        {20000, 81.0f, 82.0f, false},
+        {21000, 82.3f, 82.0f, false},
+        {22000, 81.7f, 82.0f, false},
+        {23000, 82.3f, 82.0f, false},
+        {24000, 83.0f, 82.0f, false},
+        {25000, 81.3f, 82.0f, false},
+        {26000, 83.0f, 82.0f, false},
+        {27000, 82.0f, 82.0f, false},
+        {28000, 83.3f, 82.0f, false},
+        {29000, 81.7f, 82.0f, false},
+        {30000, 82.3f, 82.0f, false},
+        {31000, 83.3f, 82.0f, false},
+        {32000, 83.3f, 82.0f, false},
+        {33000, 82.7f, 82.0f, false},
+        {34000, 82.3f, 82.0f, false},
+        {35000, 81.3f, 82.0f, false},
+        {36000, 82.3f, 82.0f, false},
+        {37000, 96.3f, 82.0f, true},
+        {38000, 80.7f, 82.0f, false},
+        {39000, 83.3f, 82.0f, false},
+        {40000, 80.7f, 82.0f, false},
+        {41000, 82.0f, 82.0f, false},
+        {42000, 82.3f, 82.0f, false},
+        {43000, 27.0f, 82.0f, true},
+        {44000, 82.0f, 82.0f, false},
+        {45000, 82.3f, 82.0f, false},
+        {46000, 83.3f, 82.0f, false},
+        {47000, 81.7f, 82.0f, false},
+        {48000, 81.0f, 82.0f, false},
+        {49000, 82.0f, 82.0f, false},
+        {50000, 80.7f, 82.0f, false},
+        {51000, 81.0f, 82.0f, false},
+        {52000, 82.0f, 82.0f, false},
+        {53000, 81.3f, 82.0f, false},
+        {54000, 81.0f, 82.0f, false},
+        {55000, 30.8f, 82.0f, true},
+        {56000, 114.0f, 82.0f, true},
+        {57000, 109.0f, 82.0f, true},
+        {58000, 82.0f, 82.0f, false},
+        {59000, 81.7f, 82.0f, false},
+        {60000, 32.9f, 82.0f, true},
+        {61000, 81.0f, 82.0f, false},
+        {62000, 81.0f, 82.0f, false},
+        {63000, 82.3f, 82.0f, false},
+        {64000, 81.7f, 82.0f, false},
+        {65000, 82.7f, 82.0f, false},
+        {66000, 81.0f, 82.0f, false},
+        {67000, 34.2f, 82.0f, true},
+        {68000, 83.0f, 82.0f, false},
+        {69000, 82.3f, 82.0f, false},
+        {70000, 81.7f, 82.0f, false},
+        {71000, 82.0f, 82.0f, false},
+        {72000, 81.7f, 82.0f, false},
+        {73000, 82.3f, 82.0f, false},
+        {74000, 81.3f, 82.0f, false},
+        {75000, 81.3f, 82.0f, false},
+        {76000, 83.0f, 82.0f, false},
+        {77000, 82.0f, 82.0f, false},
+        {78000, 82.3f, 82.0f, false},
+        {79000, 82.3f, 82.0f, false},
+        {80000, 80.7f, 82.0f, false},
+        {81000, 82.3f, 82.0f, false},
+        {82000, 81.0f, 82.0f, false},
+        {83000, 82.3f, 82.0f, false},
+        {84000, 82.3f, 82.0f, false},
+        {85000, 81.7f, 82.0f, false},
+        {86000, 82.7f, 82.0f, false},
+        {87000, 82.3f, 82.0f, false},
+        {88000, 121.4f, 82.0f, true},
+        {89000, 81.7f, 82.0f, false},
+        {90000, 83.7f, 82.0f, false},
+        {91000, 81.7f, 82.0f, false},
+        {92000, 82.7f, 82.0f, false},
+        {93000, 81.0f, 82.0f, false},
+        {94000, 81.7f, 82.0f, false},
+        {95000, 24.3f, 82.0f, true},
+        {96000, 82.3f, 82.0f, false},
+        {97000, 115.8f, 82.0f, true},
+        {98000, 83.3f, 82.0f, false},
+        {99000, 81.0f, 82.0f, false},
+        {100000, 100.2f, 82.0f, true},
+        {101000, 81.7f, 82.0f, false},
+        {102000, 81.3f, 82.0f, false},
+        {103000, 81.7f, 82.0f, false},
+        {104000, 81.7f, 82.0f, false},
+        {105000, 80.7f, 82.0f, false},
+        {106000, 82.3f, 82.0f, false},
+        {107000, 80.7f, 82.0f, false},
+        {108000, 81.7f, 82.0f, false},
+        {109000, 83.0f, 82.0f, false},
+        {110000, 81.3f, 82.0f, false},
+        {111000, 120.9f, 82.0f, true},
+        {112000, 23.9f, 82.0f, true},
+        {113000, 81.3f, 82.0f, false},
+        {114000, 82.3f, 82.0f, false},
+        {115000, 20.8f, 82.0f, true},
+        {116000, 83.7f, 82.0f, false},
+        {117000, 82.7f, 82.0f, false},
+        {118000, 81.3f, 82.0f, false},
+        {119000, 82.0f, 82.0f, false},
+        {120000, 81.3f, 82.0f, false},
+        {121000, 81.3f, 82.0f, false},
+        {122000, 81.7f, 82.0f, false},
+        {123000, 82.3f, 82.0f, false},
+        {124000, 81.7f, 82.0f, false},
+        {125000, 82.3f, 82.0f, false},
+        {126000, 81.0f, 82.0f, false},
+        {127000, 81.3f, 82.0f, false},
+        {128000, 81.3f, 82.0f, false},
+        {129000, 81.3f, 82.0f, false},
+        {130000, 81.7f, 82.0f, false},
+        {131000, 81.3f, 82.0f, false},
+        {132000, 82.0f, 82.0f, false},
+        {133000, 83.0f, 82.0f, false},
+        {134000, 27.4f, 82.0f, true},
+        {135000, 82.7f, 82.0f, false},
+        {136000, 81.7f, 82.0f, false},
+        {137000, 82.0f, 82.0f, false},
+        {138000, 82.7f, 82.0f, false},
+        {139000, 81.3f, 82.0f, false},
+        {140000, 80.7f, 82.0f, false},
+        {141000, 82.0f, 82.0f, false},
+        {142000, 81.0f, 82.0f, false},
+        {143000, 82.3f, 82.0f, false},
+        {144000, 82.0f, 82.0f, false},
+        {145000, 20.2f, 82.0f, true},
+        {146000, 82.0f, 82.0f, false},
+        {147000, 82.0f, 82.0f, false},
+        {148000, 82.7f, 82.0f, false},
+        {149000, 81.0f, 82.0f, false},
+        {150000, 81.0f, 82.0f, false},
+        {151000, 110.3f, 82.0f, true},
+        {152000, 81.3f, 82.0f, false},
+        {153000, 82.0f, 82.0f, false},
+        {154000, 30.4f, 82.0f, true},
+        {155000, 80.3f, 82.0f, false},
+        {156000, 82.3f, 82.0f, false},
+        {157000, 82.3f, 82.0f, false},
+        {158000, 81.3f, 82.0f, false},
+        {159000, 82.3f, 82.0f, false},
+        {160000, 81.7f, 82.0f, false},
+        {161000, 82.0f, 82.0f, false},
+        {162000, 81.0f, 82.0f, false},
+        {163000, 82.7f, 82.0f, false},
+        {164000, 82.0f, 82.0f, false},
+        {165000, 81.0f, 82.0f, false},
+        {166000, 81.0f, 82.0f, false},
+        {167000, 80.7f, 82.0f, false},
+        {168000, 82.0f, 82.0f, false},
+        {169000, 80.3f, 82.0f, false},
+        {170000, 82.0f, 82.0f, false},
+        {171000, 81.7f, 82.0f, false},
+        {172000, 81.3f, 82.0f, false},
+        {173000, 81.7f, 82.0f, false},
+        {174000, 82.7f, 82.0f, false},
+        {175000, 81.7f, 82.0f, false},
+        {176000, 82.7f, 82.0f, false},
+        {177000, 81.3f, 82.0f, false},
+        {178000, 82.7f, 82.0f, false},
+        {179000, 82.0f, 82.0f, false},
+        {180000, 81.7f, 82.0f, false},
+        {181000, 82.3f, 82.0f, false},
+        {182000, 82.7f, 82.0f, false},
+        {183000, 82.0f, 82.0f, false},
+        {184000, 82.7f, 82.0f, false},
+        {185000, 81.0f, 82.0f, false},
+        {186000, 81.7f, 82.0f, false},
+        {187000, 80.7f, 82.0f, false},
+        {188000, 82.7f, 82.0f, false},
+        {189000, 81.7f, 82.0f, false},
+        {190000, 81.7f, 82.0f, false},
+        {191000, 81.0f, 82.0f, false},
+        {192000, 82.0f, 82.0f, false},
+        {193000, 82.3f, 82.0f, false},
+        {194000, 81.7f, 82.0f, false},
+        {195000, 80.7f, 82.0f, false},
+        {196000, 82.3f, 82.0f, false},
+        {197000, 81.7f, 82.0f, false},
+        {198000, 82.3f, 82.0f, false},
+        {199000, 82.0f, 82.0f, false},
+        {200000, 81.3f, 82.0f, false},
+        {201000, 82.7f, 82.0f, false},
+        {202000, 27.6f, 82.0f, true},
+        {203000, 82.3f, 82.0f, false},
+        {204000, 83.0f, 82.0f, false},
+        {205000, 81.7f, 82.0f, false},
+        {206000, 82.0f, 82.0f, false},
+        {207000, 83.0f, 82.0f, false},
+        {208000, 83.0f, 82.0f, false},
+        {209000, 82.7f, 82.0f, false},
+        {210000, 81.7f, 82.0f, false},
+        {211000, 81.7f, 82.0f, false},
+        {212000, 83.0f, 82.0f, false},
+        {213000, 82.0f, 82.0f, false},
+        {214000, 83.3f, 82.0f, false},
+        {215000, 81.7f, 82.0f, false},
+        {216000, 82.0f, 82.0f, false},
+        {217000, 81.7f, 82.0f, false},
+        {218000, 81.0f, 82.0f, false},
+        {219000, 81.3f, 82.0f, false},
+        {220000, 81.3f, 82.0f, false},
+        {221000, 81.7f, 82.0f, false},
+        {222000, 81.7f, 82.0f, false},
+        {223000, 81.3f, 82.0f, false},
+        {224000, 83.0f, 82.0f, false},
+        {225000, 81.7f, 82.0f, false},
+        {226000, 81.3f, 82.0f, false},
+        {227000, 83.0f, 82.0f, false},
+        {228000, 82.3f, 82.0f, false},
+        {229000, 82.0f, 82.0f, false},
+        {230000, 81.3f, 82.0f, false},
+        {231000, 82.0f, 82.0f, false},
+        {232000, 82.0f, 82.0f, false},
+        {233000, 82.0f, 82.0f, false},
+        {234000, 81.3f, 82.0f, false},
+        {235000, 81.0f, 82.0f, false},
+        {236000, 81.7f, 82.0f, false},
+        {237000, 82.3f, 82.0f, false},
+        {238000, 82.3f, 82.0f, false},
+        {239000, 82.3f, 82.0f, false},
+    };
+
+    // A refill raises the level by 32 cm after two minutes, 5 % outliers
+    constexpr TraceSample REFILL[] = {
+        {0, 78.0f, 78.0f, false},
+        {1000, 76.7f, 78.0f, false},
+        {2000, 78.0f, 78.0f, false},
+        {3000, 78.0f, 78.0f, false},
+        {4000, 77.0f, 78.0f, false},
+        {5000, 76.7f, 78.0f, false},
+        {6000, 78.0f, 78.0f, false},
+        {7000, 79.0f, 78.0f, false},
+        {8000, 24.1f, 78.0f, true},
+        {9000, 78.0f, 78.0f, false},
+        {10000, 77.7f, 78.0f, false},
+        {11000, 77.7f, 78.0f, false},
+        {12000, 101.3f, 78.0f, true},
+        {13000, 77.7f, 78.0f, false},
+        {14000, 78.3f, 78.0f, false},
+        {15000, 77.7f, 78.0f, false},
+        {16000, 77.7f, 78.0f, false},
+        {17000, 77.7f, 78.0f, false},
+        {18000, 79.3f, 78.0f, false},
+        {19000, 77.7f, 78.0f, false},
+        {20000, 78.3f, 78.0f, false},
+        {21000, 78.3f, 78.0f, false},
+        {22000, 78.0f, 78.0f, false},
+        {23000, 78.0f, 78.0f, false},
+        {24000, 77.7f, 78.0f, false},
+        {25000, 79.3f, 78.0f, false},
+        {26000, 77.0f, 78.0f, false},
+        {27000, 78.0f, 78.0f, false},
+        {28000, 79.0f, 78.0f, false},
+        {29000, 78.3f, 78.0f, false},
+        {30000, 106.0f, 78.0f, true},
+        {31000, 78.3f, 78.0f, false},
+        {32000, 78.0f, 78.0f, false},
+        {33000, 78.3f, 78.0f, false},
+        {34000, 79.0f, 78.0f, false},
+        {35000, 77.7f, 78.0f, false},
+        {36000, 78.7f, 78.0f, false},
+        {37000, 79.0f, 78.0f, false},
+        {38000, 78.7f, 78.0f, false},
+        {39000, 79.7f, 78.0f, false},
+        {40000, 78.3f, 78.0f, false},
+        {41000, 76.7f, 78.0f, false},
+        {42000, 77.0f, 78.0f, false},
+        {43000, 77.3f, 78.0f, false},
+        {44000, 77.7f, 78.0f, false},
+        {45000, 78.3f, 78.0f, false},
+        {46000, 78.3f, 78.0f, false},
+        {47000, 78.0f, 78.0f, false},
+        {48000, 78.3f, 78.0f, false},
+        {49000, 77.7f, 78.0f, false},
+        {50000, 78.3f, 78.0f, false},
+        {51000, 77.3f, 78.0f, false},
+        {52000, 78.3f, 78.0f, false},
+        {53000, 78.7f, 78.0f, false},
+        {54000, 78.3f, 78.0f, false},
+        {55000, 77.7f, 78.0f, false},
+        {56000, 76.3f, 78.0f, false},
+        {57000, 78.7f, 78.0f, false},
+        {58000, 78.3f, 78.0f, false},
+        {59000, 77.7f, 78.0f, false},
+        {60000, 78.7f, 78.0f, false},
+        {61000, 78.7f, 78.0f, false},
+        {62000, 78.0f, 78.0f, false},
+        {63000, 77.3f, 78.0f, false},
+        {64000, 78.0f, 78.0f, false},
+        {65000, 76.7f, 78.0f, false},
+        {66000, 79.3f, 78.0f, false},
+        {67000, 77.3f, 78.0f, false},
+        {68000, 78.0f, 78.0f, false},
+        {69000, 78.3f, 78.0f, false},
+        {70000, 76.7f, 78.0f, false},
+        {71000, 78.3f, 78.0f, false},
+        {72000, 77.0f, 78.0f, false},
+        {73000, 77.3f, 78.0f, false},
+        {74000, 78.7f, 78.0f, false},
+        {75000, 78.0f, 78.0f, false},
+        {76000, 77.0f, 78.0f, false},
+        {77000, 77.3f, 78.0f, false},
+        {78000, 23.5f, 78.0f, true},
+        {79000, 77.3f, 78.0f, false},
+        {80000, 78.3f, 78.0f, false},
+        {81000, 77.0f, 78.0f, false},
+        {82000, 77.3f, 78.0f, false},
+        {83000, 77.0f, 78.0f, false},
+        {84000, 78.7f, 78.0f, false},
+        {85000, 76.7f, 78.0f, false},
+        {86000, 78.7f, 78.0f, false},
+        {87000, 77.7f, 78.0f, false},
+        {88000, 79.0f, 78.0f, false},
+        {89000, 76.7f, 78.0f, false},
+        {90000, 77.7f, 78.0f, false},
+        {91000, 77.0f, 78.0f, false},
+        {92000, 77.0f, 78.0f, false},
+        {93000, 77.3f, 78.0f, false},
+        {94000, 78.0f, 78.0f, false},
+        {95000, 77.0f, 78.0f, false},
+        {96000, 27.7f, 78.0f, true},
+        {97000, 78.3f, 78.0f, false},
+        {98000, 79.0f, 78.0f, false},
+        {99000, 23.0f, 78.0f, true},
+        {100000, 78.3f, 78.0f, false},
+        {101000, 78.3f, 78.0f, false},
+        {102000, 78.7f, 78.0f, false},
+        {103000, 78.3f, 78.0f, false},
+        {104000, 77.7f, 78.0f, false},
+        {105000, 77.7f, 78.0f, false},
+        {106000, 24.1f, 78.0f, true},
+        {107000, 79.0f, 78.0f, false},
+        {108000, 79.0f, 78.0f, false},
+        {109000, 97.8f, 78.0f, true},
+        {110000, 77.7f, 78.0f, false},
+        {111000, 78.7f, 78.0f, false},
+        {112000, 77.0f, 78.0f, false},
+        {113000, 78.7f, 78.0f, false},
+        {114000, 78.7f, 78.0f, false},
+        {115000, 78.7f, 78.0f, false},
+        {116000, 79.0f, 78.0f, false},
+        {117000, 77.7f, 78.0f, false},
+        {118000, 78.3f, 78.0f, false},
+        {119000, 78.0f, 78.0f, false},
+        {120000, 46.7f, 46.0f, false},
+        {121000, 46.7f, 46.0f, false},
+        {122000, 45.7f, 46.0f, false},
+        {123000, 46.3f, 46.0f, false},
+        {124000, 44.7f, 46.0f, false},
+        {125000, 47.3f, 46.0f, false},
+        {126000, 46.0f, 46.0f, false},
+        {127000, 48.0f, 46.0f, false},
+        {128000, 45.0f, 46.0f, false},
+        {129000, 47.7f, 46.0f, false},
+        {130000, 45.7f, 46.0f, false},
+        {131000, 46.0f, 46.0f, false},
+        {132000, 45.7f, 46.0f, false},
+        {133000, 47.3f, 46.0f, false},
+        {134000, 24.0f, 46.0f, true},
+        {135000, 46.0f, 46.0f, false},
+        {136000, 45.3f, 46.0f, false},
+        {137000, 46.7f, 46.0f, false},
+        {138000, 46.0f, 46.0f, false},
+        {139000, 45.3f, 46.0f, false},
+        {140000, 45.3f, 46.0f, false},
+        {141000, 46.0f, 46.0f, false},
+        {142000, 45.3f, 46.0f, false},
+        {143000, 45.7f, 46.0f, false},
+        {144000, 46.7f, 46.0f, false},
+        {145000, 46.0f, 46.0f, false},
+        {146000, 28.0f, 46.0f, true},
+        {147000, 45.0f, 46.0f, false},
+        {148000, 46.0f, 46.0f, false},
+        {149000, 46.0f, 46.0f, false},
+        {150000, 45.0f, 46.0f, false},
+        {151000, 45.3f, 46.0f, false},
+        {152000, 46.7f, 46.0f, false},
+        {153000, 45.7f, 46.0f, false},
+        {154000, 46.3f, 46.0f, false},
+        {155000, 46.7f, 46.0f, false},
+        {156000, 46.7f, 46.0f, false},
+        {157000, 45.0f, 46.0f, false},
+        {158000, 46.3f, 46.0f, false},
+        {159000, 44.3f, 46.0f, false},
+        {160000, 45.3f, 46.0f, false},
+        {161000, 45.7f, 46.0f, false},
+        {162000, 45.0f, 46.0f, false},
+        {163000, 45.3f, 46.0f, false},
+        {164000, 46.7f, 46.0f, false},
+        {165000, 45.0f, 46.0f, false},
+        {166000, 124.4f, 46.0f, true},
+        {167000, 46.0f, 46.0f, false},
+        {168000, 45.7f, 46.0f, false},
+        {169000, 45.0f, 46.0f, false},
+        {170000, 44.7f, 46.0f, false},
+        {171000, 45.7f, 46.0f, false},
+        {172000, 47.7f, 46.0f, false},
+        {173000, 45.7f, 46.0f, false},
+        {174000, 46.3f, 46.0f, false},
+        {175000, 26.3f, 46.0f, true},
+        {176000, 47.0f, 46.0f, false},
+        {177000, 46.3f, 46.0f, false},
+        {178000, 46.3f, 46.0f, false},
+        {179000, 46.7f, 46.0f, false},
+        {180000, 44.3f, 46.0f, false},
+        {181000, 46.0f, 46.0f, false},
+        {182000, 46.0f, 46.0f, false},
+        {183000, 45.7f, 46.0f, false},
+        {184000, 46.7f, 46.0f, false},
+        {185000, 45.7f, 46.0f, false},
+        {186000, 45.3f, 46.0f, false},
+        {187000, 45.7f, 46.0f, false},
+        {188000, 46.3f, 46.0f, false},
+        {189000, 46.3f, 46.0f, false},
+        {190000, 46.3f, 46.0f, false},
+        {191000, 47.0f, 46.0f, false},
+        {192000, 46.0f, 46.0f, false},
+        {193000, 45.7f, 46.0f, false},
+        {194000, 46.0f, 46.0f, false},
+        {195000, 47.3f, 46.0f, false},
+        {196000, 46.0f, 46.0f, false},
+        {197000, 46.0f, 46.0f, false},
+        {198000, 47.0f, 46.0f, false},
+        {199000, 47.3f, 46.0f, false},
+        {200000, 47.3f, 46.0f, false},
+        {201000, 47.3f, 46.0f, false},
+        {202000, 46.7f, 46.0f, false},
+        {203000, 46.7f, 46.0f, false},
+        {204000, 45.7f, 46.0f, false},
+        {205000, 47.0f, 46.0f, false},
+        {206000, 47.0f, 46.0f, false},
+        {207000, 47.0f, 46.0f, false},
+        {208000, 44.7f, 46.0f, false},
+        {209000, 46.7f, 46.0f, false},
+        {210000, 45.0f, 46.0f, false},
+        {211000, 45.3f, 46.0f, false},
+        {212000, 46.3f, 46.0f, false},
+        {213000, 109.4f, 46.0f, true},
+        {214000, 46.0f, 46.0f, false},
+        {215000, 37.6f, 46.0f, true},
+        {216000, 45.3f, 46.0f, false},
+        {217000, 46.3f, 46.0f, false},
+        {218000, 46.3f, 46.0f, false},
+        {219000, 46.7f, 46.0f, false},
+        {220000, 46.3f, 46.0f, false},
+        {221000, 46.3f, 46.0f, false},
+        {222000, 46.0f, 46.0f, false},
+        {223000, 46.3f, 46.0f, false},
+        {224000, 106.1f, 46.0f, true},
+        {225000, 45.7f, 46.0f, false},
+        {226000, 45.0f, 46.0f, false},
+        {227000, 46.7f, 46.0f, false},
+        {228000, 46.7f, 46.0f, false},
+        {229000, 46.0f, 46.0f, false},
+        {230000, 45.7f, 46.0f, false},
+        {231000, 19.7f, 46.0f, true},
+        {232000, 46.7f, 46.0f, false},
+        {233000, 46.0f, 46.0f, false},
+        {234000, 45.7f, 46.0f, false},
+        {235000, 47.0f, 46.0f, false},
+        {236000, 46.0f, 46.0f, false},
+        {237000, 47.0f, 46.0f, false},
+        {238000, 44.3f, 46.0f, false},
+        {239000, 35.1f, 46.0f, true},
+    };
+}
@@ -3,6 +3,7 @@ package api
 import (
 	"encoding/base64"
 	"encoding/json"
+	"math"
 	"time"
 
 	"github.com/gofiber/fiber/v3"
@@ -129,15 +130,35 @@ func (a *API) handleIngest(c fiber.Ctx) error {
 		log.Debug().Float64("lat", loc.Latitude).Float64("lng", loc.Longitude).Str("source", loc.Source).Msg("updated device location")
 	}
 
-	datapoints, err := loraprotocol.Decode(payload)
+	frame, err := loraprotocol.DecodeFrame(payload)
 	if err != nil {
 		log.Error().Err(err).Msg("could not decode payload")
 		return fiber.NewError(fiber.StatusBadRequest, "could not decode payload")
 	}
 
-	pointsToInsert := make([]db.InsertDeviceMeasurementsParams, 0, len(datapoints))
-	seenChannels := make(map[int16]struct{}, len(datapoints))
-	for _, point := range datapoints {
+	if ack := frame.ConfigAck; ack != nil {
+		log.Info().Uint8("sequence", ack.Sequence).Uint8("status", uint8(ack.Status)).Msg("config downlink acknowledged")
+	}
+
+	if link := frame.LinkStatus; link != nil {
+		log.Debug().Uint8("dr", link.DataRate).Int8("txPower", link.TxPowerDBm).Int16("rssi", link.RSSIDBm).Int8("snr", link.SNRDB).Msg("link status")
+	}
+
+	// Datapoints are dated relative to the frame's timestamp, or its reception without one
+	base := body.UplinkMessage.ReceivedAt
+	if !frame.Timestamp.IsZero() {
+		base = frame.Timestamp
+	}
+
+	pointsToInsert := make([]db.InsertDeviceMeasurementsParams, 0, len(frame.DataPoints))
+	seenChannels := make(map[int16]struct{}, len(frame.DataPoints))
+	for _, point := range frame.DataPoints {
+		// Quantized readings the device could not represent arrive as NaN
+		if f, ok := point.Value.(float32); ok && math.IsNaN(float64(f)) {
+			log.Debug().Uint8("channelID", point.ChannelID).Msg("skipping invalid reading")
+			continue
+		}
+
 		v, err := json.Marshal(point.Value)
 		if err != nil {
 			log.Error().Err(err).Msg("could not marshal point value")
@@ -161,7 +182,7 @@ func (a *API) handleIngest(c fiber.Ctx) error {
 			MeasurementType: int16(point.Type),
 			ChannelID:       channelID,
 			Value:           v,
-			ReceivedAt:      utils.TimeToPG(body.UplinkMessage.ReceivedAt),
+			ReceivedAt:      utils.TimeToPG(base.Add(point.Offset)),
 		})
 	}
 
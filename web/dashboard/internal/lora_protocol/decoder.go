@@ -4,6 +4,7 @@ import (
 	"encoding/binary"
 	"errors"
 	"math"
+	"time"
 )
 
 var ErrInvalidData = errors.New("invalid data")
@@ -23,36 +24,150 @@ const (
 	Humidity    MeasurementType = 0b1001
 	PH          MeasurementType = 0b1010
 	SoundLevel  MeasurementType = 0b1011
+	// Flags is a bitmap of the Boolean channels 0..n, the low nibble holds n
+	// instead of a channel.
+	Flags MeasurementType = 0b1100
+	// Control marks a control entry, the low nibble holds a ControlCode
+	// instead of a channel.
+	Control MeasurementType = 0b1111
 )
 
+type ControlCode uint8
+
+const (
+	ControlBatch ControlCode = 0x1
+	// ControlQuantized switches the rest of the frame to the 16 bit
+	// encodings of Quantization.
+	ControlQuantized ControlCode = 0x2
+	// ControlDelta marks a frame that only carries the channels that changed
+	// since the last frame the network acknowledged.
+	ControlDelta ControlCode = 0x3
+	// ControlTimestamp is followed by a uint32 GPS time in seconds, the base
+	// time of the following entries.
+	ControlTimestamp ControlCode = 0x4
+	// ControlOffset is followed by a varint, the following entries were
+	// sampled this many seconds after the base time.
+	ControlOffset ControlCode = 0x5
+	// ControlConfigAck is followed by the sequence number of a config
+	// downlink and its ConfigStatus.
+	ControlConfigAck ControlCode = 0x6
+	// ControlLinkStatus is followed by the radio settings of the uplink and
+	// the quality of the last downlink, see LinkStatus.
+	ControlLinkStatus ControlCode = 0x7
+)
+
+// ConfigStatus is the outcome of a config downlink.
+type ConfigStatus uint8
+
+const (
+	ConfigApplied ConfigStatus = 0
+	// ConfigMalformed means the downlink could not be parsed, nothing was
+	// applied.
+	ConfigMalformed ConfigStatus = 1
+	// ConfigUnknownKey means the downlink names a key that cannot be set
+	// remotely, nothing was applied.
+	ConfigUnknownKey ConfigStatus = 2
+)
+
+// LinkStatus reports the radio settings of the uplink and the quality of the
+// last downlink the device received; RSSI and SNR are 0 before the first one.
+type LinkStatus struct {
+	DataRate   uint8
+	TxPowerDBm int8
+	RSSIDBm    int16
+	SNRDB      int8
+}
+
+// ConfigAck acknowledges a config downlink.
+type ConfigAck struct {
+	Sequence uint8
+	Status   ConfigStatus
+}
+
+// MaxBatchSamples is the longest batch the firmware sends.
+const MaxBatchSamples = 64
+
+// gpsEpoch is the start of GPS time. GPS time has no leap seconds and runs
+// ahead of UTC by gpsLeapSeconds, the count since 1980 (18 since 2017).
+var gpsEpoch = time.Date(1980, time.January, 6, 0, 0, 0, 0, time.UTC)
+
+const gpsLeapSeconds = 18
+
 type DataPoint struct {
 	Type      MeasurementType
 	ChannelID uint8
 	Value     any
+	// Offset is the time the value was sampled at relative to the frame's
+	// timestamp, or its reception if it has none; negative for the older
+	// samples of a batch.
+	Offset time.Duration
 }
 
+// Frame is a decoded uplink.
+type Frame struct {
+	DataPoints []DataPoint
+	// Quantized is set once the frame switched to 16 bit values.
+	Quantized bool
+	// Delta is set if channels missing from the frame are unchanged.
+	Delta bool
+	// Timestamp is the base time of the datapoints, zero if the frame is
+	// dated by its reception.
+	Timestamp time.Time
+	// ConfigAck is set if the frame acknowledges a config downlink.
+	ConfigAck *ConfigAck
+	// LinkStatus is set if the frame reports the link.
+	LinkStatus *LinkStatus
+}
+
+// Decode returns the datapoints of an uplink, see DecodeFrame.
 func Decode(data []byte) ([]DataPoint, error) {
-	var datapoints []DataPoint
+	frame, err := DecodeFrame(data)
+	if err != nil {
+		return nil, err
+	}
+	return frame.DataPoints, nil
+}
+
+// DecodeFrame decodes an uplink, datapoints as well as control entries. The
+// wire format is described in docs/Payload-Format.md.
+func DecodeFrame(data []byte) (Frame, error) {
+	var frame Frame
+	var offset time.Duration
 	for len(data) > 0 {
-		dp, leftOver, err := DecodeOne(data)
+		var err error
+		first := len(frame.DataPoints)
+		switch MeasurementType(data[0] >> 4) {
+		case Control:
+			data, err = decodeControl(&frame, &offset, data)
+		case Flags:
+			data, err = decodeFlags(&frame, data)
+		default:
+			var dp DataPoint
+			dp, data, err = decodeDataPoint(data, frame.Quantized)
+			frame.DataPoints = append(frame.DataPoints, dp)
+		}
 		if err != nil {
-			return nil, err
+			return Frame{}, err
+		}
+		for i := first; i < len(frame.DataPoints); i++ {
+			frame.DataPoints[i].Offset += offset
 		}
-
-		datapoints = append(datapoints, dp)
-		data = leftOver
 	}
 
-	return datapoints, nil
+	return frame, nil
 }
 
 func DecodeOne(data []byte) (DataPoint, []byte, error) {
+	return decodeDataPoint(data, false)
+}
+
+func decodeDataPoint(data []byte, quantized bool) (DataPoint, []byte, error) {
 	if len(data) < 1 {
 		return DataPoint{}, data, ErrInvalidData
 	}
 
-	type_, channelID := MeasurementType(data[0]&0x0F), uint8(data[0]>>4)
-	value, leftOver, err := decodeValue(type_, data[1:])
+	type_, channelID := MeasurementType(data[0]>>4), uint8(data[0]&0x0F)
+	value, leftOver, err := decodeValue(type_, data[1:], quantized)
 	if err != nil {
 		return DataPoint{}, leftOver, err
 	}
@@ -64,7 +179,14 @@ func DecodeOne(data []byte) (DataPoint, []byte, error) {
 	}, leftOver, nil
 }
 
-func decodeValue(type_ MeasurementType, data []byte) (interface{}, []byte, error) {
+func decodeValue(type_ MeasurementType, data []byte, quantized bool) (interface{}, []byte, error) {
+	if q := quantization(type_); quantized && q.enabled() {
+		if len(data) < 2 {
+			return nil, nil, ErrInvalidData
+		}
+		return q.dequantize(binary.LittleEndian.Uint16(data)), data[2:], nil
+	}
+
 	switch type_ {
 	case Boolean:
 		if len(data) < 1 {
@@ -103,6 +225,130 @@ func decodeValue(type_ MeasurementType, data []byte) (interface{}, []byte, error
 	}
 }
 
+// decodeFlags decodes a flags entry into one Boolean datapoint per channel:
+// header, then the bitmap, 1 byte for up to 8 channels, else 2 bytes.
+func decodeFlags(frame *Frame, data []byte) ([]byte, error) {
+	highest := data[0] & 0x0F
+	size := 2
+	if highest >= 8 {
+		size = 3
+	}
+	if len(data) < size {
+		return nil, ErrInvalidData
+	}
+
+	values := uint16(data[1])
+	if size == 3 {
+		values |= uint16(data[2]) << 8
+	}
+	for channelID := uint8(0); channelID <= highest; channelID++ {
+		frame.DataPoints = append(frame.DataPoints, DataPoint{
+			Type:      Boolean,
+			ChannelID: channelID,
+			Value:     values&(1<<channelID) != 0,
+		})
+	}
+
+	return data[size:], nil
+}
+
+// decodeControl decodes the control entry at the start of data into frame,
+// an offset entry into offset.
+func decodeControl(frame *Frame, offset *time.Duration, data []byte) ([]byte, error) {
+	switch ControlCode(data[0] & 0x0F) {
+	case ControlBatch:
+		return decodeBatch(frame, data[1:])
+	case ControlQuantized:
+		frame.Quantized = true
+		return data[1:], nil
+	case ControlDelta:
+		frame.Delta = true
+		return data[1:], nil
+	case ControlTimestamp:
+		if len(data) < 5 {
+			return nil, ErrInvalidData
+		}
+		gps := time.Duration(binary.LittleEndian.Uint32(data[1:5])) * time.Second
+		frame.Timestamp = gpsEpoch.Add(gps - gpsLeapSeconds*time.Second)
+		return data[5:], nil
+	case ControlOffset:
+		seconds, n := binary.Uvarint(data[1:])
+		if n <= 0 || seconds > math.MaxUint32 {
+			return nil, ErrInvalidData
+		}
+		*offset = time.Duration(seconds) * time.Second
+		return data[1+n:], nil
+	case ControlConfigAck:
+		if len(data) < 3 {
+			return nil, ErrInvalidData
+		}
+		frame.ConfigAck = &ConfigAck{Sequence: data[1], Status: ConfigStatus(data[2])}
+		return data[3:], nil
+	case ControlLinkStatus:
+		if len(data) < 5 {
+			return nil, ErrInvalidData
+		}
+		frame.LinkStatus = &LinkStatus{
+			DataRate:   data[1],
+			TxPowerDBm: int8(data[2]),
+			RSSIDBm:    -int16(data[3]),
+			SNRDB:      int8(data[4]),
+		}
+		return data[5:], nil
+	default:
+		return nil, ErrInvalidData
+	}
+}
+
+// decodeBatch decodes the samples of a batch entry, oldest first:
+// header, int8 scale, varint period (s), uint8 count, then zig-zag varint
+// deltas of the samples in steps of 10^scale.
+func decodeBatch(frame *Frame, data []byte) ([]byte, error) {
+	if len(data) < 2 {
+		return nil, ErrInvalidData
+	}
+
+	type_, channelID := MeasurementType(data[0]>>4), uint8(data[0]&0x0F)
+	if type_ == Boolean || type_ > SoundLevel {
+		return nil, ErrInvalidData
+	}
+	step := float32(math.Pow10(int(int8(data[1]))))
+
+	period, n := binary.Uvarint(data[2:])
+	if n <= 0 || period > math.MaxUint16 || len(data) < 2+n+1 {
+		return nil, ErrInvalidData
+	}
+	data = data[2+n:]
+	count := int(data[0])
+	if count == 0 || count > MaxBatchSamples {
+		return nil, ErrInvalidData
+	}
+	data = data[1:]
+
+	var current int64
+	for i := 0; i < count; i++ {
+		delta, n := binary.Uvarint(data)
+		if n <= 0 {
+			return nil, ErrInvalidData
+		}
+		data = data[n:]
+		current += unzigzag(delta)
+
+		frame.DataPoints = append(frame.DataPoints, DataPoint{
+			Type:      type_,
+			ChannelID: channelID,
+			Value:     float32(current) * step,
+			Offset:    -time.Duration(count-1-i) * time.Duration(period) * time.Second,
+		})
+	}
+
+	return data, nil
+}
+
+func unzigzag(value uint64) int64 {
+	return int64(value>>1) ^ -int64(value&1)
+}
+
 func readFloat32(bytes []byte) float32 {
 	bits := binary.LittleEndian.Uint32(bytes)
 	return math.Float32frombits(bits)
@@ -0,0 +1,173 @@
+package loraprotocol
+
+import (
+	"errors"
+	"math"
+	"reflect"
+	"testing"
+	"time"
+)
+
+// The payloads below are what the firmware's Lora::Protocol::Encoder writes.
+
+func TestDecodeFrame(t *testing.T) {
+	tests := []struct {
+		name    string
+		payload []byte
+		want    Frame
+	}{
+		{
+			name:    "legacy datapoints",
+			payload: []byte{0x40, 0x00, 0x00, 0xa1, 0x42, 0x01, 0x01},
+			want: Frame{DataPoints: []DataPoint{
+				{Type: Distance, ChannelID: 0, Value: float32(80.5)},
+				{Type: Boolean, ChannelID: 1, Value: true},
+			}},
+		},
+		{
+			// Temperature channel 1, 0.01 °C steps, a minute apart, then a datapoint
+			name: "batch",
+			payload: []byte{
+				0xf1, 0x51, 0xfe, 0x3c, 0x03, 0xcc, 0x21, 0x31, 0x64,
+				0x40, 0x00, 0x00, 0xa1, 0x42,
+			},
+			want: Frame{DataPoints: []DataPoint{
+				{Type: Temperature, ChannelID: 1, Value: float32(2150) * 0.01, Offset: -2 * time.Minute},
+				{Type: Temperature, ChannelID: 1, Value: float32(2125) * 0.01, Offset: -time.Minute},
+				{Type: Temperature, ChannelID: 1, Value: float32(2175) * 0.01},
+				{Type: Distance, ChannelID: 0, Value: float32(80.5)},
+			}},
+		},
+		{
+			// Dated at GPS 1400000000, the datapoint five minutes later
+			name: "timestamp and offset",
+			payload: []byte{
+				0xf4, 0x00, 0x4e, 0x72, 0x53,
+				0xf1, 0x51, 0xfe, 0x3c, 0x03, 0xcc, 0x21, 0x31, 0x64,
+				0xf5, 0xac, 0x02, 0x40, 0x00, 0x00, 0xa1, 0x42,
+			},
+			want: Frame{Timestamp: time.Date(2024, time.May, 17, 16, 53, 2, 0, time.UTC), DataPoints: []DataPoint{
+				{Type: Temperature, ChannelID: 1, Value: float32(2150) * 0.01, Offset: -2 * time.Minute},
+				{Type: Temperature, ChannelID: 1, Value: float32(2125) * 0.01, Offset: -time.Minute},
+				{Type: Temperature, ChannelID: 1, Value: float32(2175) * 0.01},
+				{Type: Distance, ChannelID: 0, Value: float32(80.5), Offset: 5 * time.Minute},
+			}},
+		},
+		{
+			name:    "config ack",
+			payload: []byte{0xf6, 0x07, 0x02, 0x40, 0x00, 0x00, 0xa1, 0x42},
+			want: Frame{ConfigAck: &ConfigAck{Sequence: 7, Status: ConfigUnknownKey}, DataPoints: []DataPoint{
+				{Type: Distance, ChannelID: 0, Value: float32(80.5)},
+			}},
+		},
+		{
+			name:    "link status",
+			payload: []byte{0xf7, 0x03, 0x0e, 0x75, 0xf9, 0x40, 0x00, 0x00, 0xa1, 0x42},
+			want: Frame{LinkStatus: &LinkStatus{DataRate: 3, TxPowerDBm: 14, RSSIDBm: -117, SNRDB: -7}, DataPoints: []DataPoint{
+				{Type: Distance, ChannelID: 0, Value: float32(80.5)},
+			}},
+		},
+		{
+			name:    "delta",
+			payload: []byte{0xf3, 0x40, 0x00, 0x00, 0xa1, 0x42},
+			want: Frame{Delta: true, DataPoints: []DataPoint{
+				{Type: Distance, ChannelID: 0, Value: float32(80.5)},
+			}},
+		},
+		{
+			// Booleans 0..2, overflow and pump running, then a datapoint
+			name:    "flags",
+			payload: []byte{0xc2, 0x05, 0x40, 0x00, 0x00, 0xa1, 0x42},
+			want: Frame{DataPoints: []DataPoint{
+				{Type: Boolean, ChannelID: 0, Value: true},
+				{Type: Boolean, ChannelID: 1, Value: false},
+				{Type: Boolean, ChannelID: 2, Value: true},
+				{Type: Distance, ChannelID: 0, Value: float32(80.5)},
+			}},
+		},
+		{
+			name:    "flags above channel 7",
+			payload: []byte{0xc9, 0x81, 0x02},
+			want: Frame{DataPoints: []DataPoint{
+				{Type: Boolean, ChannelID: 0, Value: true},
+				{Type: Boolean, ChannelID: 1, Value: false},
+				{Type: Boolean, ChannelID: 2, Value: false},
+				{Type: Boolean, ChannelID: 3, Value: false},
+				{Type: Boolean, ChannelID: 4, Value: false},
+				{Type: Boolean, ChannelID: 5, Value: false},
+				{Type: Boolean, ChannelID: 6, Value: false},
+				{Type: Boolean, ChannelID: 7, Value: true},
+				{Type: Boolean, ChannelID: 8, Value: false},
+				{Type: Boolean, ChannelID: 9, Value: true},
+			}},
+		},
+		{
+			// Float and Boolean have no quantization and keep their encoding
+			name: "quantized",
+			payload: []byte{
+				0xf2, 0x40, 0x25, 0x03, 0x51, 0xbb, 0x7e,
+				0x12, 0x00, 0x00, 0xc0, 0x3f, 0x03, 0x01,
+			},
+			want: Frame{Quantized: true, DataPoints: []DataPoint{
+				{Type: Distance, ChannelID: 0, Value: float32(0.1) * 805},
+				{Type: Temperature, ChannelID: 1, Value: float32(-327.68) + float32(0.01)*32443},
+				{Type: Float, ChannelID: 2, Value: float32(1.5)},
+				{Type: Boolean, ChannelID: 3, Value: true},
+			}},
+		},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			got, err := DecodeFrame(tt.payload)
+			if err != nil {
+				t.Fatalf("DecodeFrame() error = %v", err)
+			}
+			if !reflect.DeepEqual(got, tt.want) {
+				t.Fatalf("DecodeFrame() = %+v, want %+v", got, tt.want)
+			}
+		})
+	}
+}
+
+func TestDecodeFrameQuantizedInvalid(t *testing.T) {
+	// Voltage channel 4 was NaN or out of range on the device
+	got, err := DecodeFrame([]byte{0xf2, 0x34, 0xff, 0xff})
+	if err != nil {
+		t.Fatalf("DecodeFrame() error = %v", err)
+	}
+	if len(got.DataPoints) != 1 {
+		t.Fatalf("DecodeFrame() = %+v, want one datapoint", got)
+	}
+	if value, ok := got.DataPoints[0].Value.(float32); !ok || !math.IsNaN(float64(value)) {
+		t.Fatalf("Value = %v, want NaN", got.DataPoints[0].Value)
+	}
+}
+
+func TestDecodeFrameInvalid(t *testing.T) {
+	tests := []struct {
+		name    string
+		payload []byte
+	}{
+		{name: "truncated float", payload: []byte{0x40, 0x00, 0x00}},
+		{name: "truncated quantized value", payload: []byte{0xf2, 0x40, 0x25}},
+		{name: "truncated flags", payload: []byte{0xc9, 0x81}},
+		{name: "truncated timestamp", payload: []byte{0xf4, 0x00, 0x4e, 0x72}},
+		{name: "truncated offset", payload: []byte{0xf5, 0xac}},
+		{name: "truncated config ack", payload: []byte{0xf6, 0x07}},
+		{name: "truncated link status", payload: []byte{0xf7, 0x03, 0x0e, 0x75}},
+		{name: "unknown control code", payload: []byte{0xfe}},
+		{name: "batch of Booleans", payload: []byte{0xf1, 0x01, 0x00, 0x3c, 0x01, 0x02}},
+		{name: "empty batch", payload: []byte{0xf1, 0x51, 0xfe, 0x3c, 0x00}},
+		{name: "truncated batch", payload: []byte{0xf1, 0x51, 0xfe, 0x3c, 0x03, 0xcc, 0x21}},
+		{name: "batch period beyond 16 bit", payload: []byte{0xf1, 0x51, 0xfe, 0x80, 0x80, 0x04, 0x01, 0x00}},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			if _, err := DecodeFrame(tt.payload); !errors.Is(err, ErrInvalidData) {
+				t.Fatalf("DecodeFrame() error = %v, want ErrInvalidData", err)
+			}
+		})
+	}
+}
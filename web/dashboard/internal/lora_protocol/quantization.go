@@ -0,0 +1,55 @@
+package loraprotocol
+
+import "math"
+
+// Quantization is the 16 bit fixed-point encoding of a measurement type in
+// quantized frames: the number of steps above min, little endian. It mirrors
+// firmware/src/lora/quantization.h.
+type Quantization struct {
+	Step float32
+	Min  float32
+}
+
+// QuantizedInvalid marks a reading that was NaN or out of range.
+const QuantizedInvalid = 0xffff
+
+func (q Quantization) enabled() bool {
+	return q.Step > 0
+}
+
+// dequantize returns the value of raw, NaN for QuantizedInvalid.
+func (q Quantization) dequantize(raw uint16) float32 {
+	if raw == QuantizedInvalid {
+		return float32(math.NaN())
+	}
+	return q.Min + q.Step*float32(raw)
+}
+
+// quantization returns the encoding of a measurement type, Float and Boolean
+// have none and keep their plain value.
+func quantization(type_ MeasurementType) Quantization {
+	switch type_ {
+	case Pressure: // 0.1 hPa
+		return Quantization{Step: 0.1}
+	case Voltage: // 1 mV
+		return Quantization{Step: 0.001}
+	case Distance: // 1 mm
+		return Quantization{Step: 0.1}
+	case Temperature: // 0.01 °C from -327.68 °C
+		return Quantization{Step: 0.01, Min: -327.68}
+	case PPx: // 1 ppm
+		return Quantization{Step: 1}
+	case Brightness: // 2 lx
+		return Quantization{Step: 2}
+	case Resistance: // 1 Ω
+		return Quantization{Step: 1}
+	case Humidity: // 0.01 %
+		return Quantization{Step: 0.01}
+	case PH:
+		return Quantization{Step: 0.001}
+	case SoundLevel: // 0.01 dB
+		return Quantization{Step: 0.01}
+	default:
+		return Quantization{}
+	}
+}